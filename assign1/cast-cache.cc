@@ -0,0 +1,247 @@
+/**
+ * File: cast-cache.cc
+ * -------------------
+ * Presents the implementation of the castCache class exported by cast-cache.h.
+ */
+
+#include "cast-cache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+using namespace std;
+
+const char *const castCache::kCacheFileName = "imdbcastcache";
+
+static const uint32_t kCacheMagic = 0x54534143; // "CAST" when viewed as little-endian bytes
+static const uint32_t kCacheVersion = 2;
+
+/**
+ * Function: hashKey
+ * -----------------
+ * 64-bit FNV-1a hash of a film's title followed by its year.
+ */
+static uint64_t hashKey(const char *name, size_t length, int year) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char) name[i];
+    hash *= 1099511628211ULL;
+  }
+  hash ^= (uint32_t) year;
+  hash *= 1099511628211ULL;
+  return hash;
+}
+
+struct filmHash {
+  size_t operator()(const film& movie) const {
+    return std::hash<std::string>()(movie.title) * 31 + movie.year;
+  }
+};
+
+/**
+ * Function: tableSize
+ * -------------------
+ * Returns the smallest power of two that's at least twice the specified count.
+ */
+static uint32_t tableSize(uint32_t count) {
+  uint32_t size = 1;
+  while (size < 2 * count) size <<= 1;
+  return size;
+}
+
+/**
+ * Function: appendString
+ * ----------------------
+ * Tacks the specified string (and its '\0') onto the end of the pool,
+ * and returns the offset where it begins.
+ */
+static uint32_t appendString(vector<char>& pool, const string& str) {
+  uint32_t offset = pool.size();
+  pool.insert(pool.end(), str.c_str(), str.c_str() + str.size() + 1);
+  return offset;
+}
+
+/**
+ * Function: appendArray
+ * ---------------------
+ * Appends the bytes of the specified vector to the end of the buffer.
+ */
+template <typename T>
+static void appendArray(vector<char>& buffer, const vector<T>& array) {
+  buffer.insert(buffer.end(), (const char *) array.data(), (const char *) (array.data() + array.size()));
+}
+
+castCache::castCache(const imdb& db, const string& directory, size_t numCachedFilms) :
+  fd(-1), fileSize(0), fileMap(NULL), header(NULL) {
+  dataStamp stamp;
+  db.getStamp(stamp);
+  string fileName = directory + "/" + kCacheFileName;
+  if (load(fileName, stamp, numCachedFilms)) return;
+  build(db, stamp, numCachedFilms);
+
+  // Write to a private file and rename it into place, so other processes never see half a cache
+  if (access(directory.c_str(), W_OK) != 0) return;
+  string tempFileName = fileName + "." + to_string(getpid());
+  ofstream out(tempFileName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out) return;
+  out.write(built.data(), built.size());
+  out.close();
+  if (out.fail() || rename(tempFileName.c_str(), fileName.c_str()) != 0) unlink(tempFileName.c_str());
+}
+
+castCache::~castCache() {
+  if (fileMap != NULL) munmap((void *) fileMap, fileSize);
+  if (fd != -1) close(fd);
+}
+
+bool castCache::load(const string& fileName, const dataStamp& stamp, size_t numCachedFilms) {
+  fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+  struct stat stats;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &stats) == 0 && (size_t) stats.st_size >= sizeof(cacheHeader)) {
+    map = mmap(0, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  if (map == MAP_FAILED) {
+    close(fd);
+    fd = -1;
+    return false;
+  }
+
+  // The cache is only trusted if it was built from exactly the imdb we're serving
+  const cacheHeader *candidate = (const cacheHeader *) map;
+  bool valid = candidate->magic == kCacheMagic && candidate->version == kCacheVersion &&
+    candidate->source == stamp && candidate->numCachedFilms == numCachedFilms &&
+    candidate->filmSlots > 0 && (candidate->filmSlots & (candidate->filmSlots - 1)) == 0 &&
+    (size_t) stats.st_size == sizeof(cacheHeader) + sizeof(filmSlot) * (size_t) candidate->filmSlots +
+    sizeof(uint32_t) * ((size_t) candidate->numCached + 1 + candidate->numCastEntries) + candidate->poolSize;
+  if (!valid) {
+    munmap(map, stats.st_size);
+    close(fd);
+    fd = -1;
+    return false;
+  }
+
+  fileMap = map;
+  fileSize = stats.st_size;
+  attach((const char *) map);
+  return true;
+}
+
+void castCache::build(const imdb& db, const dataStamp& stamp, size_t numCachedFilms) {
+  vector<string> players;
+  db.getPlayers(players);
+  unordered_map<film, uint32_t, filmHash> castSizes;
+  for (const string& player: players) {
+    creditRange credits;
+    db.getCredits(player, credits);
+    for (const filmView& view: credits) {
+      film movie = view.toFilm();
+      if (castSizes.count(movie) > 0) continue;
+      castRange cast;
+      db.getCast(view, cast);
+      castSizes[movie] = cast.size();
+    }
+  }
+
+  // Decode the casts of the largest films, breaking ties by film so the choice is deterministic
+  vector<const pair<const film, uint32_t> *> largest;
+  largest.reserve(castSizes.size());
+  for (const pair<const film, uint32_t>& entry: castSizes) largest.push_back(&entry);
+  size_t numCached = min(numCachedFilms, largest.size());
+  partial_sort(largest.begin(), largest.begin() + numCached, largest.end(),
+    [] (const pair<const film, uint32_t> *lhs, const pair<const film, uint32_t> *rhs) {
+      return lhs->second > rhs->second || (lhs->second == rhs->second && lhs->first < rhs->first);
+    });
+  unordered_map<film, int32_t, filmHash> cachedIndex;
+  for (size_t i = 0; i < numCached; i++) cachedIndex[largest[i]->first] = i;
+
+  cacheHeader newHeader;
+  memset(&newHeader, 0, sizeof(newHeader)); // so padding is written as zeroes
+  newHeader.magic = kCacheMagic;
+  newHeader.version = kCacheVersion;
+  newHeader.numCachedFilms = numCachedFilms;
+  newHeader.numCached = numCached;
+  newHeader.numFilms = castSizes.size();
+  newHeader.filmSlots = tableSize(castSizes.size());
+  newHeader.source = stamp;
+
+  vector<char> strings(1, '\0'); // offset 0 marks an empty slot
+  vector<filmSlot> films(newHeader.filmSlots, filmSlot{0, 0, 0, 0, -1});
+  for (const pair<const film, uint32_t>& entry: castSizes) {
+    const film& movie = entry.first;
+    uint64_t hash = hashKey(movie.title.c_str(), movie.title.size(), movie.year);
+    uint32_t slot = hash & (newHeader.filmSlots - 1);
+    while (films[slot].title != 0) slot = (slot + 1) & (newHeader.filmSlots - 1);
+    unordered_map<film, int32_t, filmHash>::const_iterator cached = cachedIndex.find(movie);
+    films[slot] = filmSlot{(uint32_t) (hash >> 32), appendString(strings, movie.title), movie.year, entry.second,
+                           cached == cachedIndex.end() ? -1 : cached->second};
+  }
+
+  vector<uint32_t> castOffsets(1, 0), castEntries;
+  for (size_t i = 0; i < numCached; i++) {
+    vector<string> cast;
+    db.getCast(largest[i]->first, cast);
+    for (const string& player: cast) castEntries.push_back(appendString(strings, player));
+    castOffsets.push_back(castEntries.size());
+  }
+  newHeader.numCastEntries = castEntries.size();
+  newHeader.poolSize = strings.size();
+
+  built.assign((const char *) &newHeader, (const char *) (&newHeader + 1));
+  appendArray(built, films);
+  appendArray(built, castOffsets);
+  appendArray(built, castEntries);
+  appendArray(built, strings);
+  attach(built.data());
+}
+
+/**
+ * Method: attach
+ * --------------
+ * Points the receiving castCache at the specified file contents, and materializes
+ * the cached casts, which are the only part searches need as strings.
+ */
+void castCache::attach(const char *contents) {
+  header = (const cacheHeader *) contents;
+  filmTable = (const filmSlot *) (header + 1);
+  const uint32_t *castOffsets = (const uint32_t *) (filmTable + header->filmSlots);
+  const uint32_t *castEntries = castOffsets + header->numCached + 1;
+  pool = (const char *) (castEntries + header->numCastEntries);
+
+  casts.resize(header->numCached);
+  for (size_t i = 0; i < casts.size(); i++) {
+    for (uint32_t entry = castOffsets[i]; entry < castOffsets[i + 1]; entry++) {
+      casts[i].push_back(pool + castEntries[entry]);
+    }
+  }
+}
+
+const castCache::filmSlot *castCache::findFilm(const film& movie) const {
+  uint64_t hash = hashKey(movie.title.c_str(), movie.title.size(), movie.year);
+  uint32_t mask = header->filmSlots - 1;
+  for (uint32_t slot = hash & mask; filmTable[slot].title != 0; slot = (slot + 1) & mask) {
+    if (filmTable[slot].fingerprint == (uint32_t) (hash >> 32) && filmTable[slot].year == movie.year &&
+        movie.title == pool + filmTable[slot].title) {
+      return &filmTable[slot];
+    }
+  }
+  return NULL;
+}
+
+size_t castCache::getCastSize(const film& movie) const {
+  const filmSlot *found = findFilm(movie);
+  return found == NULL ? 0 : found->castSize;
+}
+
+const vector<string> *castCache::getCast(const film& movie) const {
+  const filmSlot *found = findFilm(movie);
+  if (found == NULL || found->cachedCast == -1) return NULL;
+  return &casts[found->cachedCast];
+}
@@ -0,0 +1,135 @@
+/**
+ * File: cast-cache.h
+ * ------------------
+ * Defines the castCache class, which sits beside an imdb and answers two questions
+ * about films without touching the data files: how large a film's cast is, and
+ * (for the few films with the very largest casts) who's in it.
+ *
+ * A handful of hub films with enormous casts account for many of the names a
+ * breadth-first search decodes, so the cache holds the fully decoded casts of the
+ * numCachedFilms largest ones, and a search consulting it never decodes those
+ * records again.
+ *
+ * Finding the largest films means decoding every record in the database, which costs
+ * more than most searches do, so it's done once and stored alongside the data files
+ * in a file named imdbcastcache.  Later castCaches simply map that file, much as the
+ * imdb maps its index.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "imdb.h"
+#include "imdb-utils.h"
+
+/**
+ * Constant: kDefaultCachedFilms
+ * -----------------------------
+ * The number of decoded casts a castCache holds unless told otherwise.
+ */
+const size_t kDefaultCachedFilms = 64;
+
+class castCache {
+ public:
+
+/**
+ * Constructor: castCache
+ * ----------------------
+ * Maps the imdbcastcache file in the specified directory, which should be the one the
+ * specified imdb was opened on.  The file is only used if it was built from exactly the
+ * state of the directory the imdb reports (see dataStamp) for the same numCachedFilms.
+ * Otherwise the cast size table is built with one pass over every actor's credits, the
+ * casts of the numCachedFilms films with the largest ones are decoded, and, if the
+ * directory is writable, the result is written there for future runs.  The imdb's delta,
+ * if any, is reflected either way.
+ */
+  castCache(const imdb& db, const std::string& directory, size_t numCachedFilms = kDefaultCachedFilms);
+
+/**
+ * Predicate Method: wasLoaded
+ * ---------------------------
+ * Returns true if and only if the cache was mapped from an existing imdbcastcache file
+ * rather than built from scratch.
+ */
+  bool wasLoaded() const { return fileMap != NULL; }
+
+/**
+ * Method: getCastSize
+ * -------------------
+ * Returns the number of actors in the specified film's cast, or 0 if the
+ * film isn't in the imdb.
+ */
+  size_t getCastSize(const film& movie) const;
+
+/**
+ * Method: getCast
+ * ---------------
+ * Returns the decoded cast of the specified film if it's one of the cached
+ * films, and NULL otherwise.  The cast is listed in the order imdb::getCast
+ * reports it, and remains valid as long as the castCache does.
+ */
+  const std::vector<std::string> *getCast(const film& movie) const;
+
+/**
+ * Methods: getNumFilms
+ *          getNumCached
+ * ---------------------
+ * Return the number of films in the cast size table, and the number of
+ * films whose casts are cached.
+ */
+  size_t getNumFilms() const { return header->numFilms; }
+  size_t getNumCached() const { return casts.size(); }
+
+/**
+ * Destructor: ~castCache
+ * ----------------------
+ * Unmaps the imdbcastcache file, if it was mapped.
+ */
+  ~castCache();
+
+ private:
+  static const char *const kCacheFileName;
+
+  // The file is a header followed by an open-addressing table of films, the cached
+  // casts (an offset per cached film into a list of names), and a pool of the
+  // '\0'-terminated titles and names both refer to.  Pool offset 0 is never used by a
+  // string, so a slot whose title is 0 is empty.
+  struct cacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numCachedFilms; // as requested, which may exceed numCached
+    uint32_t numCached;
+    uint32_t numFilms;
+    uint32_t filmSlots;
+    uint32_t numCastEntries;
+    uint32_t poolSize;
+    dataStamp source;        // the state of the data directory the cache was built from
+  };
+
+  struct filmSlot {
+    uint32_t fingerprint;
+    uint32_t title;
+    int32_t year;
+    uint32_t castSize;
+    int32_t cachedCast; // index into the cached casts, or -1
+  };
+
+  int fd;
+  size_t fileSize;
+  const void *fileMap;
+  std::vector<char> built; // the file's contents, when they were built rather than mapped
+
+  const cacheHeader *header;
+  const filmSlot *filmTable;
+  const char *pool;
+  std::vector<std::vector<std::string>> casts;
+
+  const filmSlot *findFilm(const film& movie) const;
+  bool load(const std::string& fileName, const dataStamp& stamp, size_t numCachedFilms);
+  void build(const imdb& db, const dataStamp& stamp, size_t numCachedFilms);
+  void attach(const char *contents);
+
+  castCache(const castCache& original) = delete;
+  castCache& operator=(const castCache& rhs) = delete;
+};
@@ -0,0 +1,373 @@
+/**
+ * File: imdb-bench.cc
+ * -------------------
+ * Replays a fixed corpus of queries against the imdb (and the imdbgraph snapshot in
+ * the data directory, or the one named with -g) and reports, for each kind of query,
+ * its throughput, latency percentiles, the page faults it incurred, and the work each
+ * query did.  The corpus holds three kinds of lines, tab-separated:
+ *
+ *     actor  <name>                   replayed against imdb::getCredits
+ *     film   <title>  <year>          replayed against imdb::getCast
+ *     pair   <actor1>  <actor2>       replayed against forwardSearch and bidirectionalSearch, and
+ *                                     against the castCache-backed forwardSearch, then against the
+ *                                     snapshot's forwardSearch and bidirectionalSearch, which
+ *                                     are what search runs by default and with -b, and
+ *                                     parallelSearch (with -t threads), which it runs with -t
+ *
+ * The corpus is read from the file named with -c.  Without one, a corpus is drawn from
+ * the database itself with a fixed seed, so two builds run against the same data always
+ * replay the same queries; -w writes that corpus out so it can be pinned down or edited.
+ *
+ * The output is meant for scripts: a header line, then one tab-separated line per kind
+ * of query, with these columns:
+ *
+ *     op           getCredits, getCast, forwardSearch, bidirectionalSearch, castCache (loading
+ *                  the imdbcastcache file, timed once), cachedSearch, snapshotForwardSearch,
+ *                  snapshotBidirectionalSearch or parallelSearch (the snapshot rows are left
+ *                  out, with a warning, if there's no current snapshot)
+ *     queries      number of queries replayed (corpus entries times rounds)
+ *     seconds      total wall time spent answering them
+ *     qps          queries per second
+ *     p50_us ...   latency percentiles (50, 90, 99, max) in microseconds
+ *     minflt       minor page faults incurred while replaying, per getrusage
+ *     majflt       major page faults incurred while replaying
+ *     work         mean records returned per lookup, or records decoded per search (nodes
+ *                  expanded, less any casts served from the castCache)
+ *     checksum     sum of the records returned (or path lengths), to compare builds
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "imdb-graph.h"
+#include "path.h"
+#include "search-engine.h"
+#include "cast-cache.h"
+using namespace std;
+using namespace std::chrono;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kCorpusNotFound = 3;
+static const size_t kMaxSearchDepth = 7;
+static const size_t kDefaultNumRounds = 3;
+static const size_t kCorpusSeed = 110;
+static const size_t kCorpusActors = 2000;
+static const size_t kCorpusFilms = 2000;
+static const size_t kCorpusPairs = 200;
+
+/**
+ * Convenience struct: corpus
+ * --------------------------
+ * The queries to replay, in the order they're replayed.
+ */
+struct corpus {
+  vector<string> actors;
+  vector<film> films;
+  vector<pair<string, string>> pairs;
+};
+
+/**
+ * Convenience struct: benchResult
+ * -------------------------------
+ * Everything measured while replaying one kind of query.
+ */
+struct benchResult {
+  string op;
+  vector<double> latencies; // microseconds, one per query
+  double seconds;
+  long minorFaults;
+  long majorFaults;
+  size_t work;
+  size_t checksum;
+};
+
+/**
+ * Function: readCorpus
+ * --------------------
+ * Reads the corpus from the specified file, ignoring blank lines, lines starting
+ * with '#', and lines it doesn't recognize.  Returns false if the file can't be read.
+ */
+static bool readCorpus(const string& fileName, corpus& queries) {
+  ifstream in(fileName.c_str());
+  if (!in) return false;
+  string line;
+  while (getline(in, line)) {
+    vector<string> fields;
+    size_t start = 0, tab;
+    while ((tab = line.find('\t', start)) != string::npos) {
+      fields.push_back(line.substr(start, tab - start));
+      start = tab + 1;
+    }
+    fields.push_back(line.substr(start));
+
+    if (fields[0] == "actor" && fields.size() == 2) {
+      queries.actors.push_back(fields[1]);
+    } else if (fields[0] == "film" && fields.size() == 3) {
+      film movie;
+      movie.title = fields[1];
+      movie.year = atoi(fields[2].c_str());
+      queries.films.push_back(movie);
+    } else if (fields[0] == "pair" && fields.size() == 3) {
+      queries.pairs.push_back(make_pair(fields[1], fields[2]));
+    }
+  }
+  return true;
+}
+
+/**
+ * Function: drawCorpus
+ * --------------------
+ * Draws a corpus from the database with a fixed seed: random actors, one random
+ * film from the credits of each of a second set of random actors, and random pairs.
+ */
+static void drawCorpus(const imdb& db, corpus& queries) {
+  vector<string> players;
+  db.getPlayers(players);
+  if (players.empty()) return;
+  mt19937 generator(kCorpusSeed);
+  uniform_int_distribution<size_t> pickPlayer(0, players.size() - 1);
+  for (size_t i = 0; i < kCorpusActors; i++) queries.actors.push_back(players[pickPlayer(generator)]);
+  while (queries.films.size() < kCorpusFilms) {
+    vector<film> credits;
+    db.getCredits(players[pickPlayer(generator)], credits);
+    if (!credits.empty()) queries.films.push_back(credits[generator() % credits.size()]);
+  }
+  for (size_t i = 0; i < kCorpusPairs; i++) {
+    const string& startingActor = players[pickPlayer(generator)];
+    queries.pairs.push_back(make_pair(startingActor, players[pickPlayer(generator)]));
+  }
+}
+
+/**
+ * Function: writeCorpus
+ * ---------------------
+ * Writes the corpus to the specified file in the format readCorpus expects.
+ */
+static bool writeCorpus(const string& fileName, const corpus& queries) {
+  ofstream out(fileName.c_str());
+  if (!out) return false;
+  for (const string& player: queries.actors) out << "actor\t" << player << "\n";
+  for (const film& movie: queries.films) out << "film\t" << movie.title << "\t" << movie.year << "\n";
+  for (const pair<string, string>& query: queries.pairs) {
+    out << "pair\t" << query.first << "\t" << query.second << "\n";
+  }
+  out.close();
+  return !out.fail();
+}
+
+/**
+ * Function: replay
+ * ----------------
+ * Calls query(i) for i = 0 through numQueries - 1, numRounds times over, timing each
+ * call, and records the page faults incurred across all of them.  query returns the
+ * number of records (or nodes) it touched, which is summed into work, and adds to
+ * checksum whatever it wants compared across builds.
+ */
+static benchResult replay(const string& op, size_t numQueries, size_t numRounds,
+                          const function<size_t(size_t, size_t&)>& query) {
+  benchResult result;
+  result.op = op;
+  result.work = 0;
+  result.checksum = 0;
+  result.latencies.reserve(numQueries * numRounds);
+
+  struct rusage before, after;
+  getrusage(RUSAGE_SELF, &before);
+  steady_clock::time_point start = steady_clock::now();
+  for (size_t round = 0; round < numRounds; round++) {
+    for (size_t i = 0; i < numQueries; i++) {
+      steady_clock::time_point queryStart = steady_clock::now();
+      result.work += query(i, result.checksum);
+      result.latencies.push_back(duration<double, micro>(steady_clock::now() - queryStart).count());
+    }
+  }
+  result.seconds = duration<double>(steady_clock::now() - start).count();
+  getrusage(RUSAGE_SELF, &after);
+  result.minorFaults = after.ru_minflt - before.ru_minflt;
+  result.majorFaults = after.ru_majflt - before.ru_majflt;
+  return result;
+}
+
+/**
+ * Function: percentile
+ * --------------------
+ * Returns the specified percentile of the sorted latencies, or 0 if there are none.
+ */
+static double percentile(const vector<double>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t index = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+/**
+ * Function: printResult
+ * ---------------------
+ * Prints one tab-separated line summarizing the specified result.
+ */
+static void printResult(benchResult& result) {
+  sort(result.latencies.begin(), result.latencies.end());
+  size_t numQueries = result.latencies.size();
+  cout << result.op << "\t" << numQueries << fixed << setprecision(6) << "\t" << result.seconds
+       << setprecision(1) << "\t" << (result.seconds > 0 ? numQueries / result.seconds : 0)
+       << setprecision(2) << "\t" << percentile(result.latencies, 50) << "\t" << percentile(result.latencies, 90)
+       << "\t" << percentile(result.latencies, 99) << "\t" << percentile(result.latencies, 100)
+       << "\t" << result.minorFaults << "\t" << result.majorFaults
+       << "\t" << (numQueries > 0 ? (double) result.work / numQueries : 0)
+       << "\t" << result.checksum << endl;
+}
+
+/**
+ * Function: printUsageAndExit
+ * ---------------------------
+ * Prints the expected command line to standard error and exits.
+ */
+static void printUsageAndExit(const char *progname) {
+  cerr << "Usage: " << progname << " [-c <corpus file>] [-w <corpus file>] [-d <data directory>] [-r <rounds>]"
+       << " [-g <snapshot>] [-t <threads>]" << endl;
+  exit(kWrongArgumentCount);
+}
+
+int main(int argc, char *argv[]) {
+  string corpusFileName, writeFileName;
+  string directory = kIMDBDataDirectory;
+  string snapshotFileName;
+  size_t numRounds = kDefaultNumRounds;
+  size_t numThreads = max(thread::hardware_concurrency(), 1u);
+  int opt;
+  while ((opt = getopt(argc, argv, "c:d:g:r:t:w:")) != -1) {
+    switch (opt) {
+    case 'c':
+      corpusFileName = optarg;
+      break;
+    case 'd':
+      directory = optarg;
+      break;
+    case 'g':
+      snapshotFileName = optarg;
+      break;
+    case 'r':
+      if (atoi(optarg) < 1) printUsageAndExit(argv[0]); // checked signed, so -1 doesn't wrap to SIZE_MAX
+      numRounds = atoi(optarg);
+      break;
+    case 't':
+      if (atoi(optarg) < 1) printUsageAndExit(argv[0]);
+      numThreads = atoi(optarg);
+      break;
+    case 'w':
+      writeFileName = optarg;
+      break;
+    default:
+      printUsageAndExit(argv[0]);
+    }
+  }
+  if (argc != optind) printUsageAndExit(argv[0]);
+
+  imdb db(directory);
+  if (!db.good()) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+
+  corpus queries;
+  if (corpusFileName.empty()) {
+    drawCorpus(db, queries);
+  } else if (!readCorpus(corpusFileName, queries)) {
+    cerr << "Couldn't read the corpus file " << corpusFileName << "!  Aborting..." << endl;
+    return kCorpusNotFound;
+  }
+  if (!writeFileName.empty() && !writeCorpus(writeFileName, queries)) {
+    cerr << "Couldn't write the corpus file " << writeFileName << "!  Aborting..." << endl;
+    return kCorpusNotFound;
+  }
+
+  vector<benchResult> results;
+  results.push_back(replay("getCredits", queries.actors.size(), numRounds, [&](size_t i, size_t& checksum) -> size_t {
+    vector<film> credits;
+    db.getCredits(queries.actors[i], credits);
+    checksum += credits.size();
+    return credits.size();
+  }));
+  results.push_back(replay("getCast", queries.films.size(), numRounds, [&](size_t i, size_t& checksum) -> size_t {
+    vector<string> cast;
+    db.getCast(queries.films[i], cast);
+    checksum += cast.size();
+    return cast.size();
+  }));
+  results.push_back(replay("forwardSearch", queries.pairs.size(), numRounds, [&](size_t i, size_t& checksum) -> size_t {
+    path result(queries.pairs[i].first);
+    searchStats stats;
+    if (forwardSearch(db, queries.pairs[i].first, queries.pairs[i].second, kMaxSearchDepth, result, stats)) {
+      checksum += result.getLength();
+    }
+    return stats.recordsDecoded();
+  }));
+  results.push_back(replay("bidirectionalSearch", queries.pairs.size(), numRounds,
+                           [&](size_t i, size_t& checksum) -> size_t {
+    path result(queries.pairs[i].first);
+    searchStats stats;
+    if (bidirectionalSearch(db, queries.pairs[i].first, queries.pairs[i].second, kMaxSearchDepth, result, stats)) {
+      checksum += result.getLength();
+    }
+    return stats.recordsDecoded();
+  }));
+
+  // The first castCache writes imdbcastcache if it's missing or stale, so the row times what search pays
+  unique_ptr<castCache> cache(new castCache(db, directory));
+  if (!cache->wasLoaded()) {
+    cerr << "No current imdbcastcache in " << directory << ", so the castCache row times a full build." << endl;
+  }
+  results.push_back(replay("castCache", 1, 1, [&](size_t, size_t& checksum) -> size_t {
+    cache.reset(new castCache(db, directory));
+    checksum += cache->getNumFilms();
+    return cache->getNumCached();
+  }));
+  results.push_back(replay("cachedSearch", queries.pairs.size(), numRounds, [&](size_t i, size_t& checksum) -> size_t {
+    path result(queries.pairs[i].first);
+    searchStats stats;
+    if (forwardSearch(db, *cache, queries.pairs[i].first, queries.pairs[i].second, kMaxSearchDepth, result, stats)) {
+      checksum += result.getLength();
+    }
+    return stats.recordsDecoded();
+  }));
+
+  // The snapshot searches, each resolving names to IDs inside the timed query, as search does
+  if (snapshotFileName.empty()) snapshotFileName = directory + "/" + kIMDBGraphFileName;
+  imdbGraph graph(snapshotFileName, directory);
+  if (!graph.good()) {
+    cerr << "Snapshot " << snapshotFileName << " is " << (graph.isStale() ? "out of date" : "missing or malformed")
+         << ", so the snapshot searches are skipped." << endl;
+  }
+  for (int mode = 0; mode < 3 && graph.good(); mode++) {
+    const char *const ops[] = {"snapshotForwardSearch", "snapshotBidirectionalSearch", "parallelSearch"};
+    results.push_back(replay(ops[mode], queries.pairs.size(), numRounds, [&](size_t i, size_t& checksum) -> size_t {
+      int start = graph.getActorId(queries.pairs[i].first);
+      int target = graph.getActorId(queries.pairs[i].second);
+      if (start == -1 || target == -1) return 0;
+      path result(queries.pairs[i].first);
+      searchStats stats;
+      bool found = mode == 0 ? forwardSearch(graph, start, target, kMaxSearchDepth, result, stats) :
+        mode == 1 ? bidirectionalSearch(graph, start, target, kMaxSearchDepth, result, stats) :
+        parallelSearch(graph, start, target, kMaxSearchDepth, numThreads, result, stats);
+      if (found) checksum += result.getLength();
+      return stats.recordsDecoded();
+    }));
+  }
+
+  cout << "op\tqueries\tseconds\tqps\tp50_us\tp90_us\tp99_us\tmax_us\tminflt\tmajflt\twork\tchecksum" << endl;
+  for (benchResult& result: results) printResult(result);
+  return 0;
+}
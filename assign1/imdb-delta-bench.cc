@@ -0,0 +1,311 @@
+/**
+ * File: imdb-delta-bench.cc
+ * -------------------------
+ * Measures what the delta overlay costs queries.  A scratch data directory is
+ * set up whose actordata, moviedata and imdbindex are links to the real ones, and
+ * a delta of random changes is appended there: credits added to and removed from
+ * existing films, and brand new films.  The updated database is then compacted
+ * into a second scratch directory, so the same data can be queried two ways: as
+ * the original files with the delta merged in on the fly, and as plain data files
+ * (base-only).  Both imdbs answer the same work, alternating round by round:
+ *
+ *     lookups   getCredits for every actor, and getCast for each of their films
+ *     searches  a forwardSearch for every tab-separated actor pair on standard input
+ *
+ * and the time each imdb takes is printed, along with the overlay's overhead.
+ *
+ * Before timing anything, the benchmark also checks that snapshots keep up with the
+ * delta: a snapshot written before the delta was appended must be rejected as stale,
+ * and one rebuilt afterwards must report the credits the delta changed.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "imdb-graph.h"
+#include "path.h"
+#include "search-engine.h"
+using namespace std;
+using namespace std::chrono;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kSnapshotCheckFailed = 3;
+static const size_t kMaxSearchDepth = 7;
+static const size_t kDefaultNumChanges = 1000;
+static const size_t kDefaultNumRounds = 10;
+static const size_t kNewFilmCastSize = 3;
+static const size_t kActorsPerSlice = 256;
+static const char *const kDataFileNames[] = {"actordata", "moviedata", "imdbindex"};
+static const char *const kRebuiltSnapshotFileName = "imdbgraph.rebuilt";
+
+/**
+ * Function: timeLookups
+ * ---------------------
+ * Pulls the credits of players[first] through players[last - 1], and the cast of every
+ * one of those films, and returns the number of milliseconds it took.  total is updated
+ * with the number of cast members seen, so the work can't be optimized away.
+ */
+static double timeLookups(const imdb& db, const vector<string>& players, size_t first, size_t last,
+                          size_t& total) {
+  steady_clock::time_point start = steady_clock::now();
+  for (size_t i = first; i < last; i++) {
+    vector<film> credits;
+    db.getCredits(players[i], credits);
+    for (const film& movie: credits) {
+      vector<string> cast;
+      db.getCast(movie, cast);
+      total += cast.size();
+    }
+  }
+  return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+/**
+ * Function: timeSearch
+ * --------------------
+ * Runs a forward search for the specified pair, and returns the number of milliseconds
+ * it took.  total is updated with the length of the path.
+ */
+static double timeSearch(const imdb& db, const pair<string, string>& query, size_t& total) {
+  steady_clock::time_point start = steady_clock::now();
+  path result(query.first);
+  searchStats stats;
+  if (forwardSearch(db, query.first, query.second, kMaxSearchDepth, result, stats)) total += result.getLength();
+  return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+/**
+ * Function: appendRandomChanges
+ * -----------------------------
+ * Appends the specified number of random changes to the delta in the specified
+ * directory: half add an existing actor to an existing film, a quarter remove an
+ * existing credit, and the rest add a new film with a small cast.
+ */
+static void appendRandomChanges(const imdb& db, const string& directory, const vector<string>& players,
+                                size_t numChanges) {
+  mt19937 generator(110);
+  uniform_int_distribution<size_t> pickPlayer(0, players.size() - 1);
+  for (size_t i = 0; i < numChanges; i++) {
+    const string& player = players[pickPlayer(generator)];
+    vector<film> credits;
+    db.getCredits(player, credits);
+    if (credits.empty()) continue;
+    film movie = credits[generator() % credits.size()];
+
+    switch (i % 4) {
+    case 0:
+      imdb::appendDelta(directory, false, player, movie);
+      break;
+    case 1: {
+      film newFilm;
+      newFilm.title = "Delta Film " + to_string(i);
+      newFilm.year = 1900 + generator() % 128;
+      for (size_t j = 0; j < kNewFilmCastSize; j++) {
+        imdb::appendDelta(directory, true, players[pickPlayer(generator)], newFilm);
+      }
+      break;
+    }
+    default:
+      imdb::appendDelta(directory, true, players[pickPlayer(generator)], movie);
+      break;
+    }
+  }
+}
+
+/**
+ * Function: snapshotCredits
+ * -------------------------
+ * Returns the films the specified snapshot credits the specified actor with, in the
+ * order imdb::getCredits would report them, or an empty list if the actor isn't there.
+ */
+static vector<film> snapshotCredits(const imdbGraph& graph, const string& player) {
+  vector<film> credits;
+  int actor = graph.getActorId(player);
+  if (actor == -1) return credits;
+  for (uint32_t movie: graph.getCredits(actor)) credits.push_back(graph.getFilm(movie));
+  return credits;
+}
+
+/**
+ * Function: checkSnapshotTracksDelta
+ * ----------------------------------
+ * Checks that the snapshot written to the specified directory before its delta was
+ * appended is now rejected as stale, and that a snapshot rebuilt from the updated imdb
+ * reports the updated credits of every actor whose credits the delta changed.  Returns
+ * the number of such actors, or -1 (after explaining why on standard error) if either
+ * check fails or the delta changed nothing.
+ */
+static int checkSnapshotTracksDelta(const imdb& updated, const string& directory, const vector<string>& players) {
+  string staleFileName = directory + "/" + kIMDBGraphFileName;
+  string rebuiltFileName = directory + "/" + kRebuiltSnapshotFileName;
+  imdbGraph checked(staleFileName, directory);
+  if (checked.good() || !checked.isStale()) {
+    cerr << "A snapshot written before the delta wasn't rejected as stale!" << endl;
+    return -1;
+  }
+  if (!imdbGraph::writeSnapshot(updated, rebuiltFileName)) {
+    cerr << "Couldn't write the rebuilt snapshot!" << endl;
+    return -1;
+  }
+
+  imdbGraph stale(staleFileName);
+  imdbGraph rebuilt(rebuiltFileName, directory);
+  if (!stale.good() || !rebuilt.good()) {
+    cerr << "A snapshot didn't validate!" << endl;
+    return -1;
+  }
+  int numChanged = 0;
+  for (const string& player: players) {
+    vector<film> credits;
+    updated.getCredits(player, credits);
+    if (snapshotCredits(stale, player) == credits) continue;
+    numChanged++;
+    if (snapshotCredits(rebuilt, player) != credits) {
+      cerr << "The rebuilt snapshot doesn't reflect the delta's changes to " << player << "!" << endl;
+      return -1;
+    }
+  }
+  if (numChanged == 0) cerr << "The delta didn't change anyone's credits!" << endl;
+  return numChanged > 0 ? numChanged : -1;
+}
+
+/**
+ * Function: removeScratchDirectory
+ * --------------------------------
+ * Removes everything the benchmark created in the specified directory.
+ */
+static void removeScratchDirectory(const string& directory) {
+  for (const char *name: kDataFileNames) unlink((directory + "/" + name).c_str());
+  unlink((directory + "/imdbdelta").c_str());
+  unlink((directory + "/" + kIMDBGraphFileName).c_str());
+  unlink((directory + "/" + kRebuiltSnapshotFileName).c_str());
+  rmdir(directory.c_str());
+}
+
+int main(int argc, char *argv[]) {
+  size_t numChanges = kDefaultNumChanges;
+  size_t numRounds = kDefaultNumRounds;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+    if (opt == 'n') {
+      numChanges = strtoul(optarg, NULL, 10);
+    } else if (opt == 'r' && atoi(optarg) > 0) {
+      numRounds = atoi(optarg);
+    } else {
+      cerr << "Usage: " << argv[0] << " [-n <changes>] [-r <rounds>] < pairs" << endl;
+      return kWrongArgumentCount;
+    }
+  }
+
+  vector<pair<string, string>> pairs;
+  string line;
+  while (getline(cin, line)) {
+    size_t tab = line.find('\t');
+    if (tab != string::npos) pairs.push_back(make_pair(line.substr(0, tab), line.substr(tab + 1)));
+  }
+
+  char overlayScratch[] = "/tmp/imdb-delta-bench.XXXXXX";
+  char compactedScratch[] = "/tmp/imdb-delta-bench.XXXXXX";
+  if (mkdtemp(overlayScratch) == NULL || mkdtemp(compactedScratch) == NULL) {
+    cerr << "Couldn't create the scratch directories!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+  string overlayDirectory = overlayScratch;
+  string compactedDirectory = compactedScratch;
+  for (const char *name: kDataFileNames) {
+    symlink((kIMDBDataDirectory + name).c_str(), (overlayDirectory + "/" + name).c_str());
+  }
+
+  vector<string> players;
+  {
+    imdb original(overlayDirectory);
+    if (!original.good()) {
+      cerr << "Data directory not found!  Aborting..." << endl;
+      removeScratchDirectory(overlayDirectory);
+      removeScratchDirectory(compactedDirectory);
+      return kDatabaseNotFound;
+    }
+    original.getPlayers(players);
+    imdbGraph::writeSnapshot(original, overlayDirectory + "/" + kIMDBGraphFileName);
+    appendRandomChanges(original, overlayDirectory, players, numChanges);
+  }
+
+  imdb overlay(overlayDirectory);
+  players.clear();
+  overlay.getPlayers(players);
+  int numChangedActors = checkSnapshotTracksDelta(overlay, overlayDirectory, players);
+  if (numChangedActors < 0) {
+    removeScratchDirectory(overlayDirectory);
+    removeScratchDirectory(compactedDirectory);
+    return kSnapshotCheckFailed;
+  }
+  if (!overlay.compact(compactedDirectory)) {
+    cerr << "Couldn't compact the updated database!  Aborting..." << endl;
+    removeScratchDirectory(overlayDirectory);
+    removeScratchDirectory(compactedDirectory);
+    return kDatabaseNotFound;
+  }
+  imdb base(compactedDirectory);
+  players.clear();
+  base.getPlayers(players);
+
+  // The work is split into small slices, and each slice is timed against both imdbs back
+  // to back (taking turns going first) so that both see the same machine conditions.  Each
+  // imdb's best time for each slice is kept, and the bests are summed.
+  const imdb *databases[] = {&base, &overlay};
+  size_t numSlices = (players.size() + kActorsPerSlice - 1) / kActorsPerSlice;
+  vector<double> lookupTimes[2], searchTimes[2];
+  for (size_t which = 0; which < 2; which++) {
+    lookupTimes[which].assign(numSlices, 0);
+    searchTimes[which].assign(pairs.size(), 0);
+  }
+
+  size_t total = 0;
+  for (size_t round = 0; round < numRounds; round++) {
+    for (size_t turn = 0; turn < 2; turn++) {
+      for (size_t i = 0; i < numSlices; i++) {
+        size_t which = (round + turn + i) % 2;
+        double time = timeLookups(*databases[which], players, i * kActorsPerSlice,
+                                  min(players.size(), (i + 1) * kActorsPerSlice), total);
+        if (round == 0 || time < lookupTimes[which][i]) lookupTimes[which][i] = time;
+      }
+      for (size_t i = 0; i < pairs.size(); i++) {
+        size_t which = (round + turn + i) % 2;
+        double time = timeSearch(*databases[which], pairs[i], total);
+        if (round == 0 || time < searchTimes[which][i]) searchTimes[which][i] = time;
+      }
+    }
+  }
+  double baseLookups = accumulate(lookupTimes[0].begin(), lookupTimes[0].end(), 0.0);
+  double overlayLookups = accumulate(lookupTimes[1].begin(), lookupTimes[1].end(), 0.0);
+  double baseSearches = accumulate(searchTimes[0].begin(), searchTimes[0].end(), 0.0);
+  double overlaySearches = accumulate(searchTimes[1].begin(), searchTimes[1].end(), 0.0);
+  removeScratchDirectory(overlayDirectory);
+  removeScratchDirectory(compactedDirectory);
+
+  cout << numChanges << " changes, " << players.size() << " actors, " << pairs.size() << " pairs, best of "
+       << numRounds << " rounds (checksum " << total << ")" << endl;
+  cout << "Snapshots track the delta: the old one is rejected as stale, and a rebuilt one reflects all "
+       << numChangedActors << " actors it changed." << endl;
+  cout << left << setw(10) << "work" << right << setw(12) << "base ms" << setw(12) << "overlay ms"
+       << setw(12) << "overhead" << endl;
+  cout << fixed << setprecision(2);
+  cout << left << setw(10) << "lookups" << right << setw(12) << baseLookups << setw(12) << overlayLookups
+       << setw(11) << 100 * (overlayLookups - baseLookups) / baseLookups << "%" << endl;
+  if (!pairs.empty()) {
+    cout << left << setw(10) << "searches" << right << setw(12) << baseSearches << setw(12) << overlaySearches
+         << setw(11) << 100 * (overlaySearches - baseSearches) / baseSearches << "%" << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * File: imdb-delta.cc
+ * -------------------
+ * Command line front end to the imdb's delta overlay.  The first two forms append
+ * a single change to the data directory's delta file, and the third folds the delta
+ * into fresh actordata and moviedata files (see imdb::compact), writing them into
+ * the specified output directory, or back into the data directory if none is given.
+ *
+ *    imdb-delta [-d <data directory>] add <actor> <title> <year>
+ *    imdb-delta [-d <data directory>] remove <actor> <title> <year>
+ *    imdb-delta [-d <data directory>] compact [<output directory>]
+ */
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <unistd.h>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "imdb-graph.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kUpdateFailed = 3;
+
+/**
+ * Function: printUsageAndExit
+ * ---------------------------
+ * Prints the expected command lines to standard error and exits.
+ */
+static void printUsageAndExit(const char *progname) {
+  cerr << "Usage: " << progname << " [-d <data directory>] add <actor> <title> <year>" << endl;
+  cerr << "       " << progname << " [-d <data directory>] remove <actor> <title> <year>" << endl;
+  cerr << "       " << progname << " [-d <data directory>] compact [<output directory>]" << endl;
+  exit(kWrongArgumentCount);
+}
+
+int main(int argc, char *argv[]) {
+  string directory = kIMDBDataDirectory;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:")) != -1) {
+    if (opt != 'd') printUsageAndExit(argv[0]);
+    directory = optarg;
+  }
+  if (argc - optind < 1) printUsageAndExit(argv[0]);
+  string command = argv[optind];
+
+  if (command == "add" || command == "remove") {
+    if (argc - optind != 4) printUsageAndExit(argv[0]);
+    film movie;
+    movie.title = argv[optind + 2];
+    movie.year = atoi(argv[optind + 3]);
+    if (!imdb::appendDelta(directory, command == "add", argv[optind + 1], movie)) {
+      cerr << "Couldn't record that change (years must be within [1900, 2027], and names and "
+           << "titles can't hold tabs or newlines)." << endl;
+      return kUpdateFailed;
+    }
+    return 0;
+  }
+
+  if (command != "compact" || argc - optind > 2) printUsageAndExit(argv[0]);
+  string outputDirectory = argc - optind == 2 ? argv[optind + 1] : directory;
+  imdb db(directory);
+  if (!db.good()) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+  if (!db.compact(outputDirectory)) {
+    cerr << "Couldn't write the compacted data files to " << outputDirectory << "." << endl;
+    return kUpdateFailed;
+  }
+  if (access((outputDirectory + "/" + kIMDBGraphFileName).c_str(), F_OK) == 0) {
+    cerr << "search ignores the now stale " << kIMDBGraphFileName << " in " << outputDirectory
+         << " until it's rebuilt with imdb-snapshot." << endl;
+  }
+  return 0;
+}
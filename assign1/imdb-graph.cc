@@ -0,0 +1,194 @@
+/**
+ * File: imdb-graph.cc
+ * -------------------
+ * Presents the implementation of the imdbGraph class, which includes the code
+ * that builds a snapshot from an imdb in the first place.
+ */
+
+#include "imdb-graph.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+using namespace std;
+
+const uint32_t imdbGraph::kSnapshotMagic = 0x47424449; // "IDBG" when viewed as little-endian bytes
+const uint32_t imdbGraph::kSnapshotVersion = 2;
+
+imdbGraph::imdbGraph(const string& fileName, const string& dataDirectory) :
+  fileSize(0), fileMap(MAP_FAILED), stale(false), header(NULL) {
+  fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) return;
+
+  struct stat stats;
+  if (fstat(fd, &stats) == -1 || (size_t) stats.st_size < sizeof(snapshotHeader)) return;
+  fileSize = stats.st_size;
+  fileMap = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (fileMap == MAP_FAILED) return;
+
+  const snapshotHeader *candidate = (const snapshotHeader *) fileMap;
+  if (candidate->magic != kSnapshotMagic || candidate->version != kSnapshotVersion) return;
+
+  size_t numWords = (candidate->numActors + 1) + candidate->numCredits +
+    (candidate->numFilms + 1) + candidate->numCastMembers +
+    candidate->numActors + 2 * candidate->numFilms;
+  if (fileSize != sizeof(snapshotHeader) + numWords * sizeof(uint32_t) + candidate->poolSize) return;
+
+  dataStamp current;
+  if (!dataDirectory.empty() && imdb::readStamp(dataDirectory, current) && current != candidate->source) {
+    stale = true;
+    return;
+  }
+
+  const uint32_t *words = (const uint32_t *)(candidate + 1);
+  actorCreditOffsets = words; words += candidate->numActors + 1;
+  actorCredits = words;       words += candidate->numCredits;
+  filmCastOffsets = words;    words += candidate->numFilms + 1;
+  filmCast = words;           words += candidate->numCastMembers;
+  actorNames = words;         words += candidate->numActors;
+  filmTitles = words;         words += candidate->numFilms;
+  filmYears = words;          words += candidate->numFilms;
+  stringPool = (const char *) words;
+  header = candidate;
+}
+
+imdbGraph::~imdbGraph() {
+  if (fileMap != MAP_FAILED) munmap((void *) fileMap, fileSize);
+  if (fd != -1) close(fd);
+}
+
+int imdbGraph::getActorId(const string& player) const {
+  const uint32_t *end = actorNames + header->numActors;
+  const uint32_t *found = lower_bound(actorNames, end, player, [this](uint32_t offset, const string& player) {
+    return strcmp(stringPool + offset, player.c_str()) < 0;
+  });
+  if (found == end || player != stringPool + *found) return -1;
+  return found - actorNames;
+}
+
+int imdbGraph::getFilmId(const film& movie) const {
+  // films are sorted by title, and then by year, so binary search over both
+  int low = 0, high = header->numFilms;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    int cmp = strcmp(stringPool + filmTitles[mid], movie.title.c_str());
+    if (cmp < 0 || (cmp == 0 && (int) filmYears[mid] < movie.year)) low = mid + 1;
+    else high = mid;
+  }
+  if (low == (int) header->numFilms) return -1;
+  if (movie.title != stringPool + filmTitles[low] || (int) filmYears[low] != movie.year) return -1;
+  return low;
+}
+
+film imdbGraph::getFilm(int movie) const {
+  film f;
+  f.title = stringPool + filmTitles[movie];
+  f.year = filmYears[movie];
+  return f;
+}
+
+/**
+ * Function: appendString
+ * ----------------------
+ * Tacks the specified string (and its '\0') onto the end of the pool,
+ * and returns the offset where it begins.
+ */
+static uint32_t appendString(vector<char>& pool, const string& str) {
+  uint32_t offset = pool.size();
+  pool.insert(pool.end(), str.c_str(), str.c_str() + str.size() + 1);
+  return offset;
+}
+
+/**
+ * Function: writeArray
+ * --------------------
+ * Writes the contents of the specified vector to the output stream, as is.
+ */
+template <typename T>
+static void writeArray(ofstream& out, const vector<T>& array) {
+  out.write((const char *) array.data(), array.size() * sizeof(T));
+}
+
+bool imdbGraph::writeSnapshot(const imdb& db, const string& fileName) {
+  // Actor IDs are positions in the (already sorted) list of actors
+  vector<string> players;
+  db.getPlayers(players);
+
+  // Film IDs are positions in the sorted list of every film anyone appeared in
+  vector<film> films;
+  for (const string& player: players) {
+    vector<film> credits;
+    db.getCredits(player, credits);
+    films.insert(films.end(), credits.begin(), credits.end());
+  }
+  sort(films.begin(), films.end());
+  films.erase(unique(films.begin(), films.end()), films.end());
+
+  vector<uint32_t> actorCreditOffsets(1, 0), actorCredits;
+  for (const string& player: players) {
+    vector<film> credits;
+    db.getCredits(player, credits);
+    for (const film& movie: credits) {
+      actorCredits.push_back(lower_bound(films.begin(), films.end(), movie) - films.begin());
+    }
+    actorCreditOffsets.push_back(actorCredits.size());
+  }
+
+  vector<uint32_t> filmCastOffsets(1, 0), filmCast;
+  for (const film& movie: films) {
+    vector<string> cast;
+    db.getCast(movie, cast);
+    for (const string& player: cast) {
+      vector<string>::const_iterator found = lower_bound(players.begin(), players.end(), player);
+      if (found == players.end() || *found != player) return false; // actordata and moviedata disagree
+      filmCast.push_back(found - players.begin());
+    }
+    filmCastOffsets.push_back(filmCast.size());
+  }
+
+  vector<char> pool;
+  vector<uint32_t> actorNames, filmTitles, filmYears;
+  for (const string& player: players) actorNames.push_back(appendString(pool, player));
+  for (const film& movie: films) {
+    filmTitles.push_back(appendString(pool, movie.title));
+    filmYears.push_back(movie.year);
+  }
+
+  snapshotHeader header;
+  memset(&header, 0, sizeof(header)); // so padding is written as zeroes
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.numActors = players.size();
+  header.numFilms = films.size();
+  header.numCredits = actorCredits.size();
+  header.numCastMembers = filmCast.size();
+  header.poolSize = pool.size();
+  db.getStamp(header.source);
+
+  // Write to a private file and rename it into place, so a process mapping the old
+  // snapshot never sees it truncated or half written
+  string tempFileName = fileName + "." + to_string(getpid());
+  ofstream out(tempFileName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out) return false;
+  out.write((const char *) &header, sizeof(header));
+  writeArray(out, actorCreditOffsets);
+  writeArray(out, actorCredits);
+  writeArray(out, filmCastOffsets);
+  writeArray(out, filmCast);
+  writeArray(out, actorNames);
+  writeArray(out, filmTitles);
+  writeArray(out, filmYears);
+  writeArray(out, pool);
+  out.close();
+  if (out.fail() || rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+    unlink(tempFileName.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,178 @@
+/**
+ * File: imdb-graph.h
+ * ------------------
+ * Defines the imdbGraph class, which layers an integer-only view of the imdb on top of
+ * a compact snapshot file.  Every actor/actress and every film is assigned a dense ID
+ * (its position in the sorted order used by the original actordata and moviedata files),
+ * and the snapshot stores both directions of the actor-film relation in compressed sparse
+ * row (CSR) form, alongside a pool of the names and titles those IDs stand for.
+ *
+ * The snapshot is built once from an imdb (see imdb-snapshot.cc) and memory mapped
+ * thereafter, so lookups return spans pointing directly into the mapping and never
+ * allocate.  Names are only needed when a result is printed.  The snapshot records
+ * the dataStamp of the data directory it was built from, so that a snapshot left behind
+ * by a delta or a compaction can be recognized and passed over.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include "imdb.h"
+#include "imdb-utils.h"
+
+/**
+ * Constant: kIMDBGraphFileName
+ * ----------------------------
+ * The name the snapshot file is given when it's stored alongside
+ * the actordata and moviedata files it was built from.
+ */
+const std::string kIMDBGraphFileName("imdbgraph");
+
+/**
+ * Convenience struct: idSpan
+ * --------------------------
+ * A read-only window onto a contiguous run of actor or film IDs that live in the
+ * snapshot's memory map.  It's cheap to copy and supports range-based for loops.
+ */
+struct idSpan {
+  const uint32_t *first;
+  size_t count;
+
+  const uint32_t *begin() const { return first; }
+  const uint32_t *end() const { return first + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  uint32_t operator[](size_t i) const { return first[i]; }
+};
+
+class imdbGraph {
+ public:
+
+/**
+ * Constructor: imdbGraph
+ * ----------------------
+ * Maps the snapshot stored in the specified file.  If the file is missing, can't be read,
+ * or isn't a well-formed snapshot, then the imdbGraph is constructed anyway but good()
+ * will return false.  The same goes for a snapshot built from a different state of the
+ * specified data directory (different data files, or a different delta), which would
+ * answer queries with outdated credits.  Snapshots are checked against the data directory
+ * only when one is given and its data files exist.
+ *
+ * @param fileName the name of the snapshot file written by imdbGraph::writeSnapshot.
+ * @param dataDirectory the directory holding the data files the snapshot should describe.
+ */
+  imdbGraph(const std::string& fileName, const std::string& dataDirectory = "");
+
+/**
+ * Predicate Methods: good
+ *                    isStale
+ * --------------------------
+ * good returns true if and only if the snapshot was mapped and validated without
+ * incident.  isStale returns true if the snapshot was well-formed, but rejected because
+ * the data directory has changed since it was built.
+ */
+  bool good() const { return header != NULL; }
+  bool isStale() const { return stale; }
+
+/**
+ * Methods: getNumActors
+ *          getNumFilms
+ * ----------------------
+ * Return the number of actors and films in the snapshot.  Valid actor IDs are
+ * 0 through getNumActors() - 1, and similarly for films.
+ */
+  size_t getNumActors() const { return header->numActors; }
+  size_t getNumFilms() const { return header->numFilms; }
+
+/**
+ * Methods: getActorId
+ *          getFilmId
+ * --------------------
+ * Maps a name or film onto its dense ID via binary search over the sorted
+ * string pool.  Returns -1 if the actor or film isn't in the snapshot.
+ */
+  int getActorId(const std::string& player) const;
+  int getFilmId(const film& movie) const;
+
+/**
+ * Methods: getCredits
+ *          getCast
+ * -------------------
+ * Return the IDs of the films the specified actor appeared in, and the IDs of the
+ * actors appearing in the specified film.  The order matches the order imdb::getCredits
+ * and imdb::getCast report them in.  The IDs must be valid.
+ */
+  idSpan getCredits(int actor) const { return idSpan{actorCredits + actorCreditOffsets[actor],
+      actorCreditOffsets[actor + 1] - actorCreditOffsets[actor]}; }
+  idSpan getCast(int movie) const { return idSpan{filmCast + filmCastOffsets[movie],
+      filmCastOffsets[movie + 1] - filmCastOffsets[movie]}; }
+
+/**
+ * Methods: getActorName
+ *          getFilm
+ * -----------------------
+ * Resolve an ID back into the name (or film) it stands for.  The IDs must be valid.
+ */
+  const char *getActorName(int actor) const { return stringPool + actorNames[actor]; }
+  film getFilm(int movie) const;
+
+/**
+ * Method: getFilmYear
+ * -------------------
+ * Returns the release year of the specified film, without building the film
+ * itself.  The ID must be valid.
+ */
+  int getFilmYear(int movie) const { return filmYears[movie]; }
+
+/**
+ * Static Method: writeSnapshot
+ * ----------------------------
+ * Walks the entire specified imdb and writes the snapshot of it to the specified
+ * file.  The snapshot is written beside the file and renamed over it, so the file
+ * always holds either the old snapshot or the new one in full, and processes that
+ * already map the old one keep it.  Returns true if and only if the new snapshot
+ * was put in place.
+ */
+  static bool writeSnapshot(const imdb& db, const std::string& fileName);
+
+/**
+ * Destructor: ~imdbGraph
+ * ----------------------
+ * Unmaps the snapshot.
+ */
+  ~imdbGraph();
+
+ private:
+  static const uint32_t kSnapshotMagic;
+  static const uint32_t kSnapshotVersion;
+
+  // The file begins with this header, followed by the arrays below in this order.
+  struct snapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numActors;
+    uint32_t numFilms;
+    uint32_t numCredits;
+    uint32_t numCastMembers;
+    uint32_t poolSize;
+    dataStamp source; // the state of the data directory the snapshot was built from
+  };
+
+  int fd;
+  size_t fileSize;
+  const void *fileMap;
+  bool stale;
+
+  const snapshotHeader *header;
+  const uint32_t *actorCreditOffsets; // numActors + 1 entries, indexes actorCredits
+  const uint32_t *actorCredits;       // numCredits film IDs
+  const uint32_t *filmCastOffsets;    // numFilms + 1 entries, indexes filmCast
+  const uint32_t *filmCast;           // numCastMembers actor IDs
+  const uint32_t *actorNames;         // numActors offsets into stringPool
+  const uint32_t *filmTitles;         // numFilms offsets into stringPool
+  const uint32_t *filmYears;          // numFilms years
+  const char *stringPool;             // poolSize bytes of '\0'-terminated strings
+
+  imdbGraph(const imdbGraph& original) = delete;
+  imdbGraph& operator=(const imdbGraph& rhs) = delete;
+};
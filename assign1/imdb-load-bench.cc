@@ -0,0 +1,194 @@
+/**
+ * File: imdb-load-bench.cc
+ * ------------------------
+ * Compares the imdb load policies (see loadPolicy in imdb.h) by the time the
+ * constructor takes, the time the first search takes once the constructor has
+ * returned, and the page faults each of the two incurs.  Every measurement runs
+ * in a freshly forked process, so no policy inherits another's mappings.
+ *
+ * Each policy is measured twice: once cold, with the data files evicted from the
+ * page cache beforehand (via posix_fadvise, which needs no special privileges), and
+ * once warm, with the files already cached, which is what a server restarting on a
+ * busy machine would see.  The median over the requested number of rounds is
+ * printed.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "path.h"
+#include "search-engine.h"
+using namespace std;
+using namespace std::chrono;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const size_t kMaxSearchDepth = 7;
+static const size_t kDefaultNumRounds = 5;
+static const char *const kDataFileNames[] = {"actordata", "moviedata", "imdbindex"};
+
+/**
+ * Convenience struct: loadSample
+ * ------------------------------
+ * One child process's measurements, passed back to the parent through a pipe.
+ */
+struct loadSample {
+  bool good;
+  double startupMs;
+  double firstQueryMs;
+  long startupMinorFaults;
+  long startupMajorFaults;
+  long queryMinorFaults;
+  long queryMajorFaults;
+};
+
+/**
+ * Function: evictDataFiles
+ * ------------------------
+ * Asks the kernel to drop the data files' pages from the page cache, so the
+ * next process to touch them has to read them from disk.
+ */
+static void evictDataFiles() {
+  for (const char *name: kDataFileNames) {
+    int fd = open((kIMDBDataDirectory + name).c_str(), O_RDONLY);
+    if (fd == -1) continue;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+/**
+ * Function: measure
+ * -----------------
+ * Constructs an imdb with the specified policy and runs one forward search,
+ * recording the time and page faults attributable to each.  This runs in the
+ * child process.
+ */
+static loadSample measure(loadPolicy policy, const string& startingActor, const string& targetActor) {
+  loadSample sample = loadSample();
+  struct rusage before, constructed, searched;
+  getrusage(RUSAGE_SELF, &before);
+  steady_clock::time_point start = steady_clock::now();
+  imdb db(kIMDBDataDirectory, policy);
+  steady_clock::time_point ready = steady_clock::now();
+  getrusage(RUSAGE_SELF, &constructed);
+  if (!db.good()) return sample;
+
+  path result(startingActor);
+  searchStats stats;
+  forwardSearch(db, startingActor, targetActor, kMaxSearchDepth, result, stats);
+  steady_clock::time_point answered = steady_clock::now();
+  getrusage(RUSAGE_SELF, &searched);
+
+  sample.good = true;
+  sample.startupMs = duration<double, milli>(ready - start).count();
+  sample.firstQueryMs = duration<double, milli>(answered - ready).count();
+  sample.startupMinorFaults = constructed.ru_minflt - before.ru_minflt;
+  sample.startupMajorFaults = constructed.ru_majflt - before.ru_majflt;
+  sample.queryMinorFaults = searched.ru_minflt - constructed.ru_minflt;
+  sample.queryMajorFaults = searched.ru_majflt - constructed.ru_majflt;
+  return sample;
+}
+
+/**
+ * Function: measureInChild
+ * ------------------------
+ * Forks a child to run measure, and returns what it reports.
+ */
+static loadSample measureInChild(loadPolicy policy, const string& startingActor, const string& targetActor) {
+  int fds[2];
+  if (pipe(fds) == -1) exit(kDatabaseNotFound);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    loadSample sample = measure(policy, startingActor, targetActor);
+    ssize_t count = write(fds[1], &sample, sizeof(sample));
+    _exit(count == sizeof(sample) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  loadSample sample = loadSample();
+  if (read(fds[0], &sample, sizeof(sample)) != sizeof(sample)) sample.good = false;
+  close(fds[0]);
+  waitpid(pid, NULL, 0);
+  return sample;
+}
+
+/**
+ * Function: median
+ * ----------------
+ * Returns the median of the specified field across the samples.
+ */
+template <typename T>
+static T median(const vector<loadSample>& samples, T loadSample::*field) {
+  vector<T> values;
+  for (const loadSample& sample: samples) values.push_back(sample.*field);
+  sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+  size_t numRounds = kDefaultNumRounds;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:")) != -1) {
+    if (opt != 'r' || (numRounds = atoi(optarg)) == 0) {
+      cerr << "Usage: " << argv[0] << " [-r <rounds>] <actor1> <actor2>" << endl;
+      return kWrongArgumentCount;
+    }
+  }
+  if (argc - optind != 2) {
+    cerr << "Usage: " << argv[0] << " [-r <rounds>] <actor1> <actor2>" << endl;
+    return kWrongArgumentCount;
+  }
+  string startingActor = argv[optind];
+  string targetActor = argv[optind + 1];
+
+  const loadPolicy policies[] = {kLazyLoad, kPopulateLoad, kAdviseLoad, kHugePageLoad};
+  const char *const policyNames[] = {"lazy", "populate", "advise", "hugepage"};
+  cout << left << setw(10) << "policy" << setw(6) << "cache" << right
+       << setw(12) << "startup ms" << setw(10) << "minflt" << setw(8) << "majflt"
+       << setw(12) << "query ms" << setw(10) << "minflt" << setw(8) << "majflt"
+       << setw(12) << "total ms" << endl;
+  cout.flush(); // the children inherit unflushed output otherwise
+
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    for (int warm = 0; warm < 2; warm++) {
+      vector<loadSample> samples;
+      for (size_t round = 0; round < numRounds; round++) {
+        if (warm) {
+          measureInChild(policies[i], startingActor, targetActor); // prime the page cache, untimed
+        } else {
+          evictDataFiles();
+        }
+        loadSample sample = measureInChild(policies[i], startingActor, targetActor);
+        if (!sample.good) {
+          cerr << "Data directory not found!  Aborting..." << endl;
+          return kDatabaseNotFound;
+        }
+        samples.push_back(sample);
+      }
+
+      double startupMs = median(samples, &loadSample::startupMs);
+      double firstQueryMs = median(samples, &loadSample::firstQueryMs);
+      cout << left << setw(10) << policyNames[i] << setw(6) << (warm ? "warm" : "cold") << right
+           << fixed << setprecision(2)
+           << setw(12) << startupMs << setw(10) << median(samples, &loadSample::startupMinorFaults)
+           << setw(8) << median(samples, &loadSample::startupMajorFaults)
+           << setw(12) << firstQueryMs << setw(10) << median(samples, &loadSample::queryMinorFaults)
+           << setw(8) << median(samples, &loadSample::queryMajorFaults)
+           << setw(12) << startupMs + firstQueryMs << endl;
+      cout.flush();
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+/**
+ * File: imdb-snapshot.cc
+ * ----------------------
+ * One-time converter that walks the actordata and moviedata files backing the imdb
+ * and writes the imdbGraph snapshot of them.  Copy (or write) the snapshot into the
+ * data directory as imdbgraph and search picks it up automatically; otherwise
+ * hand it to search via -g.  Either way, it's only used until the data files or
+ * the delta change, after which it needs to be rebuilt.
+ */
+
+#include <iostream>
+#include <string>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "imdb-graph.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kSnapshotFailure = 3;
+
+int main(int argc, char *argv[]) {
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [<snapshot file>]" << endl;
+    return kWrongArgumentCount;
+  }
+
+  imdb db(kIMDBDataDirectory);
+  if (!db.good()) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+
+  string snapshotFileName = argc == 2 ? argv[1] : kIMDBGraphFileName;
+  if (!imdbGraph::writeSnapshot(db, snapshotFileName)) {
+    cerr << "Couldn't write snapshot to " << snapshotFileName << "!  Aborting..." << endl;
+    return kSnapshotFailure;
+  }
+
+  imdbGraph graph(snapshotFileName, kIMDBDataDirectory);
+  if (!graph.good()) {
+    cerr << "Snapshot " << snapshotFileName << " didn't validate!  Aborting..." << endl;
+    return kSnapshotFailure;
+  }
+
+  cout << "Wrote " << snapshotFileName << ": " << graph.getNumActors() << " actors, "
+       << graph.getNumFilms() << " films." << endl;
+  return 0;
+}
@@ -46,3 +46,47 @@ struct film {
   }
 };
 
+/**
+ * Convenience struct: stringView
+ * ------------------------------
+ * A non-owning window onto a run of characters that lives somewhere else
+ * (typically inside one of the imdb's memory-mapped data files).  It plays
+ * the role std::string_view would if the project were built as C++17: it's
+ * cheap to copy, never allocates, and can be compared against a std::string
+ * directly.  Call toString when an owning copy is needed.
+ */
+struct stringView {
+  const char *data;
+  size_t length;
+
+  std::string toString() const { return std::string(data, length); }
+
+  bool operator==(const std::string& rhs) const {
+    return rhs.size() == length && rhs.compare(0, length, data, length) == 0;
+  }
+  bool operator!=(const std::string& rhs) const { return !(*this == rhs); }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const stringView& view) {
+  return os.write(view.data, view.length);
+}
+
+/**
+ * Convenience struct: filmView
+ * ----------------------------
+ * The non-owning counterpart of film: the title is a stringView into the
+ * movie data file, and the year is decoded from the byte stored after it.
+ */
+struct filmView {
+  stringView title;
+  int year;
+
+  film toFilm() const {
+    film f;
+    f.title = title.toString();
+    f.year = year;
+    return f;
+  }
+
+  bool operator==(const film& rhs) const { return title == rhs.title && year == rhs.year; }
+};
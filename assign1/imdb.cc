@@ -5,31 +5,100 @@
 #include <unistd.h>
 #include <algorithm>
 #include <string>
+#include <fstream>
+#include <vector>
+#include <map>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <stdlib.h>
 #include "imdb.h"
 using namespace std;
 
 const char *const imdb::kActorFileName = "actordata";
 const char *const imdb::kMovieFileName = "moviedata";
-imdb::imdb(const string& directory) {
+const char *const imdb::kIndexFileName = "imdbindex";
+const char *const imdb::kDeltaFileName = "imdbdelta";
+
+static const uint32_t kIndexMagic = 0x58444e49; // "INDX" when viewed as little-endian bytes
+static const uint32_t kIndexVersion = 2;
+
+imdb::imdb(const string& directory, loadPolicy policy) : indexFile(NULL), policy(policy), deltaFileSize(0), actorIndex(NULL), movieIndex(NULL), actorMask(0), movieMask(0) {
   const string actorFileName = directory + "/" + kActorFileName;
   const string movieFileName = directory + "/" + kMovieFileName;  
-  actorFile = acquireFileMap(actorFileName, actorInfo);
-  movieFile = acquireFileMap(movieFileName, movieInfo);
+  actorFile = acquireFileMap(actorFileName, actorInfo, policy);
+  movieFile = acquireFileMap(movieFileName, movieInfo, policy);
+  indexInfo.fd = -1;
+  indexInfo.fileSize = 0;
+  indexInfo.fileMap = NULL;
+  indexInfo.mapSize = 0;
+  indexInfo.modTime = 0;
+  indexInfo.inode = 0;
+  if (!good()) return;
+
+  // Use the index if it's current, and otherwise try to (re)build it when we're allowed to
+  const string indexFileName = directory + "/" + kIndexFileName;
+  if (!loadIndex(indexFileName) && access(directory.c_str(), W_OK) == 0 && buildIndex(indexFileName)) {
+    loadIndex(indexFileName);
+  }
+
+  // The delta is replayed on top of the data files (looked up through the index, if there is one)
+  loadDelta(directory + "/" + kDeltaFileName);
 }
 
 bool imdb::good() const {
-  return !( (actorInfo.fd == -1) || 
-	    (movieInfo.fd == -1) ); 
+  return actorFile != NULL && movieFile != NULL;
 }
 
 imdb::~imdb() {
   releaseFileMap(actorInfo);
   releaseFileMap(movieInfo);
+  releaseFileMap(indexInfo);
 }
 
-bool imdb::getCredits(const string& player, vector<film>& films) const {
+/**
+ * Function: hashBytes
+ * -------------------
+ * 64-bit FNV-1a hash of the specified bytes, continuing from the supplied hash so
+ * that multi-part keys (e.g. a film's title and year) can be hashed piece by piece.
+ */
+static const uint64_t kFNVOffsetBasis = 14695981039346656037ULL;
+static const uint64_t kFNVPrime = 1099511628211ULL;
+static uint64_t hashBytes(const char *bytes, size_t length, uint64_t hash = kFNVOffsetBasis) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char) bytes[i];
+    hash *= kFNVPrime;
+  }
+  return hash;
+}
+
+/**
+ * Functions: hashActor
+ *            hashMovie
+ * --------------------
+ * Hash the keys stored in the actor and movie tables of the index.  A movie's year
+ * is hashed as the single byte it's stored as in the moviedata file.
+ */
+static uint64_t hashActor(const char *name, size_t length) {
+  return hashBytes(name, length);
+}
+
+static uint64_t hashMovie(const char *title, size_t length, char year) {
+  return hashBytes(&year, 1, hashBytes(title, length));
+}
+
+int imdb::findActorRecord(const string& player) const {
+  if (actorIndex != NULL) {
+    uint64_t hash = hashActor(player.c_str(), player.size());
+    for (uint32_t slot = hash & actorMask; actorIndex[slot].offset != 0; slot = (slot + 1) & actorMask) {
+      if (actorIndex[slot].fingerprint == (uint32_t) (hash >> 32) &&
+          player == (const char *) actorFile + actorIndex[slot].offset) {
+        return actorIndex[slot].offset;
+      }
+    }
+    return -1;
+  }
+
   int* firstRecord = (int*)actorFile + 1;
   int* endOflastRecord = (int*)actorFile + *((int*)actorFile) + 1;
 
@@ -39,15 +108,81 @@ bool imdb::getCredits(const string& player, vector<film>& films) const {
   });
 
   // Check if player was found in database
-  if (player != (char*)((int*)actorFile + *(result)/4)) {
-    return false;
+  if (result == endOflastRecord || player != (char*)((int*)actorFile + *(result)/4)) {
+    return -1;
+  }
+  return *result;
+}
+
+/**
+ * Function: compareTitles
+ * -----------------------
+ * Three-way comparison of a '\0'-terminated title stored in the movie data file
+ * against a title given as a pointer and length, ordered the same way std::string
+ * orders them.
+ */
+static int compareTitles(const char *recordTitle, const char *title, size_t length) {
+  size_t recordLength = strlen(recordTitle);
+  int cmp = memcmp(recordTitle, title, min(recordLength, length));
+  if (cmp != 0) return cmp;
+  return recordLength < length ? -1 : (recordLength > length ? 1 : 0);
+}
+
+int imdb::findMovieRecord(const char *title, size_t length, int year) const {
+  if (movieIndex != NULL) {
+    uint64_t hash = hashMovie(title, length, year - 1900);
+    for (uint32_t slot = hash & movieMask; movieIndex[slot].offset != 0; slot = (slot + 1) & movieMask) {
+      if (movieIndex[slot].fingerprint != (uint32_t) (hash >> 32)) continue;
+      const char* movieName = (const char*)movieFile + movieIndex[slot].offset;
+      if (compareTitles(movieName, title, length) == 0 && movieName[length + 1] + 1900 == year) {
+        return movieIndex[slot].offset;
+      }
+    }
+    return -1;
+  }
+
+  int* firstRecord = (int*)movieFile + 1;
+  int* endOfLastRecord = (int*)movieFile + *((int*)movieFile) + 1;
+
+  // Compares titles and years in place, so no temporary film needs to be built per probe
+  int* result = lower_bound(firstRecord, endOfLastRecord, year, [this, title, length] (const int& offset, int year){
+    char* movieName = (char*)((int*)movieFile + offset/4);
+    int cmp = compareTitles(movieName, title, length);
+    if (cmp != 0) return cmp < 0;
+    char* recordYear = (char*)((char*)movieName+strlen(movieName)+1);
+    return *recordYear + 1900 < year;
+  });
+
+  if (result == endOfLastRecord) return -1;
+  char* movieName = (char*)((int*)movieFile + *(result)/4);
+  char* recordYear = (char*)((char*)movieName+strlen(movieName)+1);
+  if (compareTitles(movieName, title, length) != 0 || *recordYear + 1900 != year) return -1;
+  return *result;
+}
+
+bool imdb::getCredits(const string& player, creditRange& films) const {
+  films = creditRange();
+  int offset = findActorRecord(player);
+  if (offset != -1 && !touchedActors.empty() && touchedActors[offset / 4]) {
+    const vector<film>& merged = *actorOverrides.find(offset)->second;
+    films.merged = merged.data();
+    films.count = merged.size();
+    return true;
+  }
+  if (offset == -1) {
+    // Only the delta could possibly know about this actor
+    unordered_map<string, vector<film>>::const_iterator found = deltaCredits.find(player);
+    if (found == deltaCredits.end()) return false;
+    films.merged = found->second.data();
+    films.count = found->second.size();
+    return true;
   }
 
   // Used to keep track of the byteSize of this actor record. 
   // Incremented as we "move" through the image data.
   int byteSize = 0;
 
-  char* name = (char*)((int*)actorFile + *(result)/4);
+  char* name = (char*)((int*)actorFile + offset/4);
   byteSize += strlen(name) + 1;
 
   char* afterName = (char*)(name + strlen(name) + 1);
@@ -66,42 +201,63 @@ bool imdb::getCredits(const string& player, vector<film>& films) const {
     afterMovieCount++; // add 2 more bytes
   }
 
-  int* movie = (int*)((short*)afterMovieCount); // Points to Movie offset Integer
-
-  for (short i = 0; i < *(movieCount); i++) {
-    char* movieName = (char*)((int*)movieFile + *(movie)/4);
-    char* year = (char*)(movieName+strlen(movieName)+1);
+  films.first = (int*)((short*)afterMovieCount); // Points to first Movie offset Integer
+  films.count = *(movieCount);
+  films.movieFile = (const char*)movieFile;
+  return true;
+}
 
-    film f;
-    f.title = movieName;
-    f.year = *year + 1900;
-    films.push_back(f);
+bool imdb::getCredits(const string& player, vector<film>& films) const {
+  creditRange credits;
+  if (!getCredits(player, credits)) {
+    return false;
+  }
 
-    movie++; // point to next Movie offset Integer
+  films.reserve(films.size() + credits.size());
+  for (const filmView& movie: credits) {
+    films.push_back(movie.toFilm());
   }
   return true; 
 }
 
-bool imdb::getCast(const film& movie, vector<string>& players) const {
-  int* firstRecord = (int*)movieFile + 1;
-  int* endOfLastRecord = (int*)movieFile + *((int*)movieFile) + 1;
-
-  int* result = lower_bound(firstRecord, endOfLastRecord, movie, [this] (const int& offset, const film& movie){
-    char* movieName = (char*)((int*)movieFile + offset/4);
-    char* year = (char*)((char*)movieName+strlen(movieName)+1);
+bool imdb::getCast(const film& movie, castRange& players) const {
+  return getCast(movie.title.c_str(), movie.title.size(), movie.year, players);
+}
 
-    film f;
-    f.title = movieName;
-    f.year = *year + 1900;
+bool imdb::getCast(const filmView& movie, castRange& players) const {
+  return getCast(movie.title.data, movie.title.length, movie.year, players);
+}
 
-    return f < movie;
-  });
+bool imdb::getCast(const char *title, size_t length, int movieYear, castRange& players) const {
+  players = castRange();
+  int offset = findMovieRecord(title, length, movieYear);
+  if (offset != -1 && !touchedMovies.empty() && touchedMovies[offset / 4]) {
+    const castDelta& merged = *movieOverrides.find(offset)->second;
+    players.merged = merged.cast.data();
+    players.count = merged.cast.size();
+    return true;
+  }
+  if (offset == -1) {
+    // Only the delta could possibly know about this film
+    vector<castDelta>::const_iterator found = lower_bound(deltaCasts.begin(), deltaCasts.end(), movieYear,
+      [title, length] (const castDelta& entry, int year) {
+        int cmp = compareTitles(entry.movie.title.c_str(), title, length);
+        return cmp < 0 || (cmp == 0 && entry.movie.year < year);
+      });
+    if (found == deltaCasts.end() || compareTitles(found->movie.title.c_str(), title, length) != 0 ||
+        found->movie.year != movieYear) {
+      return false;
+    }
+    players.merged = found->cast.data();
+    players.count = found->cast.size();
+    return true;
+  }
 
   // Used to keep track of the byteSize of this actor record. 
   // Incremented as we "move" through the image data.
   int byteCount = 0;
 
-  char* movieName = (char*)((int*)movieFile + *(result)/4);
+  char* movieName = (char*)((int*)movieFile + offset/4);
   char* year = (char*)((char*)movieName+strlen(movieName)+1);
 
   ++year;
@@ -121,26 +277,526 @@ bool imdb::getCast(const film& movie, vector<string>& players) const {
     year += 2;
     byteCount += 2;
   }
-  int* actorOffset = (int*)year;
 
-  for (short i = 0; i < *(actorCount); i++) {
-    char* actorName = (char*)((int*)actorFile + *(actorOffset)/4);
-    players.push_back(actorName);
-    actorOffset++; // increment to next movie
+  players.first = (int*)year;
+  players.count = *(actorCount);
+  players.actorFile = (const char*)actorFile;
+  return true; 
+}
+
+bool imdb::getCast(const film& movie, vector<string>& players) const {
+  castRange cast;
+  if (!getCast(movie, cast)) {
+    players.clear();
+    return false;
   }
 
+  players.reserve(players.size() + cast.size());
+  for (const stringView& player: cast) {
+    players.push_back(player.toString());
+  }
   return true; 
 }
 
-const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info) {
+filmView creditRange::iterator::operator*() const {
+  filmView movie;
+  if (merged != NULL) {
+    movie.title.data = merged->title.c_str();
+    movie.title.length = merged->title.size();
+    movie.year = merged->year;
+    return movie;
+  }
+
+  const char* movieName = movieFile + *offset;
+  size_t length = strlen(movieName);
+  movie.title.data = movieName;
+  movie.title.length = length;
+  movie.year = movieName[length + 1] + 1900;
+  return movie;
+}
+
+stringView castRange::iterator::operator*() const {
+  stringView player;
+  if (merged != NULL) {
+    player.data = merged->c_str();
+    player.length = merged->size();
+    return player;
+  }
+
+  const char* actorName = actorFile + *offset;
+  player.data = actorName;
+  player.length = strlen(actorName);
+  return player;
+}
+
+void imdb::getPlayers(vector<string>& players) const {
+  int numActors = *(int*)actorFile;
+  int* firstRecord = (int*)actorFile + 1;
+
+  size_t numPrevious = players.size();
+  players.reserve(numPrevious + numActors);
+  for (int i = 0; i < numActors; i++) {
+    players.push_back((char*)((int*)actorFile + firstRecord[i]/4));
+  }
+
+  // Actors who only appear in the delta are merged into place
+  size_t numBase = players.size();
+  for (const pair<const string, vector<film>>& entry: deltaCredits) {
+    if (findActorRecord(entry.first) == -1) players.push_back(entry.first);
+  }
+  sort(players.begin() + numBase, players.end());
+  inplace_merge(players.begin() + numPrevious, players.begin() + numBase, players.end());
+}
+
+bool imdb::loadIndex(const string& fileName) {
+  const void *map = acquireFileMap(fileName, indexInfo, policy);
+  if (map == NULL || indexInfo.fileSize < sizeof(indexHeader)) {
+    releaseFileMap(indexInfo);
+    return false;
+  }
+
+  // The index is only trusted if it was built from data files just like ours
+  const indexHeader *header = (const indexHeader *) map;
+  bool valid = header->magic == kIndexMagic && header->version == kIndexVersion &&
+    header->actorFileSize == actorInfo.fileSize && header->movieFileSize == movieInfo.fileSize &&
+    header->actorModTime == actorInfo.modTime && header->movieModTime == movieInfo.modTime &&
+    header->actorInode == actorInfo.inode && header->movieInode == movieInfo.inode &&
+    header->actorSlots > 0 && (header->actorSlots & (header->actorSlots - 1)) == 0 &&
+    header->movieSlots > 0 && (header->movieSlots & (header->movieSlots - 1)) == 0 &&
+    indexInfo.fileSize == sizeof(indexHeader) + sizeof(indexSlot) * ((size_t) header->actorSlots + header->movieSlots);
+  if (!valid) {
+    releaseFileMap(indexInfo);
+    return false;
+  }
+
+  indexFile = map;
+  actorIndex = (const indexSlot *)(header + 1);
+  movieIndex = actorIndex + header->actorSlots;
+  actorMask = header->actorSlots - 1;
+  movieMask = header->movieSlots - 1;
+  return true;
+}
+
+/**
+ * Function: insertSlot
+ * --------------------
+ * Places the specified record offset into the first free slot of the open-addressing
+ * table at or after the one selected by its hash.  The table is never more than
+ * half full, so a free slot always exists.
+ */
+static void insertSlot(vector<uint32_t>& table, uint32_t mask, uint64_t hash, uint32_t offset) {
+  uint32_t slot = hash & mask;
+  while (table[2 * slot + 1] != 0) slot = (slot + 1) & mask;
+  table[2 * slot] = hash >> 32;
+  table[2 * slot + 1] = offset;
+}
+
+/**
+ * Function: tableSize
+ * -------------------
+ * Returns the smallest power of two that's at least twice the specified count.
+ */
+static uint32_t tableSize(uint32_t count) {
+  uint32_t size = 1;
+  while (size < 2 * count) size <<= 1;
+  return size;
+}
+
+bool imdb::buildIndex(const string& fileName) const {
+  int numActors = *(int*)actorFile;
+  int numMovies = *(int*)movieFile;
+
+  indexHeader header;
+  header.magic = kIndexMagic;
+  header.version = kIndexVersion;
+  header.actorFileSize = actorInfo.fileSize;
+  header.movieFileSize = movieInfo.fileSize;
+  header.actorModTime = actorInfo.modTime;
+  header.movieModTime = movieInfo.modTime;
+  header.actorInode = actorInfo.inode;
+  header.movieInode = movieInfo.inode;
+  header.actorSlots = tableSize(numActors);
+  header.movieSlots = tableSize(numMovies);
+
+  vector<uint32_t> actorTable(2 * header.actorSlots, 0);
+  for (int i = 0; i < numActors; i++) {
+    uint32_t offset = ((int*)actorFile + 1)[i];
+    const char* name = (const char*)actorFile + offset;
+    insertSlot(actorTable, header.actorSlots - 1, hashActor(name, strlen(name)), offset);
+  }
+
+  vector<uint32_t> movieTable(2 * header.movieSlots, 0);
+  for (int i = 0; i < numMovies; i++) {
+    uint32_t offset = ((int*)movieFile + 1)[i];
+    const char* movieName = (const char*)movieFile + offset;
+    size_t length = strlen(movieName);
+    insertSlot(movieTable, header.movieSlots - 1, hashMovie(movieName, length, movieName[length + 1]), offset);
+  }
+
+  // Write to a private file and rename it into place, so other processes never see half an index
+  string tempFileName = fileName + "." + to_string(getpid());
+  ofstream out(tempFileName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out) return false;
+  out.write((const char *) &header, sizeof(header));
+  out.write((const char *) actorTable.data(), actorTable.size() * sizeof(uint32_t));
+  out.write((const char *) movieTable.data(), movieTable.size() * sizeof(uint32_t));
+  out.close();
+  if (out.fail() || rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+    unlink(tempFileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Function: parseDeltaLine
+ * ------------------------
+ * Splits one line of the delta file, which looks like
+ *
+ *    +<tab>actor<tab>title<tab>year        or        -<tab>actor<tab>title<tab>year
+ *
+ * into its parts.  Returns false if the line is malformed.
+ */
+static bool parseDeltaLine(const string& line, bool& added, string& player, film& movie) {
+  size_t first = line.find('\t');
+  size_t second = first == string::npos ? string::npos : line.find('\t', first + 1);
+  size_t third = second == string::npos ? string::npos : line.find('\t', second + 1);
+  if (first != 1 || third == string::npos || (line[0] != '+' && line[0] != '-')) return false;
+  added = line[0] == '+';
+  player = line.substr(first + 1, second - first - 1);
+  movie.title = line.substr(second + 1, third - second - 1);
+  movie.year = atoi(line.c_str() + third + 1);
+  return !player.empty() && !movie.title.empty();
+}
+
+bool imdb::loadDelta(const string& fileName) {
+  ifstream in(fileName.c_str());
+  if (!in) return false;
+
+  // Sized before reading, so a change appended meanwhile only ever makes stamps look stale
   struct stat stats;
-  stat(fileName.c_str(), &stats);
-  info.fileSize = stats.st_size;
+  if (stat(fileName.c_str(), &stats) == 0) deltaFileSize = stats.st_size;
+
+  // Replay every change against the data files, remembering only the net effect on each
+  // credit: true if it's been added, false if it's been removed, and absent if unchanged
+  map<string, map<film, bool>> actorChanges;
+  map<film, map<string, bool>> movieChanges;
+  string line;
+  while (getline(in, line)) {
+    bool added;
+    string player;
+    film movie;
+    if (!parseDeltaLine(line, added, player, movie)) continue;
+
+    bool inBase = false;
+    creditRange credits;
+    getCredits(player, credits); // still the data files alone, since the delta isn't in place yet
+    for (const filmView& credit: credits) {
+      if (credit == movie) {
+        inBase = true;
+        break;
+      }
+    }
+
+    if (added == inBase) {
+      actorChanges[player].erase(movie);
+      movieChanges[movie].erase(player);
+    } else {
+      actorChanges[player][movie] = added;
+      movieChanges[movie][player] = added;
+    }
+  }
+
+  unordered_map<string, vector<film>> credits;
+  for (const pair<const string, map<film, bool>>& changes: actorChanges) {
+    if (changes.second.empty()) continue;
+    vector<film> merged, base;
+    getCredits(changes.first, base);
+    for (const film& movie: base) {
+      if (changes.second.count(movie) == 0) merged.push_back(movie);
+    }
+    for (const pair<const film, bool>& change: changes.second) {
+      if (change.second) merged.push_back(change.first);
+    }
+    credits[changes.first].swap(merged);
+  }
+
+  vector<castDelta> casts;
+  for (const pair<const film, map<string, bool>>& changes: movieChanges) {
+    if (changes.second.empty()) continue;
+    castDelta entry;
+    entry.movie = changes.first;
+    vector<string> base;
+    getCast(changes.first, base);
+    for (const string& player: base) {
+      if (changes.second.count(player) == 0) entry.cast.push_back(player);
+    }
+    for (const pair<const string, bool>& change: changes.second) {
+      if (change.second) entry.cast.push_back(change.first);
+    }
+    casts.push_back(entry); // map order is film order, so casts ends up sorted
+  }
+
+  deltaCredits.swap(credits);
+  deltaCasts.swap(casts);
+
+  // Flag the records the delta overrides, so lookups of everyone else can skip the overlay
+  touchedActors.assign(actorInfo.fileSize / 4, false);
+  for (const pair<const string, vector<film>>& entry: deltaCredits) {
+    int offset = findActorRecord(entry.first);
+    if (offset == -1) continue;
+    touchedActors[offset / 4] = true;
+    actorOverrides[offset] = &entry.second;
+  }
+  touchedMovies.assign(movieInfo.fileSize / 4, false);
+  for (const castDelta& entry: deltaCasts) {
+    int offset = findMovieRecord(entry.movie.title.c_str(), entry.movie.title.size(), entry.movie.year);
+    if (offset == -1) continue;
+    touchedMovies[offset / 4] = true;
+    movieOverrides[offset] = &entry;
+  }
+  return true;
+}
+
+void imdb::getStamp(dataStamp& stamp) const {
+  stamp.actorFileSize = actorInfo.fileSize;
+  stamp.actorModTime = actorInfo.modTime;
+  stamp.actorInode = actorInfo.inode;
+  stamp.movieFileSize = movieInfo.fileSize;
+  stamp.movieModTime = movieInfo.modTime;
+  stamp.movieInode = movieInfo.inode;
+  stamp.deltaFileSize = deltaFileSize;
+}
+
+bool imdb::readStamp(const string& directory, dataStamp& stamp) {
+  struct stat actorStats, movieStats, deltaStats;
+  if (stat((directory + "/" + kActorFileName).c_str(), &actorStats) == -1 ||
+      stat((directory + "/" + kMovieFileName).c_str(), &movieStats) == -1) {
+    return false;
+  }
+  stamp.actorFileSize = actorStats.st_size;
+  stamp.actorModTime = actorStats.st_mtim.tv_sec * 1000000000ULL + actorStats.st_mtim.tv_nsec;
+  stamp.actorInode = actorStats.st_ino;
+  stamp.movieFileSize = movieStats.st_size;
+  stamp.movieModTime = movieStats.st_mtim.tv_sec * 1000000000ULL + movieStats.st_mtim.tv_nsec;
+  stamp.movieInode = movieStats.st_ino;
+  stamp.deltaFileSize = stat((directory + "/" + kDeltaFileName).c_str(), &deltaStats) == -1 ? 0 : deltaStats.st_size;
+  return true;
+}
+
+bool imdb::appendDelta(const string& directory, bool added, const string& player, const film& movie) {
+  if (movie.year < 1900 || movie.year > 1900 + 127) return false; // must fit in the year byte
+  if (player.empty() || movie.title.empty()) return false;
+  if (player.find_first_of("\t\n") != string::npos || movie.title.find_first_of("\t\n") != string::npos) {
+    return false;
+  }
+
+  string fileName = directory + "/" + kDeltaFileName;
+  ofstream out(fileName.c_str(), ios::out | ios::app);
+  if (!out) return false;
+  out << (added ? '+' : '-') << '\t' << player << '\t' << movie.title << '\t' << movie.year << '\n';
+  out.close();
+  return !out.fail();
+}
+
+/**
+ * Functions: actorRecordHeaderSize
+ *            movieRecordHeaderSize
+ * --------------------------------
+ * Return the number of bytes that precede the list of offsets in an actor or movie
+ * record: the name (or title and year byte), padded to an even length, then the
+ * short count, padded to a multiple of four.
+ */
+static size_t actorRecordHeaderSize(const string& player) {
+  size_t size = player.size() + 1;
+  if (size % 2 != 0) size++;
+  size += sizeof(short);
+  if (size % 4 != 0) size += 2;
+  return size;
+}
+
+static size_t movieRecordHeaderSize(const film& movie) {
+  size_t size = movie.title.size() + 2;
+  if (size % 2 != 0) size++;
+  size += sizeof(short);
+  if (size % 4 != 0) size += 2;
+  return size;
+}
+
+/**
+ * Function: appendBytes
+ * ---------------------
+ * Appends the bytes of the specified value to the end of the buffer.
+ */
+template <typename T>
+static void appendBytes(vector<char>& buffer, const T& value) {
+  buffer.insert(buffer.end(), (const char *) &value, (const char *) &value + sizeof(value));
+}
+
+/**
+ * Function: replaceFile
+ * ---------------------
+ * Writes the buffer to a private file and renames it over the specified one, so
+ * other processes either see the old file or the new one in full.
+ */
+static bool replaceFile(const string& fileName, const vector<char>& contents) {
+  string tempFileName = fileName + "." + to_string(getpid());
+  ofstream out(tempFileName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out) return false;
+  out.write(contents.data(), contents.size());
+  out.close();
+  if (out.fail() || rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+    unlink(tempFileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool imdb::compact(const string& directory) const {
+  vector<string> players;
+  getPlayers(players);
+  vector<vector<film>> credits(players.size());
+  vector<film> films;
+  for (size_t i = 0; i < players.size(); i++) {
+    getCredits(players[i], credits[i]);
+    films.insert(films.end(), credits[i].begin(), credits[i].end());
+  }
+  sort(films.begin(), films.end());
+  films.erase(unique(films.begin(), films.end()), films.end());
+
+  vector<vector<int>> casts(films.size()); // each film's cast, as indices into players
+  for (size_t i = 0; i < films.size(); i++) {
+    vector<string> cast;
+    getCast(films[i], cast);
+    for (const string& player: cast) {
+      vector<string>::const_iterator found = lower_bound(players.begin(), players.end(), player);
+      if (found == players.end() || *found != player) return false; // credits and casts disagree
+      casts[i].push_back(found - players.begin());
+    }
+  }
+
+  // Record sizes don't depend on the offsets stored inside them, so every offset can be fixed up front
+  vector<int> actorOffsets, movieOffsets;
+  size_t offset = sizeof(int) * (1 + players.size());
+  for (size_t i = 0; i < players.size(); i++) {
+    if (credits[i].size() > SHRT_MAX) return false;
+    actorOffsets.push_back(offset);
+    offset += actorRecordHeaderSize(players[i]) + sizeof(int) * credits[i].size();
+  }
+  offset = sizeof(int) * (1 + films.size());
+  for (size_t i = 0; i < films.size(); i++) {
+    if (casts[i].size() > SHRT_MAX || films[i].year < 1900 || films[i].year > 1900 + 127) return false;
+    movieOffsets.push_back(offset);
+    offset += movieRecordHeaderSize(films[i]) + sizeof(int) * casts[i].size();
+  }
+
+  vector<char> actorData;
+  appendBytes(actorData, (int) players.size());
+  for (int actorOffset: actorOffsets) appendBytes(actorData, actorOffset);
+  for (size_t i = 0; i < players.size(); i++) {
+    size_t headerEnd = actorData.size() + actorRecordHeaderSize(players[i]);
+    actorData.insert(actorData.end(), players[i].c_str(), players[i].c_str() + players[i].size() + 1);
+    if (actorData.size() % 2 != 0) actorData.push_back('\0');
+    appendBytes(actorData, (short) credits[i].size());
+    actorData.resize(headerEnd, '\0');
+    for (const film& movie: credits[i]) {
+      appendBytes(actorData, movieOffsets[lower_bound(films.begin(), films.end(), movie) - films.begin()]);
+    }
+  }
+
+  vector<char> movieData;
+  appendBytes(movieData, (int) films.size());
+  for (int movieOffset: movieOffsets) appendBytes(movieData, movieOffset);
+  for (size_t i = 0; i < films.size(); i++) {
+    size_t headerEnd = movieData.size() + movieRecordHeaderSize(films[i]);
+    movieData.insert(movieData.end(), films[i].title.c_str(), films[i].title.c_str() + films[i].title.size() + 1);
+    movieData.push_back((char) (films[i].year - 1900));
+    if (movieData.size() % 2 != 0) movieData.push_back('\0');
+    appendBytes(movieData, (short) casts[i].size());
+    movieData.resize(headerEnd, '\0');
+    for (int player: casts[i]) appendBytes(movieData, actorOffsets[player]);
+  }
+
+  if (!replaceFile(directory + "/" + kActorFileName, actorData) ||
+      !replaceFile(directory + "/" + kMovieFileName, movieData)) {
+    return false;
+  }
+  unlink((directory + "/" + kIndexFileName).c_str());
+  unlink((directory + "/" + kDeltaFileName).c_str());
+  return true;
+}
+
+const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info, loadPolicy policy) {
+  info.fileSize = 0;
+  info.fileMap = NULL;
+  info.mapSize = 0;
+  info.modTime = 0;
+  info.inode = 0;
   info.fd = open(fileName.c_str(), O_RDONLY);
-  return info.fileMap = mmap(0, info.fileSize, PROT_READ, MAP_SHARED, info.fd, 0);
+  if (info.fd == -1) return NULL;
+
+  struct stat stats;
+  if (fstat(info.fd, &stats) == -1) return NULL;
+  info.fileSize = stats.st_size;
+  info.modTime = stats.st_mtim.tv_sec * 1000000000ULL + stats.st_mtim.tv_nsec;
+  info.inode = stats.st_ino;
+  // When the huge pages can't be had, an ordinary mapping serves just as correctly
+  if (policy == kHugePageLoad && (info.fileMap = copyIntoHugePages(info)) != NULL) return info.fileMap;
+
+  int flags = MAP_SHARED;
+  if (policy == kPopulateLoad) flags |= MAP_POPULATE;
+  void *map = mmap(0, info.fileSize, PROT_READ, flags, info.fd, 0);
+  if (map == MAP_FAILED) return NULL;
+  info.mapSize = info.fileSize;
+  if (policy == kAdviseLoad) {
+    madvise(map, info.mapSize, MADV_WILLNEED);
+    madvise(map, info.mapSize, MADV_RANDOM);
+  }
+  return info.fileMap = map;
+}
+
+/**
+ * Method: copyIntoHugePages
+ * -------------------------
+ * Reads the entire file into a private, read-only anonymous mapping.  The mapping
+ * is aligned to (and padded out to) a whole number of huge pages, since the kernel
+ * only backs aligned 2MB extents with transparent huge pages.  Returns NULL if the
+ * memory can't be had or the file can't be read in full.
+ */
+static const size_t kHugePageSize = 2 << 20;
+const void *imdb::copyIntoHugePages(struct fileInfo& info) {
+  if (info.fileSize == 0) return NULL;
+  size_t mapSize = (info.fileSize + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+
+  // Over-allocate by one huge page, then trim whatever falls outside the aligned window
+  char *region = (char *) mmap(0, mapSize + kHugePageSize, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) return NULL;
+  char *map = (char *) (((uintptr_t) region + kHugePageSize - 1) & ~(uintptr_t) (kHugePageSize - 1));
+  if (map > region) munmap(region, map - region);
+  munmap(map + mapSize, region + kHugePageSize - map);
+#ifdef MADV_HUGEPAGE
+  madvise(map, mapSize, MADV_HUGEPAGE);
+#endif
+
+  size_t numRead = 0;
+  while (numRead < info.fileSize) {
+    ssize_t count = pread(info.fd, map + numRead, info.fileSize - numRead, numRead);
+    if (count <= 0) {
+      munmap(map, mapSize);
+      return NULL;
+    }
+    numRead += count;
+  }
+
+  mprotect(map, mapSize, PROT_READ);
+  info.mapSize = mapSize;
+  return map;
 }
 
 void imdb::releaseFileMap(struct fileInfo& info) {
-  if (info.fileMap != NULL) munmap((char *) info.fileMap, info.fileSize);
+  if (info.fileMap != NULL) munmap((char *) info.fileMap, info.mapSize);
   if (info.fd != -1) close(info.fd);
+  info.fileMap = NULL;
+  info.fd = -1;
 }
@@ -1,7 +1,135 @@
 #pragma once
 #include "imdb-utils.h"
+#include <stdint.h>
 #include <string>
 #include <vector>
+#include <unordered_map>
+
+/**
+ * Classes: creditRange
+ *          castRange
+ * --------------------
+ * Lazy, read-only ranges over the list of movie offsets in an actor record (creditRange)
+ * and the list of actor offsets in a movie record (castRange).  Nothing is decoded or copied
+ * until an iterator is dereferenced, and then only into a filmView or stringView pointing
+ * back into the data files, so walking a range never allocates.  Ranges are populated by
+ * the view-returning overloads of imdb::getCredits and imdb::getCast, and remain valid
+ * only as long as the imdb that populated them.
+ */
+class creditRange {
+ public:
+  class iterator {
+   public:
+    iterator(const int *offset, const char *movieFile) : offset(offset), movieFile(movieFile), merged(NULL) {}
+    iterator(const film *merged) : offset(NULL), movieFile(NULL), merged(merged) {}
+    filmView operator*() const;
+    iterator& operator++() { if (merged != NULL) merged++; else offset++; return *this; }
+    bool operator==(const iterator& rhs) const { return offset == rhs.offset && merged == rhs.merged; }
+    bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+   private:
+    const int *offset;
+    const char *movieFile;
+    const film *merged;
+  };
+
+  creditRange() : first(NULL), count(0), movieFile(NULL), merged(NULL) {}
+  iterator begin() const { return merged != NULL ? iterator(merged) : iterator(first, movieFile); }
+  iterator end() const { return merged != NULL ? iterator(merged + count) : iterator(first + count, movieFile); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+ private:
+  friend class imdb;
+  const int *first;
+  size_t count;
+  const char *movieFile;
+  const film *merged; // non-NULL when the list comes from the delta overlay instead
+};
+
+class castRange {
+ public:
+  class iterator {
+   public:
+    iterator(const int *offset, const char *actorFile) : offset(offset), actorFile(actorFile), merged(NULL) {}
+    iterator(const std::string *merged) : offset(NULL), actorFile(NULL), merged(merged) {}
+    stringView operator*() const;
+    iterator& operator++() { if (merged != NULL) merged++; else offset++; return *this; }
+    bool operator==(const iterator& rhs) const { return offset == rhs.offset && merged == rhs.merged; }
+    bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+   private:
+    const int *offset;
+    const char *actorFile;
+    const std::string *merged;
+  };
+
+  castRange() : first(NULL), count(0), actorFile(NULL), merged(NULL) {}
+  iterator begin() const { return merged != NULL ? iterator(merged) : iterator(first, actorFile); }
+  iterator end() const { return merged != NULL ? iterator(merged + count) : iterator(first + count, actorFile); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+ private:
+  friend class imdb;
+  const int *first;
+  size_t count;
+  const char *actorFile;
+  const std::string *merged; // non-NULL when the list comes from the delta overlay instead
+};
+
+/**
+ * Convenience struct: dataStamp
+ * -----------------------------
+ * Identifies the exact state of a data directory: the size, modification time (in
+ * nanoseconds) and inode number of the actordata and moviedata files, and the size
+ * of the delta file (0 if there is none).  Since the delta is append-only, and compact
+ * replaces the data files and removes the delta, any change to what an imdb on the
+ * directory would report changes the stamp.  Files derived from the database, like the
+ * imdbGraph snapshot, record the stamp they were built from so they can tell when
+ * they've gone stale.
+ */
+struct dataStamp {
+  uint64_t actorFileSize;
+  uint64_t actorModTime;
+  uint64_t actorInode;
+  uint64_t movieFileSize;
+  uint64_t movieModTime;
+  uint64_t movieInode;
+  uint64_t deltaFileSize;
+
+  bool operator==(const dataStamp& rhs) const {
+    return actorFileSize == rhs.actorFileSize && actorModTime == rhs.actorModTime &&
+      actorInode == rhs.actorInode && movieFileSize == rhs.movieFileSize &&
+      movieModTime == rhs.movieModTime && movieInode == rhs.movieInode && deltaFileSize == rhs.deltaFileSize;
+  }
+  bool operator!=(const dataStamp& rhs) const { return !(*this == rhs); }
+};
+
+/**
+ * Enumerated Type: loadPolicy
+ * ---------------------------
+ * Controls how the imdb constructor brings the data files (and the index) into memory.
+ * With the default, kLazyLoad, the files are simply memory mapped, and every page is
+ * faulted in the first time a query touches it, which front-loads a storm of page
+ * faults onto the first few queries.  The other policies move that cost into the
+ * constructor, or cut the number of faults taken:
+ *
+ *     kPopulateLoad  maps with MAP_POPULATE, so every page is read in and mapped
+ *                    before the constructor returns.
+ *     kAdviseLoad    maps lazily, then calls madvise with MADV_WILLNEED (start reading
+ *                    everything in the background) followed by MADV_RANDOM (don't
+ *                    bother reading ahead of later faults).
+ *     kHugePageLoad  copies each file into anonymous memory the kernel is asked to
+ *                    back with transparent huge pages, so the whole database is
+ *                    covered by a handful of TLB entries.  This costs a private copy
+ *                    of the files, which other processes can't share.  A file that
+ *                    can't be copied is mapped as kLazyLoad would map it.
+ */
+enum loadPolicy {
+  kLazyLoad,
+  kPopulateLoad,
+  kAdviseLoad,
+  kHugePageLoad
+};
 
 class imdb {
  public:
@@ -16,9 +144,10 @@ class imdb {
  * application (like six-degrees).
  *
  * @param directory the name of the directory housing the formatted information backing the imdb.
+ * @param policy how the files should be brought into memory (see loadPolicy above).
  */
 
-  imdb(const std::string& directory);
+  imdb(const std::string& directory, loadPolicy policy = kLazyLoad);
 
 /**
  * Predicate Method: good
@@ -29,10 +158,45 @@ class imdb {
  *     1.) either one or both of the data files supporting the imdb were missing
  *     2.) the directory passed to the constructor doesn't exist.
  *     3.) the directory and files all exist, but you don't have the permission to read them.
+ *     4.) the files couldn't be mapped (or, with kHugePageLoad, copied) into memory.
  */
 
   bool good() const;
 
+/**
+ * Predicate Method: hasIndex
+ * --------------------------
+ * Returns true if and only if getCredits and getCast are being served by the
+ * hash index stored alongside the data files (see imdbindex below), and false
+ * if they're falling back on binary search over the sorted records.
+ *
+ * The constructor looks for a file named imdbindex in the data directory, and
+ * uses it only if it was built from these very data files: the same size, the same
+ * modification time (to the nanosecond) and the same inode number.  If
+ * the index is missing or stale, and the directory is writable, the constructor
+ * builds a fresh one (a single pass over every record) for this and future runs.
+ */
+
+  bool hasIndex() const { return indexFile != NULL; }
+
+/**
+ * Predicate Method: hasDelta
+ * --------------------------
+ * Returns true if and only if the data directory holds a delta file (named imdbdelta)
+ * that changes at least one credit.
+ *
+ * The delta is a small, append-only file of credits added to and removed from the
+ * immutable actordata and moviedata files.  The constructor replays it once, and
+ * from then on every getCredits and getCast call consults the (small) set of actors
+ * and films it touched before falling back on the data files, so the delta is
+ * merged into every answer without ever rewriting the data files themselves.
+ * Credits removed by the delta disappear from both sides, and credits it adds
+ * follow any surviving ones.  Actors and films that appear only in the delta are
+ * reported just like everyone else.  See appendDelta and compact below.
+ */
+
+  bool hasDelta() const { return !deltaCredits.empty() || !deltaCasts.empty(); }
+
 /**
  * Method: getCredits
  * ------------------
@@ -69,6 +233,86 @@ class imdb {
 
   bool getCast(const film& movie, std::vector<std::string>& players) const;
 
+/**
+ * Methods: getCredits
+ *          getCast
+ * -------------------
+ * View-returning overloads of the two methods above.  Rather than copying every
+ * title or name into a vector, they point the supplied range at the list of offsets
+ * stored in the actor's (or movie's) record, and the range decodes each entry only
+ * as it's visited.  Use these when the results are only inspected, and the owning
+ * versions above when they need to outlive the imdb.  If the actor or movie isn't
+ * in the database, the range is left empty and false is returned.  getCast
+ * also accepts a filmView, so a filmView pulled from a creditRange can be
+ * passed straight back in without building a film.
+ */
+
+  bool getCredits(const std::string& player, creditRange& films) const;
+  bool getCast(const film& movie, castRange& players) const;
+  bool getCast(const filmView& movie, castRange& players) const;
+
+/**
+ * Method: getPlayers
+ * ------------------
+ * Populates the specified vector<string> with the name of every actor and
+ * actress in the database, in sorted order.  This touches every actor record,
+ * so it's intended for one-time passes over the entire database (e.g. building
+ * an imdbGraph snapshot) rather than for individual queries.
+ *
+ * @param players a reference to the vector of strings to be updated with
+ *                every actor and actress in the database.
+ */
+
+  void getPlayers(std::vector<std::string>& players) const;
+
+/**
+ * Method: getStamp
+ * ----------------
+ * Populates the specified dataStamp with the state of the data directory the receiving
+ * imdb was constructed from, as of the moment its files were opened and its delta read.
+ */
+
+  void getStamp(dataStamp& stamp) const;
+
+/**
+ * Static Method: readStamp
+ * ------------------------
+ * Populates the specified dataStamp with the current state of the specified data
+ * directory, without opening an imdb on it.  Returns false if either data file is
+ * missing.
+ */
+
+  static bool readStamp(const std::string& directory, dataStamp& stamp);
+
+/**
+ * Static Method: appendDelta
+ * --------------------------
+ * Records that the specified actor/actress was added to (or removed from) the cast of
+ * the specified film by appending one line to the delta file in the specified directory,
+ * creating the file if need be.  imdbs constructed from then on reflect the change.
+ * Years must fall within [1900, 2027], since that's all the data files can store.
+ *
+ * @return true if and only if the change was recorded.
+ */
+
+  static bool appendDelta(const std::string& directory, bool added, const std::string& player, const film& movie);
+
+/**
+ * Method: compact
+ * ---------------
+ * Writes brand new actordata and moviedata files into the specified directory that
+ * hold everything the receiving imdb reports, delta included, and then removes that
+ * directory's delta and index files, which no longer describe its data files.  The
+ * new files replace the old ones atomically, so imdbs already open on them are
+ * unaffected.  Compacting into the imdb's own directory folds the delta into the
+ * data files.  Either way the directory's dataStamp changes, so any imdb-snapshot
+ * built from it is ignored until it's rebuilt.
+ *
+ * @return true if and only if both data files were written in full.
+ */
+
+  bool compact(const std::string& directory) const;
+
 /**
  * Destructor: ~imdb
  * -----------------
@@ -80,8 +324,13 @@ class imdb {
  private:
   static const char *const kActorFileName;
   static const char *const kMovieFileName;
+  static const char *const kIndexFileName;
+  static const char *const kDeltaFileName;
   const void *actorFile;
   const void *movieFile;
+  const void *indexFile;
+  loadPolicy policy;
+  uint64_t deltaFileSize; // bytes of the delta replayed
   
   // everything below here is complicated and needn't be touched.
   // you're free to investigate, but you're on your own.
@@ -89,9 +338,67 @@ class imdb {
     int fd;
     size_t fileSize;
     const void *fileMap;
-  } actorInfo, movieInfo;
+    size_t mapSize; // may exceed fileSize when the file was copied into huge pages
+    uint64_t modTime; // st_mtim, in nanoseconds
+    uint64_t inode;
+  } actorInfo, movieInfo, indexInfo;
+
+  // The index file is a header followed by two open-addressing hash tables (actors, then
+  // movies) of indexSlot entries.  Each slot holds the upper 32 bits of the key's hash and
+  // the byte offset of its record, and a record offset of 0 marks an empty slot.  The
+  // header identifies the data files the index was built from, since files regenerated
+  // at the same size would otherwise be matched against stale offsets.
+  struct indexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t actorFileSize;
+    uint32_t movieFileSize;
+    uint32_t actorSlots;
+    uint32_t movieSlots;
+    uint64_t actorModTime;
+    uint64_t movieModTime;
+    uint64_t actorInode;
+    uint64_t movieInode;
+  };
+
+  struct indexSlot {
+    uint32_t fingerprint;
+    uint32_t offset;
+  };
+
+  const indexSlot *actorIndex;
+  const indexSlot *movieIndex;
+  uint32_t actorMask;
+  uint32_t movieMask;
+
+  // The delta, replayed: the complete credits of every actor it touched, and the complete
+  // casts of every film it touched, the latter sorted by film so that getCast can binary
+  // search them without building a film.  Records the delta overrides are flagged in
+  // touchedActors and touchedMovies (indexed by record offset / 4), and their merged lists
+  // are found through actorOverrides and movieOverrides (keyed by record offset), so
+  // lookups of everyone else cost a single extra bit test.  Names are only looked up in
+  // the overlay when they're missing from the data files altogether.
+  struct castDelta {
+    film movie;
+    std::vector<std::string> cast;
+  };
+
+  std::unordered_map<std::string, std::vector<film>> deltaCredits;
+  std::vector<castDelta> deltaCasts;
+  std::vector<bool> touchedActors;
+  std::vector<bool> touchedMovies;
+  std::unordered_map<int, const std::vector<film> *> actorOverrides;
+  std::unordered_map<int, const castDelta *> movieOverrides;
+
+  int findActorRecord(const std::string& player) const;
+  int findMovieRecord(const char *title, size_t length, int year) const;
+  bool getCast(const char *title, size_t length, int movieYear, castRange& players) const;
+  bool loadIndex(const std::string& fileName);
+  bool buildIndex(const std::string& fileName) const;
+  bool loadDelta(const std::string& fileName);
   
-  static const void *acquireFileMap(const std::string& fileName, struct fileInfo& info);
+  static const void *acquireFileMap(const std::string& fileName, struct fileInfo& info, loadPolicy policy);
+  static const void *copyIntoHugePages(struct fileInfo& info);
   static void releaseFileMap(struct fileInfo& info);
   static bool actorCompare();
 
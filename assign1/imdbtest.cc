@@ -3,6 +3,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <chrono>  // for steady_clock, used by the microbenchmark
 #include "imdb.h"
 using namespace std;
 
@@ -143,9 +144,64 @@ static void listAllMoviesAndCostars(const imdb& db, const string& player) {
   listCostars(player, credits, db);
 }
 
+/**
+ * Function: benchmarkLookups
+ * --------------------------
+ * Microbenchmark comparing the owning and view-returning flavors of getCredits and
+ * getCast.  Each round looks up the specified player's credits and then the cast of
+ * every one of those films, touching every name, and the rounds are timed for each
+ * flavor separately.  The total number of characters seen by each flavor is printed
+ * too, both as a sanity check and so the optimizer can't discard the work.
+ */
+static const int kNumBenchmarkRounds = 200;
+static void benchmarkLookups(const imdb& db, const string& player) {
+  vector<film> credits;
+  if (!db.getCredits(player, credits)) {
+    cout << "We're sorry, but " << player 
+	 << " doesn't appear to be in our database." << endl;
+    return;
+  }
+
+  size_t owningChars = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int round = 0; round < kNumBenchmarkRounds; round++) {
+    vector<film> films;
+    db.getCredits(player, films);
+    for (const film& movie: films) {
+      vector<string> cast;
+      db.getCast(movie, cast);
+      for (const string& costar: cast) owningChars += costar.size();
+    }
+  }
+  chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+
+  size_t viewChars = 0;
+  for (int round = 0; round < kNumBenchmarkRounds; round++) {
+    creditRange films;
+    db.getCredits(player, films);
+    for (const filmView& movie: films) {
+      castRange cast;
+      db.getCast(movie, cast);
+      for (const stringView& costar: cast) viewChars += costar.length;
+    }
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+  double owningMicros = chrono::duration<double, micro>(middle - start).count() / kNumBenchmarkRounds;
+  double viewMicros = chrono::duration<double, micro>(end - middle).count() / kNumBenchmarkRounds;
+  cout << "  " << player << ": " << credits.size() << " films, " << kNumBenchmarkRounds << " rounds"
+       << (db.hasIndex() ? " (indexed)" : " (binary search)") << endl;
+  cout << "    owning (vector<film>, vector<string>): " << fixed << setprecision(1) << setw(10) << owningMicros
+       << " us/round, " << owningChars << " chars" << endl;
+  cout << "    views  (creditRange, castRange):       " << setw(10) << viewMicros
+       << " us/round, " << viewChars << " chars" << endl;
+  if (viewMicros > 0) cout << "    speedup: " << setprecision(2) << owningMicros / viewMicros << "x" << endl;
+}
+
 int main(int argc, const char *argv[]) {
-  if (argc != 2) {
-    cerr << "Usage: " << argv[0] << " <actor>" << endl;
+  bool benchmark = argc == 3 && string(argv[1]) == "--benchmark";
+  if (argc != 2 && !benchmark) {
+    cerr << "Usage: " << argv[0] << " [--benchmark] <actor>" << endl;
     return kWrongArgumentCount;
   }
 
@@ -155,6 +211,11 @@ int main(int argc, const char *argv[]) {
     return kDatabaseNotFound;
   }
 
+  if (benchmark) {
+    benchmarkLookups(db, argv[2]);
+    return 0;
+  }
+
   string player = argv[1];
   listAllMoviesAndCostars(db, player);
   return 0;
@@ -1,5 +1,6 @@
 #include "path.h"
 #include <iostream>
+#include <sstream>
 using namespace std;
 
 /**
@@ -54,6 +55,15 @@ void path::reverse() {
   *this = reverseOfPath;
 }
 
+string path::toCompactString() const {
+  ostringstream oss;
+  oss << startPlayer;
+  for (int i = 0; i < (int) links.size(); i++) {
+    oss << " -> \"" << links[i].movie.title << "\" (" << links[i].movie.year << ") -> " << links[i].player;
+  }
+  return oss.str();
+}
+
 ostream& operator<<(ostream& os, const path& p) {
   if (p.links.size() == 0) return os << string("[Empty path]") << endl;
   
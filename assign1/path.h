@@ -104,6 +104,20 @@ class path {
    * Reverses the receiving path.
    */
   void reverse();
+
+  /**
+   * Method: toCompactString
+   * -----------------------
+   * Returns the path rendered on a single line, as in
+   *
+   *    Kevin Bacon -> "Footloose" (1984) -> Sarah Jessica Parker
+   *
+   * which is more convenient than operator<< when many paths
+   * are being printed one per line.
+   *
+   * @return the single-line rendering of the path.
+   */
+  std::string toCompactString() const;
   
  private:
   // private struct definition... no one else uses it, so I define it internally
@@ -0,0 +1,98 @@
+/**
+ * File: search-bench.cc
+ * ---------------------
+ * Compares the forward-only and bidirectional searches exported by search-engine.h.
+ * Actor pairs are read from standard input, one per line, with the two names
+ * separated by a tab.  Each pair is searched both ways, and the wall time and
+ * number of nodes expanded by each search are printed, followed by totals.
+ * The lengths of the two paths are checked against each other, since both
+ * searches are expected to find a shortest path.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "path.h"
+#include "search-engine.h"
+using namespace std;
+using namespace std::chrono;
+
+static const int kDatabaseNotFound = 2;
+static const int kPathLengthMismatch = 3;
+static const size_t kMaxSearchDepth = 7;
+
+typedef bool (*searchFunction)(const imdb&, const string&, const string&, size_t, path&, searchStats&);
+
+/**
+ * Function: timeSearch
+ * --------------------
+ * Runs the supplied search over the specified pair and returns the number of
+ * milliseconds it took.  The length of the path found (or -1 if none was found)
+ * is placed in length, and stats is updated with the nodes expanded.
+ */
+static double timeSearch(searchFunction search, const imdb& db, const string& startingActor,
+                         const string& targetActor, int& length, searchStats& stats) {
+  path result(startingActor);
+  steady_clock::time_point start = steady_clock::now();
+  bool found = search(db, startingActor, targetActor, kMaxSearchDepth, result, stats);
+  steady_clock::time_point end = steady_clock::now();
+  length = found ? (int) result.getLength() : -1;
+  return duration<double, milli>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  imdb db(kIMDBDataDirectory);
+  if (!db.good()) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+
+  cout << left << setw(50) << "pair" << right
+       << setw(6) << "hops" << setw(12) << "fwd ms" << setw(12) << "fwd nodes"
+       << setw(12) << "bidi ms" << setw(12) << "bidi nodes" << endl;
+
+  double forwardTotal = 0, bidirectionalTotal = 0;
+  size_t forwardNodes = 0, bidirectionalNodes = 0, numPairs = 0;
+  bool mismatch = false;
+  string line;
+  while (getline(cin, line)) {
+    size_t tab = line.find('\t');
+    if (tab == string::npos) continue;
+    string startingActor = line.substr(0, tab);
+    string targetActor = line.substr(tab + 1);
+
+    int forwardLength, bidirectionalLength;
+    searchStats forwardStats, bidirectionalStats;
+    double forwardTime = timeSearch(forwardSearch, db, startingActor, targetActor, forwardLength, forwardStats);
+    double bidirectionalTime = timeSearch(bidirectionalSearch, db, startingActor, targetActor,
+                                          bidirectionalLength, bidirectionalStats);
+
+    cout << left << setw(50) << (startingActor + " -> " + targetActor).substr(0, 49) << right
+         << setw(6) << forwardLength << fixed << setprecision(2)
+         << setw(12) << forwardTime << setw(12) << forwardStats.nodesExpanded()
+         << setw(12) << bidirectionalTime << setw(12) << bidirectionalStats.nodesExpanded();
+    if (forwardLength != bidirectionalLength) {
+      cout << "  MISMATCH (bidirectional found " << bidirectionalLength << " hops)";
+      mismatch = true;
+    }
+    cout << endl;
+
+    forwardTotal += forwardTime;
+    bidirectionalTotal += bidirectionalTime;
+    forwardNodes += forwardStats.nodesExpanded();
+    bidirectionalNodes += bidirectionalStats.nodesExpanded();
+    numPairs++;
+  }
+
+  cout << left << setw(50) << "total" << right << setw(6) << numPairs
+       << setw(12) << forwardTotal << setw(12) << forwardNodes
+       << setw(12) << bidirectionalTotal << setw(12) << bidirectionalNodes << endl;
+  if (bidirectionalTotal > 0 && bidirectionalNodes > 0) {
+    cout << "speedup " << setprecision(2) << forwardTotal / bidirectionalTotal << "x wall time, "
+         << (double) forwardNodes / bidirectionalNodes << "x nodes expanded" << endl;
+  }
+  return mismatch ? kPathLengthMismatch : 0;
+}
@@ -0,0 +1,607 @@
+/**
+ * File: search-engine.cc
+ * ----------------------
+ * Presents the implementation of the searches exported by search-engine.h.
+ */
+
+#include "search-engine.h"
+#include "thread-pool.h"
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+/**
+ * Convenience struct: discovery
+ * -----------------------------
+ * Records how an actor was first reached by a search (or by one side of a
+ * bidirectional search): the film shared with the neighbor one step closer to
+ * the root, the neighbor itself, and the number of films separating the actor
+ * from the root.  Paths are rebuilt from these parent pointers once the search
+ * succeeds, so no partial path is ever copied while the search is running.
+ */
+struct discovery {
+    film movie;
+    string player;
+    size_t depth;
+};
+
+/**
+ * Convenience struct: searchSide
+ * ------------------------------
+ * Everything one half of a bidirectional search needs: the actor it's rooted at,
+ * the actors discovered on its most recent level, how every discovered actor was
+ * reached, and the films whose casts it has already pulled.  The forward search
+ * uses a single searchSide, treating its frontier as the queue.
+ */
+struct searchSide {
+    string root;
+    vector<string> frontier;
+    unordered_map<string, discovery> reached;
+    set<film> visitedFilms;
+    size_t depth;
+
+    searchSide(const string& root) : root(root), depth(0) {
+        frontier.push_back(root);
+        reached[root] = discovery{film(), string(), 0};
+    }
+};
+
+/**
+ * Method: prependPathFromRoot
+ * ---------------------------
+ * Follows parent pointers from the specified actor back to the side's root, then
+ * adds one connection to the path for each step, in order from the root outward.
+ */
+static void prependPathFromRoot(const searchSide& side, const string& player, path& result) {
+    vector<pair<film, string>> steps;
+    for (string current = player; current != side.root; ) {
+        const discovery& step = side.reached.at(current);
+        steps.push_back(make_pair(step.movie, current));
+        current = step.player;
+    }
+    for (size_t i = steps.size(); i > 0; i--) {
+        result.addConnection(steps[i - 1].first, steps[i - 1].second);
+    }
+}
+
+bool forwardSearch(const imdb& db, const string& startingActor, const string& targetActor,
+                   size_t maxSearchDepth, path& result, searchStats& stats) {
+    searchSide side(startingActor);
+    for (size_t next = 0; next < side.frontier.size(); next++) {
+        string player = side.frontier[next]; // copied, since the frontier grows below
+        size_t depth = side.reached[player].depth;
+
+        // If exceeding search depth, give up
+        if (depth >= maxSearchDepth) {
+            return false;
+        }
+
+        vector<film> credits;
+        db.getCredits(player, credits);
+        stats.actorsExpanded++;
+
+        for (const film& movie: credits) {
+            if (!side.visitedFilms.insert(movie).second) continue; // Film has already been visited
+
+            vector<string> cast;
+            db.getCast(movie, cast);
+            stats.filmsExpanded++;
+
+            for (const string& costar: cast) {
+                if (side.reached.count(costar) > 0) continue; // Actor has already been visited
+                side.reached[costar] = discovery{movie, player, depth + 1};
+
+                if (costar == targetActor) {
+                    path found(startingActor);
+                    prependPathFromRoot(side, costar, found);
+                    result = found;
+                    return true;
+                }
+
+                side.frontier.push_back(costar);
+            }
+        }
+    }
+    return false;
+}
+
+bool forwardSearch(const imdb& db, const castCache& cache, const string& startingActor,
+                   const string& targetActor, size_t maxSearchDepth, path& result, searchStats& stats) {
+    // Every film in the target's credits has the target in its cast, so finding one among
+    // a level's credits ends the search before any of that level's casts are decoded
+    set<film> targetFilms;
+    if (startingActor != targetActor) {
+        vector<film> credits;
+        db.getCredits(targetActor, credits);
+        stats.actorsExpanded++;
+        targetFilms.insert(credits.begin(), credits.end());
+    }
+
+    searchSide side(startingActor);
+    while (side.depth < maxSearchDepth && !side.frontier.empty()) {
+        vector<vector<film>> credits(side.frontier.size());
+        for (size_t i = 0; i < side.frontier.size(); i++) {
+            db.getCredits(side.frontier[i], credits[i]);
+            stats.actorsExpanded++;
+
+            // The first target film in expansion order is the one forwardSearch finds the target in
+            for (const film& movie: credits[i]) {
+                if (targetFilms.count(movie) == 0) continue;
+                side.reached[targetActor] = discovery{movie, side.frontier[i], side.depth + 1};
+                path found(startingActor);
+                prependPathFromRoot(side, targetActor, found);
+                result = found;
+                return true;
+            }
+        }
+
+        vector<string> next;
+        for (size_t i = 0; i < side.frontier.size(); i++) {
+            const string& player = side.frontier[i];
+            for (const film& movie: credits[i]) {
+                if (!side.visitedFilms.insert(movie).second) continue; // Film has already been visited
+
+                vector<string> decoded;
+                const vector<string> *cast = cache.getCast(movie);
+                if (cast != NULL) {
+                    stats.castsCached++;
+                } else {
+                    db.getCast(movie, decoded);
+                    cast = &decoded;
+                }
+                stats.filmsExpanded++;
+
+                for (const string& costar: *cast) {
+                    if (side.reached.count(costar) > 0) continue; // Actor has already been visited
+                    side.reached[costar] = discovery{movie, player, side.depth + 1};
+                    next.push_back(costar);
+                }
+            }
+        }
+
+        side.frontier.swap(next);
+        side.depth++;
+    }
+    return false;
+}
+
+/**
+ * Method: expandLevel
+ * -------------------
+ * Advances the supplied side of a bidirectional search by one full level.  Every
+ * newly discovered actor already reached by the other side is a meeting point,
+ * and the one yielding the shortest overall path is recorded in meetingActor.
+ *
+ * @return true if and only if the two sides met during this level.
+ */
+static bool expandLevel(const imdb& db, searchSide& side, const searchSide& other,
+                        string& meetingActor, searchStats& stats) {
+    size_t bestLength = 0;
+    vector<string> next;
+    for (const string& player: side.frontier) {
+        vector<film> credits;
+        db.getCredits(player, credits);
+        stats.actorsExpanded++;
+
+        for (const film& movie: credits) {
+            if (!side.visitedFilms.insert(movie).second) continue; // Film has already been visited
+
+            vector<string> cast;
+            db.getCast(movie, cast);
+            stats.filmsExpanded++;
+
+            for (const string& costar: cast) {
+                if (side.reached.count(costar) > 0) continue; // Actor has already been visited
+                side.reached[costar] = discovery{movie, player, side.depth + 1};
+                next.push_back(costar);
+
+                unordered_map<string, discovery>::const_iterator found = other.reached.find(costar);
+                if (found == other.reached.end()) continue;
+                size_t length = side.depth + 1 + found->second.depth;
+                if (meetingActor.empty() || length < bestLength) {
+                    meetingActor = costar;
+                    bestLength = length;
+                }
+            }
+        }
+    }
+
+    side.frontier.swap(next);
+    side.depth++;
+    return !meetingActor.empty();
+}
+
+bool bidirectionalSearch(const imdb& db, const string& startingActor, const string& targetActor,
+                         size_t maxSearchDepth, path& result, searchStats& stats) {
+    if (startingActor == targetActor) return false;
+
+    searchSide fromStart(startingActor);
+    searchSide fromTarget(targetActor);
+    string meetingActor;
+    while (fromStart.depth + fromTarget.depth < maxSearchDepth &&
+           !fromStart.frontier.empty() && !fromTarget.frontier.empty()) {
+        bool met = fromStart.frontier.size() <= fromTarget.frontier.size() ?
+            expandLevel(db, fromStart, fromTarget, meetingActor, stats) :
+            expandLevel(db, fromTarget, fromStart, meetingActor, stats);
+        if (met) break;
+    }
+    if (meetingActor.empty()) return false;
+
+    // Lay down the connections from the starting actor out to the meeting point
+    path stitched(startingActor);
+    prependPathFromRoot(fromStart, meetingActor, stitched);
+
+    // The target side already points from the meeting point toward the target actor
+    for (string player = meetingActor; player != targetActor; ) {
+        const discovery& step = fromTarget.reached[player];
+        stitched.addConnection(step.movie, step.player);
+        player = step.player;
+    }
+
+    result = stitched;
+    return true;
+}
+
+/**
+ * Convenience struct: graphSide
+ * -----------------------------
+ * The snapshot-backed analog of searchSide.  Every array is indexed by actor (or film)
+ * ID; an actor has been reached if and only if its depth is non-negative, and the
+ * root is the one reached actor whose parentActor is itself.
+ */
+struct graphSide {
+    int root;
+    vector<int> frontier;
+    vector<int> parentActor;
+    vector<int> parentFilm;
+    vector<int> depth;
+    vector<bool> visitedFilms;
+    int currentDepth;
+
+    graphSide(const imdbGraph& graph, int root) : root(root), parentActor(graph.getNumActors(), -1),
+        parentFilm(graph.getNumActors(), -1), depth(graph.getNumActors(), -1),
+        visitedFilms(graph.getNumFilms(), false), currentDepth(0) {
+        frontier.push_back(root);
+        parentActor[root] = root;
+        depth[root] = 0;
+    }
+};
+
+/**
+ * Method: appendPathToRoot
+ * ------------------------
+ * Adds one connection to the path for each step taken from the specified actor
+ * toward the side's root, following parent pointers.  This is exactly right for
+ * the half of a search rooted at the target actor; the half rooted at the starting
+ * actor needs its steps laid down in the opposite order (see prependPathFromRoot).
+ */
+static void appendPathToRoot(const imdbGraph& graph, const graphSide& side, int player, path& result) {
+    while (player != side.root) {
+        result.addConnection(graph.getFilm(side.parentFilm[player]), graph.getActorName(side.parentActor[player]));
+        player = side.parentActor[player];
+    }
+}
+
+/**
+ * Method: prependPathFromRoot
+ * ---------------------------
+ * Adds one connection to the path for each step from the side's root to the
+ * specified actor, in root-to-actor order.
+ */
+static void prependPathFromRoot(const imdbGraph& graph, const graphSide& side, int player, path& result) {
+    vector<int> players;
+    for (; player != side.root; player = side.parentActor[player]) players.push_back(player);
+    for (vector<int>::reverse_iterator itr = players.rbegin(); itr != players.rend(); ++itr) {
+        result.addConnection(graph.getFilm(side.parentFilm[*itr]), graph.getActorName(*itr));
+    }
+}
+
+bool forwardSearch(const imdbGraph& graph, int startingActor, int targetActor,
+                   size_t maxSearchDepth, path& result, searchStats& stats) {
+    vector<path> results;
+    vector<bool> found;
+    if (forwardSearch(graph, startingActor, vector<int>(1, targetActor), maxSearchDepth, results, found, stats) == 0) {
+        return false;
+    }
+    result = results[0];
+    return true;
+}
+
+size_t forwardSearch(const imdbGraph& graph, int startingActor, const vector<int>& targetActors,
+                     size_t maxSearchDepth, vector<path>& results, vector<bool>& found,
+                     searchStats& stats) {
+    results.assign(targetActors.size(), path(graph.getActorName(startingActor)));
+    found.assign(targetActors.size(), false);
+
+    // Each target maps to every query asking for it, and the search ends once none are left pending
+    unordered_map<int, vector<size_t>> queries;
+    for (size_t i = 0; i < targetActors.size(); i++) {
+        if (targetActors[i] != startingActor) queries[targetActors[i]].push_back(i);
+    }
+    size_t numPending = queries.size();
+    size_t numFound = 0;
+    if (numPending == 0) return 0;
+
+    // The frontier doubles as the queue: actors are appended as they're discovered
+    // and expanded in that same order, which is the order the imdb-backed search uses.
+    graphSide side(graph, startingActor);
+    for (size_t next = 0; next < side.frontier.size(); next++) {
+        int player = side.frontier[next];
+        if ((size_t) side.depth[player] >= maxSearchDepth) return numFound;
+        stats.actorsExpanded++;
+
+        for (uint32_t movie: graph.getCredits(player)) {
+            if (side.visitedFilms[movie]) continue; // Film has already been visited
+            side.visitedFilms[movie] = true;
+            stats.filmsExpanded++;
+
+            for (uint32_t costar: graph.getCast(movie)) {
+                if (side.depth[costar] >= 0) continue; // Actor has already been visited
+                side.parentActor[costar] = player;
+                side.parentFilm[costar] = movie;
+                side.depth[costar] = side.depth[player] + 1;
+                side.frontier.push_back(costar);
+
+                unordered_map<int, vector<size_t>>::const_iterator target = queries.find(costar);
+                if (target == queries.end()) continue;
+                for (size_t i: target->second) {
+                    prependPathFromRoot(graph, side, costar, results[i]);
+                    found[i] = true;
+                    numFound++;
+                }
+                if (--numPending == 0) return numFound;
+            }
+        }
+    }
+    return numFound;
+}
+
+size_t distanceMap(const imdbGraph& graph, int startingActor, vector<uint8_t>& distances,
+                   vector<uint32_t>& parentFilms, searchStats& stats) {
+    distances.assign(graph.getNumActors(), kUnreachableDistance);
+    parentFilms.assign(graph.getNumActors(), kNoParentFilm);
+    vector<bool> visitedFilms(graph.getNumFilms(), false);
+
+    // Same queue discipline as forwardSearch, so each parent film is the one its path would use
+    vector<uint32_t> queue(1, startingActor);
+    distances[startingActor] = 0;
+    for (size_t next = 0; next < queue.size(); next++) {
+        uint32_t player = queue[next];
+        if (distances[player] + 1 >= kUnreachableDistance) break; // deeper distances can't be represented
+        stats.actorsExpanded++;
+
+        for (uint32_t movie: graph.getCredits(player)) {
+            if (visitedFilms[movie]) continue; // Film has already been visited
+            visitedFilms[movie] = true;
+            stats.filmsExpanded++;
+
+            for (uint32_t costar: graph.getCast(movie)) {
+                if (distances[costar] != kUnreachableDistance) continue; // Actor has already been visited
+                distances[costar] = distances[player] + 1;
+                parentFilms[costar] = movie;
+                queue.push_back(costar);
+            }
+        }
+    }
+    return queue.size();
+}
+
+/**
+ * Method: expandLevel
+ * -------------------
+ * Snapshot-backed analog of the expandLevel above.  meetingActor is -1 until the
+ * two sides meet.
+ */
+static bool expandLevel(const imdbGraph& graph, graphSide& side, const graphSide& other,
+                        int& meetingActor, searchStats& stats) {
+    int bestLength = 0;
+    vector<int> next;
+    for (int player: side.frontier) {
+        stats.actorsExpanded++;
+        for (uint32_t movie: graph.getCredits(player)) {
+            if (side.visitedFilms[movie]) continue; // Film has already been visited
+            side.visitedFilms[movie] = true;
+            stats.filmsExpanded++;
+
+            for (uint32_t costar: graph.getCast(movie)) {
+                if (side.depth[costar] >= 0) continue; // Actor has already been visited
+                side.parentActor[costar] = player;
+                side.parentFilm[costar] = movie;
+                side.depth[costar] = side.currentDepth + 1;
+                next.push_back(costar);
+
+                if (other.depth[costar] < 0) continue;
+                int length = side.currentDepth + 1 + other.depth[costar];
+                if (meetingActor == -1 || length < bestLength) {
+                    meetingActor = costar;
+                    bestLength = length;
+                }
+            }
+        }
+    }
+
+    side.frontier.swap(next);
+    side.currentDepth++;
+    return meetingActor != -1;
+}
+
+bool bidirectionalSearch(const imdbGraph& graph, int startingActor, int targetActor,
+                         size_t maxSearchDepth, path& result, searchStats& stats) {
+    if (startingActor == targetActor) return false;
+
+    graphSide fromStart(graph, startingActor);
+    graphSide fromTarget(graph, targetActor);
+    int meetingActor = -1;
+    while ((size_t) (fromStart.currentDepth + fromTarget.currentDepth) < maxSearchDepth &&
+           !fromStart.frontier.empty() && !fromTarget.frontier.empty()) {
+        bool met = fromStart.frontier.size() <= fromTarget.frontier.size() ?
+            expandLevel(graph, fromStart, fromTarget, meetingActor, stats) :
+            expandLevel(graph, fromTarget, fromStart, meetingActor, stats);
+        if (met) break;
+    }
+    if (meetingActor == -1) return false;
+
+    result = path(graph.getActorName(startingActor));
+    prependPathFromRoot(graph, fromStart, meetingActor, result);
+    appendPathToRoot(graph, fromTarget, meetingActor, result);
+    return true;
+}
+
+/**
+ * Class: atomicBitset
+ * -------------------
+ * Fixed-size bitset whose bits can be claimed concurrently.  testAndSet
+ * sets the specified bit and reports whether it was already set, so
+ * exactly one of several racing threads sees false for any given bit.
+ */
+class atomicBitset {
+ public:
+    atomicBitset(size_t numBits) : words((numBits + 63) / 64) {
+        for (atomic<uint64_t>& word: words) word.store(0, memory_order_relaxed);
+    }
+
+    bool testAndSet(size_t bit) {
+        uint64_t mask = 1ULL << (bit % 64);
+        return (words[bit / 64].fetch_or(mask, memory_order_relaxed) & mask) != 0;
+    }
+
+ private:
+    vector<atomic<uint64_t>> words;
+};
+
+/**
+ * Method: atomicMin
+ * -----------------
+ * Lowers the value held by the specified atomic to key, unless it's already lower.
+ */
+static void atomicMin(atomic<uint64_t>& slot, uint64_t key) {
+    uint64_t current = slot.load(memory_order_relaxed);
+    while (key < current && !slot.compare_exchange_weak(current, key, memory_order_relaxed));
+}
+
+/**
+ * Method: runInParallel
+ * ---------------------
+ * Invokes work(thread, i) for every i in [0, numItems), handing out chunks of
+ * consecutive items to numThreads threads as they ask for them, so a chunk full
+ * of hub actors doesn't hold up the rest of the level.  The calling thread is
+ * thread 0, and the other numThreads - 1 are borrowed from the supplied pool, which
+ * lives as long as the search so no level pays for starting threads.  Returns once
+ * every item has been processed.  Small batches are simply processed on the calling
+ * thread.
+ */
+static const size_t kItemsPerChunk = 64;
+template <typename Work>
+static void runInParallel(ThreadPool& pool, size_t numThreads, size_t numItems, const Work& work) {
+    if (numThreads <= 1 || numItems <= kItemsPerChunk) {
+        for (size_t i = 0; i < numItems; i++) work(0, i);
+        return;
+    }
+
+    atomic<size_t> nextItem(0);
+    auto drain = [&nextItem, &work, numItems](size_t t) {
+        while (true) {
+            size_t first = nextItem.fetch_add(kItemsPerChunk);
+            if (first >= numItems) return;
+            for (size_t i = first; i < min(first + kItemsPerChunk, numItems); i++) work(t, i);
+        }
+    };
+    for (size_t t = 1; t < numThreads; t++) {
+        pool.schedule([&drain, t]() { drain(t); });
+    }
+    drain(0);
+    pool.wait();
+}
+
+bool parallelSearch(const imdbGraph& graph, int startingActor, int targetActor, size_t maxSearchDepth,
+                    size_t numThreads, path& result, searchStats& stats) {
+    if (startingActor == targetActor) return false;
+    if (numThreads == 0) numThreads = 1;
+
+    // A film (or actor) reached at the current level remembers the earliest way it was reached, encoded
+    // so that smaller keys are the ones the single-threaded search would have come across first:
+    //     film key:  (frontier index << 16) | credit index
+    //     actor key: (frontier index << 32) | (credit index << 16) | cast index
+    // Credit and cast lists hold at most 32767 entries, since the data files store their lengths as shorts.
+    const uint64_t kUnreached = UINT64_MAX;
+    vector<atomic<uint64_t>> filmKeys(graph.getNumFilms());
+    vector<atomic<uint64_t>> actorKeys(graph.getNumActors());
+    for (atomic<uint64_t>& key: filmKeys) key.store(kUnreached, memory_order_relaxed);
+    for (atomic<uint64_t>& key: actorKeys) key.store(kUnreached, memory_order_relaxed);
+    atomicBitset filmsReached(graph.getNumFilms());
+    atomicBitset actorsReached(graph.getNumActors());
+
+    // side's depth and visitedFilms only change between levels, so workers can read them freely
+    graphSide side(graph, startingActor);
+    vector<searchStats> threadStats(numThreads);
+    ThreadPool pool(numThreads - 1);
+    for (size_t level = 0; level < maxSearchDepth && !side.frontier.empty() && side.depth[targetActor] < 0; level++) {
+        const vector<int>& frontier = side.frontier;
+        vector<vector<int>> newFilms(numThreads), newActors(numThreads);
+
+        // Phase one: every film not visited at an earlier level goes to the earliest credit reaching it
+        runInParallel(pool, numThreads, frontier.size(), [&](size_t thread, size_t i) {
+            idSpan credits = graph.getCredits(frontier[i]);
+            for (size_t j = 0; j < credits.size(); j++) {
+                uint32_t movie = credits[j];
+                if (side.visitedFilms[movie]) continue; // Film has already been visited
+                if (!filmsReached.testAndSet(movie)) newFilms[thread].push_back(movie);
+                atomicMin(filmKeys[movie], ((uint64_t) i << 16) | j);
+            }
+        });
+
+        // Phase two: each film's cast is pulled once, by the credit that won it, and every actor
+        // not visited at an earlier level goes to the earliest cast entry reaching it
+        runInParallel(pool, numThreads, frontier.size(), [&](size_t thread, size_t i) {
+            threadStats[thread].actorsExpanded++;
+            idSpan credits = graph.getCredits(frontier[i]);
+            for (size_t j = 0; j < credits.size(); j++) {
+                uint32_t movie = credits[j];
+                if (side.visitedFilms[movie]) continue; // Film has already been visited
+                if (filmKeys[movie].load(memory_order_relaxed) != (((uint64_t) i << 16) | j)) continue;
+                threadStats[thread].filmsExpanded++;
+
+                idSpan cast = graph.getCast(movie);
+                for (size_t k = 0; k < cast.size(); k++) {
+                    uint32_t costar = cast[k];
+                    if (side.depth[costar] >= 0) continue; // Actor has already been visited
+                    if (!actorsReached.testAndSet(costar)) newActors[thread].push_back(costar);
+                    atomicMin(actorKeys[costar], ((uint64_t) i << 32) | ((uint64_t) j << 16) | k);
+                }
+            }
+        });
+
+        // Merge: order the new actors the way the single-threaded search would have queued them
+        for (const vector<int>& films: newFilms) {
+            for (int movie: films) side.visitedFilms[movie] = true;
+        }
+        vector<int> next;
+        for (const vector<int>& actors: newActors) next.insert(next.end(), actors.begin(), actors.end());
+        sort(next.begin(), next.end(), [&actorKeys](int a, int b) {
+            return actorKeys[a].load(memory_order_relaxed) < actorKeys[b].load(memory_order_relaxed);
+        });
+
+        for (int costar: next) {
+            uint64_t key = actorKeys[costar].load(memory_order_relaxed);
+            int player = frontier[key >> 32];
+            side.parentActor[costar] = player;
+            side.parentFilm[costar] = graph.getCredits(player)[(key >> 16) & 0xffff];
+            side.depth[costar] = level + 1;
+        }
+        side.frontier.swap(next);
+    }
+
+    for (const searchStats& counts: threadStats) {
+        stats.actorsExpanded += counts.actorsExpanded;
+        stats.filmsExpanded += counts.filmsExpanded;
+    }
+    if (side.depth[targetActor] < 0) return false;
+
+    result = path(graph.getActorName(startingActor));
+    prependPathFromRoot(graph, side, targetActor, result);
+    return true;
+}
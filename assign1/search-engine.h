@@ -0,0 +1,180 @@
+/**
+ * File: search-engine.h
+ * ---------------------
+ * Exports the breadth-first searches used by search (and by the benchmarking
+ * programs) to connect two actors/actresses through a chain of shared films.
+ * Two strategies are provided: the classic forward-only search, which grows a
+ * single frontier outward from the starting actor, and a bidirectional search,
+ * which grows frontiers from both ends (always advancing the smaller one) and
+ * stitches the two halves together where they meet.
+ *
+ * Each strategy comes in two flavors: one that runs directly against an imdb,
+ * and one that runs against the dense integer IDs of an imdbGraph snapshot,
+ * resolving names only once the final path is assembled.  Because the snapshot
+ * preserves the order of every credit and cast list, both flavors of a strategy
+ * find exactly the same path.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "imdb.h"
+#include "imdb-graph.h"
+#include "path.h"
+#include "cast-cache.h"
+
+/**
+ * Convenience struct: searchStats
+ * -------------------------------
+ * Bundles the counters a search updates as it runs.  actorsExpanded counts the
+ * getCredits lookups performed, and filmsExpanded counts the getCast lookups
+ * performed, so their sum is the number of nodes expanded by the search.
+ * castsCached counts the films among those whose casts came from a castCache
+ * instead of the data files, so recordsDecoded is the number of records the
+ * search actually decoded.
+ */
+struct searchStats {
+  size_t actorsExpanded;
+  size_t filmsExpanded;
+  size_t castsCached;
+
+  searchStats() : actorsExpanded(0), filmsExpanded(0), castsCached(0) {}
+  size_t nodesExpanded() const { return actorsExpanded + filmsExpanded; }
+  size_t recordsDecoded() const { return nodesExpanded() - castsCached; }
+};
+
+/**
+ * Function: forwardSearch
+ * -----------------------
+ * Runs a breadth-first search outward from startingActor until targetActor is
+ * discovered or every path of length maxSearchDepth has been considered.
+ *
+ * @param db the imdb being searched.
+ * @param startingActor the actor/actress at the front of the path.
+ * @param targetActor the actor/actress at the end of the path.
+ * @param maxSearchDepth the maximum number of films the path may contain.
+ * @param result updated to store the shortest path if one is found.
+ * @param stats updated with the number of actors and films expanded.
+ * @return true if and only if a path was found.
+ */
+bool forwardSearch(const imdb& db, const std::string& startingActor, const std::string& targetActor,
+                   size_t maxSearchDepth, path& result, searchStats& stats);
+
+/**
+ * Function: forwardSearch
+ * -----------------------
+ * imdb-backed forward search that consults the supplied castCache before decoding
+ * any film's cast.  The search advances one full level at a time, and pulls the
+ * credits of every actor on a level before decoding any of the level's casts.  A
+ * film among them that's also in the target actor's credits (pulled once, up
+ * front) ends the search right there, so the casts of the last level are never
+ * decoded.  The path found is exactly the one the forwardSearch above finds.
+ *
+ * @param cache the castCache built over db.
+ * The remaining parameters and return value carry the same meaning as they do for
+ * forwardSearch above, and stats.castsCached is updated as well.
+ */
+bool forwardSearch(const imdb& db, const castCache& cache, const std::string& startingActor,
+                   const std::string& targetActor, size_t maxSearchDepth, path& result, searchStats& stats);
+
+/**
+ * Function: bidirectionalSearch
+ * -----------------------------
+ * Runs a breadth-first search from both startingActor and targetActor,
+ * expanding whichever frontier is smaller one full level at a time.  The
+ * search stops at the first level where the two frontiers meet, and the
+ * two halves are joined into a path running from startingActor to targetActor.
+ * The path found is always as short as the one forwardSearch would find,
+ * though it may pass through different films and actors when several
+ * shortest paths exist.
+ *
+ * The parameters and return value carry the same meaning as they do for
+ * forwardSearch.
+ */
+bool bidirectionalSearch(const imdb& db, const std::string& startingActor, const std::string& targetActor,
+                         size_t maxSearchDepth, path& result, searchStats& stats);
+
+/**
+ * Functions: forwardSearch
+ *            bidirectionalSearch
+ * ------------------------------
+ * Snapshot-backed versions of the two searches above.  The actors are identified by
+ * their imdbGraph IDs, visited actors and films are tracked in flat arrays indexed by
+ * ID, and each reached actor records only the film and actor it was reached through.
+ * The parameters and return value otherwise carry the same meaning as they do for
+ * the imdb-backed versions.
+ */
+bool forwardSearch(const imdbGraph& graph, int startingActor, int targetActor,
+                   size_t maxSearchDepth, path& result, searchStats& stats);
+bool bidirectionalSearch(const imdbGraph& graph, int startingActor, int targetActor,
+                         size_t maxSearchDepth, path& result, searchStats& stats);
+
+/**
+ * Function: parallelSearch
+ * ------------------------
+ * Snapshot-backed, level-synchronous forward search that splits each level's frontier
+ * across numThreads worker threads.  The threads are started once per search and reused
+ * by every level.  Visited actors and films are tracked in atomic bitsets, and each
+ * level's per-thread discoveries are merged before the next level begins.  Whenever
+ * several frontier actors reach the same film or actor, the one the single-threaded
+ * forwardSearch would have gotten to first wins, so the path found is exactly the
+ * path forwardSearch finds, no matter how many threads are used.
+ *
+ * @param numThreads the number of worker threads to expand each level with.
+ * The remaining parameters and return value carry the same meaning as they do for
+ * forwardSearch.
+ */
+bool parallelSearch(const imdbGraph& graph, int startingActor, int targetActor, size_t maxSearchDepth,
+                    size_t numThreads, path& result, searchStats& stats);
+
+/**
+ * Function: forwardSearch
+ * -----------------------
+ * Snapshot-backed forward search that answers many queries sharing the same starting
+ * actor with a single breadth-first search.  The search runs until every target has
+ * been discovered or every path of length maxSearchDepth has been considered, and
+ * each target's path is exactly the one the single-target forwardSearch would find.
+ *
+ * @param targetActors the IDs of the actors to connect startingActor to.  Repeats are fine.
+ * @param results resized to match targetActors, with results[i] updated to store the path
+ *                to targetActors[i] whenever found[i] is true.
+ * @param found resized to match targetActors, with found[i] set to true if and only if a
+ *              path to targetActors[i] was found.
+ * @return the number of targets a path was found for.
+ */
+size_t forwardSearch(const imdbGraph& graph, int startingActor, const std::vector<int>& targetActors,
+                     size_t maxSearchDepth, std::vector<path>& results, std::vector<bool>& found,
+                     searchStats& stats);
+
+/**
+ * Constants: kUnreachableDistance
+ *            kNoParentFilm
+ * --------------------------------
+ * The entries distanceMap leaves in place for actors it never reaches.  The
+ * starting actor is reached, but has no parent film.
+ */
+const uint8_t kUnreachableDistance = 0xff;
+const uint32_t kNoParentFilm = 0xffffffff;
+
+/**
+ * Function: distanceMap
+ * ---------------------
+ * Snapshot-backed breadth-first search that never stops early: it runs until every
+ * actor connected to startingActor has been reached, recording how many films
+ * separate each one from startingActor and which film it was first reached through.
+ * Apart from the two output arrays, the search needs just one visited bit per film
+ * and one queue entry per reached actor.  Each parent film is the one forwardSearch
+ * would put at the end of its path to that actor.
+ *
+ * @param distances resized to one entry per actor ID, with distances[id] set to the
+ *                  number of films separating that actor from startingActor, or to
+ *                  kUnreachableDistance if the two aren't connected.
+ * @param parentFilms resized to one entry per actor ID, with parentFilms[id] set to the
+ *                    ID of the film through which that actor was first reached, or to
+ *                    kNoParentFilm for startingActor and every unreachable actor.
+ * @param stats updated with the number of actors and films expanded.
+ * @return the number of actors reached, startingActor included.
+ */
+size_t distanceMap(const imdbGraph& graph, int startingActor, std::vector<uint8_t>& distances,
+                   std::vector<uint32_t>& parentFilms, searchStats& stats);
@@ -0,0 +1,464 @@
+/**
+ * File: search-server.cc
+ * ----------------------
+ * A long-running version of search.  The database (the imdb-snapshot file if
+ * there's one built from the current data files, and the imdb itself otherwise)
+ * is opened exactly once, so its pages stay resident across queries instead of
+ * being faulted back in by every new search process.
+ *
+ * Clients connect over TCP and send one request per line.  A request of the form
+ *
+ *    actor1<tab>actor2
+ *
+ * is answered with a single line holding the number of films separating the two
+ * (-1 if no path was found), a tab, and the path in the compact one-line form
+ * (or the usual "No path..." message).  A request consisting of just
+ *
+ *    stats
+ *
+ * is answered with a one-line summary of the requests served so far, including
+ * the cache hit count and the median (p50) and 99th percentile (p99) latencies.
+ * Connections stay open until the client closes its end, so many requests may
+ * be sent over the same connection.  Each open connection holds one of the server's
+ * threads, though, so a connection that sits idle (or stalls mid-response) for too
+ * long is closed by the server, freeing its thread for clients still waiting.
+ *
+ * Recent answers are kept in an LRU cache keyed on the unordered actor pair,
+ * since a path from one actor to another, reversed, is a shortest path in the
+ * other direction as well.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "imdb.h"
+#include "imdb-utils.h"
+#include "imdb-graph.h"
+#include "path.h"
+#include "search-engine.h"
+#include "server-socket.h"
+#include "thread-pool.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kServerStartFailure = 3;
+
+static const unsigned short kDefaultPort = 13110;
+static const unsigned short kIllegalPort = USHRT_MAX;
+static const size_t kMaxSearchDepth = 7;
+static const size_t kDefaultCacheSize = 4096;
+static const size_t kDefaultNumThreads = 16;
+static const int kDefaultIdleTimeout = 30; // seconds
+static const size_t kMaxLatencySamples = 1 << 16; // only the most recent samples feed the percentiles
+static const string kNoPathMessage = "No path between those two people could be found.";
+
+/**
+ * Convenience struct: answer
+ * --------------------------
+ * The outcome of one search: whether a path was found and, if so, the path itself.
+ */
+struct answer {
+  bool found;
+  path connection;
+
+  answer(const string& startingActor) : found(false), connection(startingActor) {}
+};
+
+/**
+ * Class: answerCache
+ * ------------------
+ * A fixed-capacity, thread-safe LRU cache of answers.  Each answer is stored with
+ * its path running from the alphabetically smaller actor to the larger one, so that
+ * a query for (a, b) and a query for (b, a) share the same entry.
+ */
+class answerCache {
+ public:
+  answerCache(size_t capacity) : capacity(capacity), hits(0), misses(0) {}
+
+/**
+ * Method: lookup
+ * --------------
+ * Returns true and populates result (oriented from startingActor to targetActor) if
+ * the pair is cached, and returns false otherwise.  Hits refresh the entry's recency.
+ */
+  bool lookup(const string& startingActor, const string& targetActor, answer& result) {
+    lock_guard<mutex> lg(lock);
+    unordered_map<string, list<entry>::iterator>::iterator found = index.find(makeKey(startingActor, targetActor));
+    if (found == index.end()) {
+      misses++;
+      return false;
+    }
+
+    hits++;
+    entries.splice(entries.begin(), entries, found->second);
+    result = found->second->value;
+    if (startingActor > targetActor) result.connection.reverse();
+    return true;
+  }
+
+/**
+ * Method: insert
+ * --------------
+ * Caches the specified answer (oriented from startingActor to targetActor), evicting
+ * the least recently used entry if the cache is full.
+ */
+  void insert(const string& startingActor, const string& targetActor, const answer& result) {
+    if (capacity == 0) return;
+    answer canonical = result;
+    if (startingActor > targetActor) canonical.connection.reverse();
+
+    string key = makeKey(startingActor, targetActor);
+    lock_guard<mutex> lg(lock);
+    if (index.count(key) > 0) return; // another thread answered the same pair first
+    entries.push_front(entry{key, canonical});
+    index[key] = entries.begin();
+    if (entries.size() > capacity) {
+      index.erase(entries.back().key);
+      entries.pop_back();
+    }
+  }
+
+/**
+ * Method: getCounts
+ * -----------------
+ * Reports the number of lookups that hit and missed, and the number of entries cached.
+ */
+  void getCounts(size_t& numHits, size_t& numMisses, size_t& size) {
+    lock_guard<mutex> lg(lock);
+    numHits = hits;
+    numMisses = misses;
+    size = entries.size();
+  }
+
+ private:
+  struct entry {
+    string key;
+    answer value;
+  };
+
+  size_t capacity;
+  size_t hits;
+  size_t misses;
+  list<entry> entries; // most recently used first
+  unordered_map<string, list<entry>::iterator> index;
+  mutex lock;
+
+  static string makeKey(const string& a, const string& b) {
+    return a < b ? a + '\t' + b : b + '\t' + a;
+  }
+};
+
+/**
+ * Class: latencyLog
+ * -----------------
+ * Thread-safe record of how long the most recent requests took to answer.
+ */
+class latencyLog {
+ public:
+  latencyLog() : numRecorded(0) {}
+
+  void record(double ms) {
+    lock_guard<mutex> lg(lock);
+    if (samples.size() < kMaxLatencySamples) {
+      samples.push_back(ms);
+    } else {
+      samples[numRecorded % kMaxLatencySamples] = ms;
+    }
+    numRecorded++;
+  }
+
+/**
+ * Method: summarize
+ * -----------------
+ * Reports the total number of requests recorded, along with the p50 and p99
+ * latencies (by nearest rank) over the retained samples.  Both percentiles
+ * are 0 if nothing has been recorded yet.
+ */
+  void summarize(size_t& count, double& p50, double& p99) {
+    vector<double> sorted;
+    {
+      lock_guard<mutex> lg(lock);
+      count = numRecorded;
+      sorted = samples;
+    }
+
+    p50 = p99 = 0;
+    if (sorted.empty()) return;
+    sort(sorted.begin(), sorted.end());
+    p50 = sorted[(sorted.size() - 1) * 50 / 100];
+    p99 = sorted[(sorted.size() - 1) * 99 / 100];
+  }
+
+ private:
+  vector<double> samples;
+  size_t numRecorded;
+  mutex lock;
+};
+
+/**
+ * Class: searchServer
+ * -------------------
+ * Owns the database opened at startup and everything shared by the threads
+ * answering requests.
+ */
+class searchServer {
+ public:
+  searchServer(const imdbGraph& graph, const imdb *db, bool bidirectional, size_t cacheSize) :
+    graph(graph), db(db), bidirectional(bidirectional), cache(cacheSize) {}
+
+/**
+ * Method: serveClient
+ * -------------------
+ * Answers requests arriving over the specified client connection, one per line,
+ * until the client closes its end (or a read or write times out), and then closes
+ * the connection.
+ */
+  void serveClient(int client) {
+    FILE *requests = fdopen(client, "r");
+    if (requests == NULL) {
+      close(client);
+      return;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, requests)) != -1) {
+      string request(line, length);
+      while (!request.empty() && (request.back() == '\n' || request.back() == '\r')) request.pop_back();
+      if (!sendLine(client, respond(request))) break;
+    }
+
+    free(line);
+    fclose(requests); // also closes client
+  }
+
+ private:
+  const imdbGraph& graph;
+  const imdb *db;
+  bool bidirectional;
+  answerCache cache;
+  latencyLog latencies;
+
+  string respond(const string& request) {
+    if (request == "stats") return describeStats();
+
+    size_t tab = request.find('\t');
+    if (tab == string::npos) return "error\tExpected <actor1><tab><actor2> or stats.";
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string startingActor = request.substr(0, tab);
+    string targetActor = request.substr(tab + 1);
+    answer result(startingActor);
+    if (!cache.lookup(startingActor, targetActor, result)) {
+      result.found = search(startingActor, targetActor, result.connection);
+      cache.insert(startingActor, targetActor, result);
+    }
+
+    ostringstream oss;
+    if (result.found) {
+      oss << result.connection.getLength() << '\t' << result.connection.toCompactString();
+    } else {
+      oss << -1 << '\t' << kNoPathMessage;
+    }
+    latencies.record(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    return oss.str();
+  }
+
+  bool search(const string& startingActor, const string& targetActor, path& result) {
+    searchStats stats;
+    if (graph.good()) {
+      int start = graph.getActorId(startingActor);
+      int target = graph.getActorId(targetActor);
+      if (start == -1 || target == -1) return false;
+      return bidirectional ?
+        bidirectionalSearch(graph, start, target, kMaxSearchDepth, result, stats) :
+        forwardSearch(graph, start, target, kMaxSearchDepth, result, stats);
+    }
+
+    vector<film> credits;
+    if (!db->getCredits(startingActor, credits) || !db->getCredits(targetActor, credits)) return false;
+    return bidirectional ?
+      bidirectionalSearch(*db, startingActor, targetActor, kMaxSearchDepth, result, stats) :
+      forwardSearch(*db, startingActor, targetActor, kMaxSearchDepth, result, stats);
+  }
+
+  string describeStats() {
+    size_t numRequests, numHits, numMisses, numCached;
+    double p50, p99;
+    latencies.summarize(numRequests, p50, p99);
+    cache.getCounts(numHits, numMisses, numCached);
+    ostringstream oss;
+    oss << fixed << setprecision(3)
+        << "requests " << numRequests << "\tcache-hits " << numHits << "\tcache-misses " << numMisses
+        << "\tcached " << numCached << "\tp50-ms " << p50 << "\tp99-ms " << p99;
+    return oss.str();
+  }
+
+  static bool sendLine(int client, const string& response) {
+    string line = response + '\n';
+    size_t numWritten = 0;
+    while (numWritten < line.size()) {
+      ssize_t count = write(client, line.c_str() + numWritten, line.size() - numWritten);
+      if (count <= 0) return false; // client went away
+      numWritten += count;
+    }
+    return true;
+  }
+
+  searchServer(const searchServer& original) = delete;
+  searchServer& operator=(const searchServer& rhs) = delete;
+};
+
+/**
+ * Function: extractPort
+ * ---------------------
+ * Accepts the specified string, presumably a numeric one,
+ * converts it to an unsigned short, and returns it.
+ * If the numeric string is malformed, or if the unsigned
+ * short is out of range, then kIllegalPort is returned as a sentinel.
+ */
+static unsigned short extractPort(const char *portString) {
+  if (portString == NULL) return kDefaultPort;
+  if (portString[0] == '\0') return kIllegalPort;
+
+  char *end = NULL;
+  long port = strtol(portString, &end, 0);
+  if (end[0] != '\0') return kIllegalPort;
+  if (port < 1024 || port >= USHRT_MAX) return kIllegalPort;
+  return static_cast<unsigned short>(port);
+}
+
+/**
+ * Function: setIdleTimeout
+ * ------------------------
+ * Makes reads from (and writes to) the specified client connection fail once they've
+ * waited the specified number of seconds, so that serveClient gives up on clients that
+ * have gone quiet.  A timeout of 0 leaves the connection to block indefinitely.
+ */
+static void setIdleTimeout(int client, int seconds) {
+  if (seconds == 0) return;
+  struct timeval timeout;
+  timeout.tv_sec = seconds;
+  timeout.tv_usec = 0;
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/**
+ * Function: printUsageAndExit
+ * ---------------------------
+ * Prints the expected command line to standard error and exits.
+ */
+static void printUsageAndExit(const char *progname) {
+  cerr << "Usage: " << progname << " [-b] [-c <cache size>] [-g <snapshot>] [-i <seconds>] [-t <threads>] [<port>]" << endl;
+  cerr << "  -b    answer queries with the bidirectional search" << endl;
+  cerr << "  -c    number of recent answers to cache (default: " << kDefaultCacheSize << ", 0 disables)" << endl;
+  cerr << "  -g    serve the specified imdb-snapshot file instead of the data directory" << endl;
+  cerr << "  -i    close connections idle for this many seconds (default: " << kDefaultIdleTimeout
+       << ", 0 disables)" << endl;
+  cerr << "  -t    number of clients served at once (default: " << kDefaultNumThreads << ")" << endl;
+  cerr << "  The server listens on port " << kDefaultPort << " unless another is given." << endl;
+  exit(kWrongArgumentCount);
+}
+
+int main(int argc, char *argv[]) {
+  bool bidirectional = false;
+  size_t cacheSize = kDefaultCacheSize;
+  size_t numThreads = kDefaultNumThreads;
+  int idleTimeout = kDefaultIdleTimeout;
+  string snapshotFileName = kIMDBDataDirectory + kIMDBGraphFileName;
+  bool snapshotRequested = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "bc:g:i:t:")) != -1) {
+    switch (opt) {
+    case 'b':
+      bidirectional = true;
+      break;
+    case 'c':
+      cacheSize = strtoul(optarg, NULL, 10);
+      break;
+    case 'g':
+      snapshotFileName = optarg;
+      snapshotRequested = true;
+      break;
+    case 'i':
+      idleTimeout = atoi(optarg);
+      if (idleTimeout < 0) printUsageAndExit(argv[0]);
+      break;
+    case 't':
+      if (atoi(optarg) < 1) printUsageAndExit(argv[0]); // checked signed, so -1 doesn't wrap to SIZE_MAX
+      numThreads = atoi(optarg);
+      break;
+    default:
+      printUsageAndExit(argv[0]);
+    }
+  }
+  if (argc - optind > 1) printUsageAndExit(argv[0]);
+
+  unsigned short port = extractPort(argc - optind == 1 ? argv[optind] : NULL);
+  if (port == kIllegalPort) {
+    cerr << "Error: Port must be purely numeric and within range [1024, " << kIllegalPort << ")" << endl;
+    cerr << "Aborting... " << endl;
+    return kWrongArgumentCount;
+  }
+
+  // Prefer the integer-only snapshot whenever there's a current one, exactly as search does
+  imdbGraph graph(snapshotFileName, kIMDBDataDirectory);
+  imdb *db = NULL;
+  if (!graph.good()) {
+    if (snapshotRequested) {
+      cerr << "Snapshot " << snapshotFileName << " is "
+           << (graph.isStale() ? "out of date with the data directory" : "missing or malformed")
+           << "!  Aborting..." << endl;
+      return kDatabaseNotFound;
+    } else if (graph.isStale()) {
+      cerr << "Snapshot " << snapshotFileName << " is out of date with the data directory, so the data "
+           << "files are being served instead.  Rebuild it with imdb-snapshot." << endl;
+    }
+    db = new imdb(kIMDBDataDirectory);
+    if (!db->good()) {
+      cerr << "Data directory not found!  Aborting..." << endl;
+      delete db;
+      return kDatabaseNotFound;
+    }
+  }
+
+  int server = createServerSocket(port);
+  if (server == kServerSocketFailure) {
+    cerr << "Error: Could not start search server to listen to port " << port << "." << endl;
+    cerr << "Aborting... " << endl;
+    delete db;
+    return kServerStartFailure;
+  }
+
+  signal(SIGPIPE, SIG_IGN); // a client hanging up mid-response shouldn't bring the server down
+  cout << "Server listening on port " << port << " (serving "
+       << (graph.good() ? snapshotFileName : kIMDBDataDirectory) << ")." << endl;
+  searchServer service(graph, db, bidirectional, cacheSize);
+  ThreadPool pool(numThreads);
+  while (true) {
+    int client = accept(server, NULL, NULL);
+    if (client == -1) continue;
+    setIdleTimeout(client, idleTimeout);
+    pool.schedule([client, &service] { service.serveClient(client); });
+  }
+
+  return 0;
+}
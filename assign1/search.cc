@@ -1,124 +1,419 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <stdio.h>
-#include <set>
-#include <list>
+#include <unistd.h>
 #include "path.h"
 #include "imdb.h"
 #include "imdb-utils.h"
+#include "imdb-graph.h"
+#include "search-engine.h"
+#include "shortest-paths.h"
+#include "cast-cache.h"
+#include "thread-pool.h"
 using namespace std;
 
 static const int kWrongArgumentCount = 1;
 static const int kDatabaseNotFound = 2;
+static const int kOutputFailure = 3;
 
-// Global variables for Database and Actors
-imdb* database;
-string startingActor;
-string targetActor;
-size_t maxSearchDepth = 7;
+static const size_t kMaxSearchDepth = 7;
+
+static const uint32_t kDistanceMapMagic = 0x50414d44; // "DMAP"
+static const uint32_t kDistanceMapVersion = 1;
 
 /**
- * Method: BFS
- * ---------------------
- * Performs Breadth First Search utilizing the 3 global variables and the supplied 'films' vector. Runs through each film's
- * acting cast to see if any actor is the targetActor. Checks 'visitedFilms' and 'visitedActors' to ensure no repeats.
- * 
- * @param pathQueue - BFS queue for traversal. Only purpose in this function is to append to it.
- * @param visitedFilms - set the contains previously visited films. Checked if visited when attempting insert.
- * @param visitedActors - set the contains previously visited actors. Checked if visited when attempting insert.
- * @param films - film collection to search through for targetActor
- * @param workingPath - path used to create a new starting path with an unvisited actor and add to the pathQueue
- *
- * @return true/false - whether the targetActor was found in the supplied films collection
- */ 
-bool BFS(list<path>& pathQueue, set<film>& visitedFilms, set<string>& visitedActors, vector<film>& films, path workingPath) {
-    // If exceeding search depth of 7, kill program
-    if (workingPath.getLength() >= maxSearchDepth) {
+ * Function: printUsageAndExit
+ * ---------------------------
+ * Prints the expected command line to standard error and exits.
+ */
+static void printUsageAndExit(const char *progname) {
+    cerr << "Usage: " << progname << " [-b] [-t <threads>] [-g <snapshot>] <actor1>" << " <actor2>" << endl;
+    cerr << "       " << progname << " -c <films> <actor1> <actor2>" << endl;
+    cerr << "       " << progname << " -m [-t <threads>] [-g <snapshot>] < pairs" << endl;
+    cerr << "       " << progname << " -d <map file> [-g <snapshot>] <actor>" << endl;
+    cerr << "       " << progname << " -a <count> | -y <count> [-g <snapshot>] <actor1> <actor2>" << endl;
+    cerr << "  -a    print up to <count> of the shortest paths between the two actors, in search order" << endl;
+    cerr << "  -b    search from both actors at once (bidirectional search)" << endl;
+    cerr << "  -c    search the data files, keeping the decoded casts of the <films> largest films" << endl;
+    cerr << "        in memory (" << kDefaultCachedFilms << " is a good choice), and checking each level's" << endl;
+    cerr << "        credits against the target's before decoding any casts" << endl;
+    cerr << "  -d    reach every actor connected to <actor>, write each one's distance and" << endl;
+    cerr << "        parent film to the specified file, and print a histogram of distances" << endl;
+    cerr << "  -g    search the specified imdb-snapshot file instead of the data directory" << endl;
+    cerr << "  -m    answer many queries, one tab-separated actor pair per line of standard input" << endl;
+    cerr << "  -t    number of threads expanding each level of a snapshot search (default: 1), or" << endl;
+    cerr << "        answering queries in -m mode (default: one per core)" << endl;
+    cerr << "  -y    print up to <count> of the shortest paths between the two actors, those through" << endl;
+    cerr << "        the most recent films first" << endl;
+    exit(kWrongArgumentCount);
+}
+
+/**
+ * Function: snapshotProblem
+ * -------------------------
+ * Describes why the specified snapshot can't be used, for error messages.
+ */
+static string snapshotProblem(const imdbGraph& graph) {
+    return graph.isStale() ? "out of date with the data directory" : "missing or malformed";
+}
+
+/**
+ * Function: searchSnapshot
+ * ------------------------
+ * Runs the requested search over the integer IDs of the snapshot, resolving
+ * names only to print the final path.
+ */
+static void searchSnapshot(const imdbGraph& graph, const string& startingActor, const string& targetActor,
+                           bool bidirectional, size_t numThreads) {
+    int start = graph.getActorId(startingActor);
+    int target = graph.getActorId(targetActor);
+    if (start == -1 || target == -1) {
+        cout << "No path between those two people could be found." << endl;
+        return;
+    }
+
+    path result(startingActor);
+    searchStats stats;
+    bool found;
+    if (bidirectional) {
+        found = bidirectionalSearch(graph, start, target, kMaxSearchDepth, result, stats);
+    } else if (numThreads > 1) {
+        found = parallelSearch(graph, start, target, kMaxSearchDepth, numThreads, result, stats);
+    } else {
+        found = forwardSearch(graph, start, target, kMaxSearchDepth, result, stats);
+    }
+
+    if (found) {
+        cout << result << endl;
+    } else {
         cout << "No path between those two people could be found." << endl;
-        return true;
+    }
+}
+
+/**
+ * Function: answerQueries
+ * -----------------------
+ * Answers every query sharing the specified starting actor with one breadth-first search,
+ * then prints one line per query (in input order) while holding the output lock.  Each line
+ * holds the two actors, the number of films separating them (-1 if no path was found),
+ * and the path itself, all separated by tabs.
+ */
+static void answerQueries(const imdbGraph& graph, const string& startingActor, const vector<string>& targetActors,
+                          mutex& outputLock) {
+    int start = graph.getActorId(startingActor);
+    vector<int> targets;
+    vector<size_t> targetQueries; // targetQueries[i] is the query targets[i] came from
+    for (size_t i = 0; i < targetActors.size(); i++) {
+        int target = graph.getActorId(targetActors[i]);
+        if (target == -1) continue;
+        targets.push_back(target);
+        targetQueries.push_back(i);
     }
 
-    for(vector<film>::iterator filmItr = films.begin(); filmItr != films.end(); filmItr++) {
-        pair<set<film>::iterator, bool> filmRet;
+    vector<path> results;
+    vector<bool> found;
+    searchStats stats;
+    if (start != -1) forwardSearch(graph, start, targets, kMaxSearchDepth, results, found, stats);
 
-        filmRet = visitedFilms.insert(*filmItr);
+    vector<string> lines(targetActors.size());
+    for (size_t i = 0; i < targetActors.size(); i++) {
+        lines[i] = startingActor + "\t" + targetActors[i] + "\t-1\tNo path between those two people could be found.";
+    }
+    for (size_t i = 0; i < found.size(); i++) {
+        if (!found[i]) continue;
+        ostringstream oss;
+        oss << startingActor << "\t" << targetActors[targetQueries[i]] << "\t"
+            << results[i].getLength() << "\t" << results[i].toCompactString();
+        lines[targetQueries[i]] = oss.str();
+    }
 
-        if (filmRet.second == false) {
-            continue; // Film has already been visited
+    lock_guard<mutex> lg(outputLock);
+    for (const string& line: lines) cout << line << endl;
+}
+
+/**
+ * Function: runBatch
+ * ------------------
+ * Reads tab-separated actor pairs from standard input, groups them by starting
+ * actor, and spreads the groups across a ThreadPool so that each distinct starting
+ * actor costs exactly one breadth-first search.  Result lines are streamed to
+ * standard output as each group finishes, and a summary line with the overall
+ * throughput is printed to standard error once every query has been answered.
+ */
+static void runBatch(const imdbGraph& graph, size_t numThreads) {
+    vector<string> sources;
+    map<string, vector<string>> groups;
+    size_t numQueries = 0;
+    string line;
+    while (getline(cin, line)) {
+        size_t tab = line.find('\t');
+        if (tab == string::npos) continue;
+        string startingActor = line.substr(0, tab);
+        vector<string>& targets = groups[startingActor];
+        if (targets.empty()) sources.push_back(startingActor);
+        targets.push_back(line.substr(tab + 1));
+        numQueries++;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    mutex outputLock;
+    {
+        ThreadPool pool(numThreads);
+        for (const string& source: sources) {
+            const vector<string>& targets = groups[source];
+            pool.schedule([&graph, &source, &targets, &outputLock]() {
+                answerQueries(graph, source, targets, outputLock);
+            });
         }
+        pool.wait();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-        vector<string> actors;
-        database->getCast(*filmItr, actors);
+    cerr << "Answered " << numQueries << " queries from " << sources.size() << " sources using "
+         << numThreads << " threads in " << seconds << "s ("
+         << (seconds > 0 ? numQueries / seconds : 0) << " queries/sec)" << endl;
+}
 
-        for (vector<string>::iterator actorItr = actors.begin(); actorItr != actors.end(); actorItr++) {
-            pair<set<string>::iterator, bool> actorRet;
+/**
+ * Function: writeDistanceMap
+ * --------------------------
+ * Writes the results of distanceMap to the specified file.  The file begins with
+ * a header of four 32-bit words (magic number, version, starting actor ID, and the
+ * number of actors N in the snapshot), followed by N one-byte distances and then
+ * N 32-bit parent film IDs, both indexed by actor ID.  That's five bytes per actor,
+ * all of it in the snapshot's native byte order.  Returns true if and only if the
+ * file was written in full.
+ */
+static bool writeDistanceMap(const string& fileName, int startingActor, const vector<uint8_t>& distances,
+                             const vector<uint32_t>& parentFilms) {
+    uint32_t header[] = {kDistanceMapMagic, kDistanceMapVersion, (uint32_t) startingActor, (uint32_t) distances.size()};
+    ofstream out(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out) return false;
+    out.write((const char *) header, sizeof(header));
+    out.write((const char *) distances.data(), distances.size() * sizeof(uint8_t));
+    out.write((const char *) parentFilms.data(), parentFilms.size() * sizeof(uint32_t));
+    out.close();
+    return !out.fail();
+}
 
-            actorRet = visitedActors.insert(*actorItr);
-            
-            if (actorRet.second == false) {
-                continue; // Actor has already been visited
-            }
+/**
+ * Function: runDistanceMap
+ * ------------------------
+ * Reaches every actor connected to the specified one, writes the distance map to the
+ * specified file, and prints the number of actors found at each distance.  Returns
+ * the status main should exit with.
+ */
+static int runDistanceMap(const imdbGraph& graph, const string& startingActor, const string& fileName) {
+    int start = graph.getActorId(startingActor);
+    if (start == -1) {
+        cerr << startingActor << " isn't in the snapshot!  Aborting..." << endl;
+        return kDatabaseNotFound;
+    }
 
-            path newPath = workingPath;
-            newPath.addConnection(*filmItr, *actorItr);
+    vector<uint8_t> distances;
+    vector<uint32_t> parentFilms;
+    searchStats stats;
+    size_t numReached = distanceMap(graph, start, distances, parentFilms, stats);
+    if (!writeDistanceMap(fileName, start, distances, parentFilms)) {
+        cerr << "Couldn't write the distance map to " << fileName << "!  Aborting..." << endl;
+        return kOutputFailure;
+    }
 
-            if (targetActor == *actorItr) {
-                cout << newPath << endl;
-                return true;
-            }
+    vector<size_t> histogram;
+    double total = 0;
+    for (uint8_t distance: distances) {
+        if (distance == kUnreachableDistance) continue;
+        if (distance >= histogram.size()) histogram.resize(distance + 1, 0);
+        histogram[distance]++;
+        total += distance;
+    }
 
-            pathQueue.push_back(newPath);
-        }
+    cout << numReached << " of " << distances.size() << " actors are connected to " << startingActor
+         << " (mean distance " << fixed << setprecision(3) << total / numReached << ")." << endl;
+    for (size_t distance = 0; distance < histogram.size(); distance++) {
+        cout << setw(12) << distance << setw(12) << histogram[distance] << endl;
+    }
+    cout << setw(12) << "unreachable" << setw(12) << distances.size() - numReached << endl;
+    return 0;
+}
+
+/**
+ * Function: runAllPaths
+ * ---------------------
+ * Builds the DAG of every shortest path between the two actors, prints how many there
+ * are, and then prints up to limit of them, one compact path per line, either in search
+ * order or most recent films first.  Returns the status main should exit with.
+ */
+static int runAllPaths(const imdbGraph& graph, const string& startingActor, const string& targetActor,
+                       size_t limit, bool byYear) {
+    int start = graph.getActorId(startingActor);
+    int target = graph.getActorId(targetActor);
+    shortestPathDAG dag(graph);
+    searchStats stats;
+    if (start == -1 || target == -1 || !dag.build(start, target, kMaxSearchDepth, stats)) {
+        cout << "No path between those two people could be found." << endl;
+        return 0;
+    }
+
+    uint64_t numPaths = dag.countPaths();
+    cout << (numPaths == UINT64_MAX ? "More than " : "") << numPaths << " shortest path"
+         << (numPaths == 1 ? "" : "s") << " of length " << dag.getLength() << " between "
+         << startingActor << " and " << targetActor << "." << endl;
+    function<bool(const path&)> print = [](const path& p) {
+        cout << p.toCompactString() << endl;
+        return bool(cout);
+    };
+    if (byYear) {
+        dag.enumerateByYear(limit, print);
+    } else {
+        dag.enumerate(limit, print);
     }
-    return false;
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        cerr << "Usage: " << argv[0] << " <actor1>" << " <actor2>" << endl;
-        return kWrongArgumentCount;
+    bool bidirectional = false;
+    string snapshotFileName = kIMDBDataDirectory + kIMDBGraphFileName;
+    bool snapshotRequested = false;
+    bool batch = false;
+    string distanceMapFileName;
+    size_t pathLimit = 0;
+    bool byYear = false;
+    bool useCache = false;
+    size_t numCachedFilms = kDefaultCachedFilms;
+    size_t numThreads = 0; // until -t says otherwise: one per core for -m, and one for a single search
+    int opt;
+    while ((opt = getopt(argc, argv, "a:bc:d:g:mt:y:")) != -1) {
+        switch (opt) {
+        case 'a':
+        case 'y':
+            pathLimit = strtoul(optarg, NULL, 10);
+            byYear = opt == 'y';
+            if (pathLimit == 0) printUsageAndExit(argv[0]);
+            break;
+        case 'b':
+            bidirectional = true;
+            break;
+        case 'c':
+            numCachedFilms = strtoul(optarg, NULL, 10);
+            useCache = true;
+            break;
+        case 'd':
+            distanceMapFileName = optarg;
+            break;
+        case 'g':
+            snapshotFileName = optarg;
+            snapshotRequested = true;
+            break;
+        case 'm':
+            batch = true;
+            break;
+        case 't': {
+            int count = atoi(optarg); // signed, so -t -1 is refused rather than wrapping to SIZE_MAX
+            if (count < 1) printUsageAndExit(argv[0]);
+            numThreads = count;
+            break;
+        }
+        default:
+            printUsageAndExit(argv[0]);
+        }
+    }
+
+    if (batch) {
+        if (argc != optind) printUsageAndExit(argv[0]);
+        imdbGraph graph(snapshotFileName, kIMDBDataDirectory);
+        if (!graph.good()) {
+            cerr << "Batch mode needs a snapshot, but " << snapshotFileName << " is " << snapshotProblem(graph)
+                 << "!  Build a fresh one with imdb-snapshot.  Aborting..." << endl;
+            return kDatabaseNotFound;
+        }
+        runBatch(graph, numThreads == 0 ? max(thread::hardware_concurrency(), 1u) : numThreads);
+        return 0;
+    }
+
+    if (!distanceMapFileName.empty()) {
+        if (argc - optind != 1) printUsageAndExit(argv[0]);
+        imdbGraph graph(snapshotFileName, kIMDBDataDirectory);
+        if (!graph.good()) {
+            cerr << "Distance maps need a snapshot, but " << snapshotFileName << " is " << snapshotProblem(graph)
+                 << "!  Build a fresh one with imdb-snapshot.  Aborting..." << endl;
+            return kDatabaseNotFound;
+        }
+        return runDistanceMap(graph, argv[optind], distanceMapFileName);
+    }
+
+    if (argc - optind != 2) {
+        printUsageAndExit(argv[0]);
+    }
+
+    string startingActor = argv[optind];
+    string targetActor = argv[optind + 1];
+
+    if (pathLimit > 0) {
+        imdbGraph graph(snapshotFileName, kIMDBDataDirectory);
+        if (!graph.good()) {
+            cerr << "Enumerating shortest paths needs a snapshot, but " << snapshotFileName
+                 << " is " << snapshotProblem(graph) << "!  Build a fresh one with imdb-snapshot.  Aborting..." << endl;
+            return kDatabaseNotFound;
+        }
+        return runAllPaths(graph, startingActor, targetActor, pathLimit, byYear);
+    }
+
+    // Prefer the integer-only snapshot whenever there's a current one, unless the data files were asked for
+    if (useCache) {
+        if (bidirectional || snapshotRequested) printUsageAndExit(argv[0]);
+    } else {
+        imdbGraph graph(snapshotFileName, kIMDBDataDirectory);
+        if (graph.good()) {
+            searchSnapshot(graph, startingActor, targetActor, bidirectional, numThreads);
+            return 0;
+        } else if (snapshotRequested) {
+            cerr << "Snapshot " << snapshotFileName << " is " << snapshotProblem(graph) << "!  Aborting..." << endl;
+            return kDatabaseNotFound;
+        } else if (graph.isStale()) {
+            cerr << "Snapshot " << snapshotFileName << " is out of date with the data directory, so the data "
+                 << "files are being searched instead.  Rebuild it with imdb-snapshot." << endl;
+        }
     }
 
     imdb db(kIMDBDataDirectory);
     if (!db.good()) {
-        cerr << "Data directory not found!  Aborting..." << endl; 
+        cerr << "Data directory not found!  Aborting..." << endl;
         return kDatabaseNotFound;
     }
 
-    // Global variables popualted
-    database = &db;
-    startingActor = argv[1];
-    targetActor = argv[2];
-
     vector<film> credits;
     vector<film> targetCredits; // Only used to see if targetActor is in database
 
-    if (!database->getCredits(startingActor, credits) || !database->getCredits(targetActor, targetCredits)) {
+    if (!db.getCredits(startingActor, credits) || !db.getCredits(targetActor, targetCredits)) {
         cout << "No path between those two people could be found." << endl;
         return 0;
     }
 
-    // Variables used for BFS search
-    list<path> pathQueue;
-    set<string> visitedActors;
-    set<film> visitedFilms;
-
-    // Initalize for first pass through
-    visitedActors.insert(startingActor);
-    path initialPath(startingActor);
-    pathQueue.push_back(initialPath);
-
-    while (!pathQueue.empty()) {
-        path workingPath = pathQueue.front();
-        pathQueue.pop_front();
-
-        vector<film> actorFilms;
-        db.getCredits(workingPath.getLastPlayer(), actorFilms);
+    path result(startingActor);
+    searchStats stats;
+    bool found;
+    if (useCache) {
+        castCache cache(db, kIMDBDataDirectory, numCachedFilms);
+        found = forwardSearch(db, cache, startingActor, targetActor, kMaxSearchDepth, result, stats);
+    } else if (bidirectional) {
+        found = bidirectionalSearch(db, startingActor, targetActor, kMaxSearchDepth, result, stats);
+    } else {
+        found = forwardSearch(db, startingActor, targetActor, kMaxSearchDepth, result, stats);
+    }
 
-        if (BFS(pathQueue, visitedFilms, visitedActors, actorFilms, workingPath)) {
-            break;
-        }
+    if (found) {
+        cout << result << endl;
+    } else {
+        cout << "No path between those two people could be found." << endl;
     }
     return 0;
 }
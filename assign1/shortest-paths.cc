@@ -0,0 +1,184 @@
+/**
+ * File: shortest-paths.cc
+ * -----------------------
+ * Presents the implementation of the shortestPathDAG class exported by shortest-paths.h.
+ */
+
+#include "shortest-paths.h"
+#include <algorithm>
+#include <queue>
+#include <utility>
+using namespace std;
+
+shortestPathDAG::shortestPathDAG(const imdbGraph& graph) :
+  graph(graph), startingActor(-1), targetActor(-1), length(0) {}
+
+bool shortestPathDAG::build(int startingActor, int targetActor, size_t maxSearchDepth, searchStats& stats) {
+  this->startingActor = startingActor;
+  this->targetActor = targetActor;
+  length = 0;
+  nodes.clear();
+  if (startingActor == targetActor) return false;
+
+  // Forward pass: label actors with their distance from the starting actor until the target turns up
+  vector<int> depth(graph.getNumActors(), -1);
+  vector<bool> visitedFilms(graph.getNumFilms(), false);
+  vector<int> queue(1, startingActor);
+  depth[startingActor] = 0;
+  for (size_t next = 0; next < queue.size() && depth[targetActor] == -1; next++) {
+    int player = queue[next];
+    if ((size_t) depth[player] >= maxSearchDepth) break;
+    stats.actorsExpanded++;
+
+    for (uint32_t movie: graph.getCredits(player)) {
+      if (visitedFilms[movie]) continue; // Film has already been visited
+      visitedFilms[movie] = true;
+      stats.filmsExpanded++;
+
+      for (uint32_t costar: graph.getCast(movie)) {
+        if (depth[costar] >= 0) continue; // Actor has already been visited
+        depth[costar] = depth[player] + 1;
+        queue.push_back(costar);
+      }
+    }
+  }
+  if (depth[targetActor] == -1) return false;
+  length = depth[targetActor];
+
+  // Backward pass: an actor's parents are its costars exactly one film closer to the starting actor.
+  // Only actors reached this way lie on a shortest path, so nothing else ever enters the DAG.
+  vector<vector<int>> levels(length + 1);
+  levels[length].push_back(targetActor);
+  nodes[targetActor];
+  for (size_t d = length; d > 0; d--) {
+    for (int player: levels[d]) {
+      node& current = nodes[player];
+      stats.actorsExpanded++;
+      for (uint32_t movie: graph.getCredits(player)) {
+        stats.filmsExpanded++;
+        for (uint32_t costar: graph.getCast(movie)) {
+          if ((size_t) depth[costar] + 1 != d) continue;
+          current.parents.push_back(parentEdge{(int) costar, movie});
+          if (nodes.count(costar) > 0) continue;
+          nodes[costar];
+          levels[d - 1].push_back(costar);
+        }
+      }
+    }
+  }
+
+  // Count paths and find the best year totals from the starting actor outward
+  node& root = nodes[startingActor];
+  root.numPaths = 1;
+  root.bestYears = 0;
+  for (size_t d = 1; d <= length; d++) {
+    for (int player: levels[d]) {
+      node& current = nodes[player];
+      current.numPaths = 0;
+      current.bestYears = 0;
+      for (const parentEdge& edge: current.parents) {
+        const node& parent = nodes[edge.parent];
+        uint64_t numPaths = current.numPaths + parent.numPaths;
+        current.numPaths = numPaths < current.numPaths ? UINT64_MAX : numPaths; // saturate
+        current.bestYears = max(current.bestYears, parent.bestYears + graph.getFilmYear(edge.movie));
+      }
+    }
+  }
+  return true;
+}
+
+uint64_t shortestPathDAG::countPaths() const {
+  unordered_map<int, node>::const_iterator found = nodes.find(targetActor);
+  return found == nodes.end() ? 0 : found->second.numPaths;
+}
+
+/**
+ * Method: makePath
+ * ----------------
+ * Builds the path described by the specified actors (running from the target actor
+ * back to the starting actor) and the films connecting each one to the next.
+ */
+path shortestPathDAG::makePath(const vector<int>& actors, const vector<uint32_t>& films) const {
+  path result(graph.getActorName(actors.back()));
+  for (size_t i = films.size(); i > 0; i--) {
+    result.addConnection(graph.getFilm(films[i - 1]), graph.getActorName(actors[i - 1]));
+  }
+  return result;
+}
+
+size_t shortestPathDAG::enumerate(size_t limit, const function<bool(const path&)>& visit) const {
+  if (length == 0) return 0;
+
+  // Depth-first walk from the target back to the starting actor.  choices[i] is the
+  // index of the next parent of actors[i] to try, and films[i] connects actors[i]
+  // to actors[i + 1].
+  vector<int> actors(1, targetActor);
+  vector<uint32_t> films;
+  vector<size_t> choices(1, 0);
+  size_t numGenerated = 0;
+  while (!actors.empty() && numGenerated < limit) {
+    int player = actors.back();
+    const vector<parentEdge>& parents = nodes.find(player)->second.parents;
+    if (player == startingActor || choices.back() == parents.size()) {
+      if (player == startingActor) {
+        numGenerated++;
+        if (!visit(makePath(actors, films))) break;
+      }
+      actors.pop_back();
+      choices.pop_back();
+      if (!films.empty()) films.pop_back();
+      continue;
+    }
+
+    const parentEdge& edge = parents[choices.back()++];
+    actors.push_back(edge.parent);
+    films.push_back(edge.movie);
+    choices.push_back(0);
+  }
+  return numGenerated;
+}
+
+size_t shortestPathDAG::enumerateByYear(size_t limit, const function<bool(const path&)>& visit) const {
+  if (length == 0) return 0;
+
+  // Best-first search from the target back to the starting actor.  Each partial path is
+  // prioritized by the years it has already collected plus the best total its last actor
+  // can still collect, which is exact, so complete paths surface in order.  Equal
+  // priorities go to the most recently pushed partial path, which keeps ties depth-first.
+  struct partial {
+    int player;
+    uint32_t movie; // connects player to the actor of the previous partial path
+    int previous;   // index of the partial path this one extends, or -1
+    int years;
+  };
+  vector<partial> partials(1, partial{targetActor, 0, -1, 0});
+  priority_queue<pair<int, int>> frontier; // (priority, index into partials)
+  frontier.push(make_pair(nodes.find(targetActor)->second.bestYears, 0));
+
+  size_t numGenerated = 0;
+  while (!frontier.empty() && numGenerated < limit) {
+    int index = frontier.top().second;
+    frontier.pop();
+    partial current = partials[index];
+    if (current.player == startingActor) {
+      vector<int> actors;
+      vector<uint32_t> films;
+      for (int i = index; i != -1; i = partials[i].previous) {
+        actors.push_back(partials[i].player);
+        if (partials[i].previous != -1) films.push_back(partials[i].movie);
+      }
+      reverse(actors.begin(), actors.end()); // makePath wants them target first
+      reverse(films.begin(), films.end());
+      numGenerated++;
+      if (!visit(makePath(actors, films))) break;
+      continue;
+    }
+
+    for (const parentEdge& edge: nodes.find(current.player)->second.parents) {
+      int years = current.years + graph.getFilmYear(edge.movie);
+      partials.push_back(partial{edge.parent, edge.movie, index, years});
+      frontier.push(make_pair(years + nodes.find(edge.parent)->second.bestYears, (int) partials.size() - 1));
+    }
+  }
+  return numGenerated;
+}
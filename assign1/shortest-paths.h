@@ -0,0 +1,107 @@
+/**
+ * File: shortest-paths.h
+ * ----------------------
+ * Defines the shortestPathDAG class, which captures every shortest path between
+ * two actors/actresses in a snapshot, rather than just the first one a search
+ * happens upon.  One breadth-first search from the starting actor labels every
+ * actor with its distance, and a second pass, working backward from the target
+ * actor, keeps exactly those actors and films that sit on some shortest path.
+ * Each kept actor records all of its parents: the actors one film closer to the
+ * starting actor, along with the films they share.
+ *
+ * The number of shortest paths can grow exponentially with their length (a pair
+ * of actors connected through prolific hubs can easily be joined by millions),
+ * so the paths are never gathered up all at once.  They're counted, and then
+ * enumerated lazily, one at a time, up to a caller-supplied limit, either in
+ * search order or best-first by the years of their films.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "imdb-graph.h"
+#include "path.h"
+#include "search-engine.h"
+
+class shortestPathDAG {
+ public:
+
+/**
+ * Constructor: shortestPathDAG
+ * ----------------------------
+ * Constructs an empty DAG over the specified snapshot, which must outlive it.
+ */
+  shortestPathDAG(const imdbGraph& graph);
+
+/**
+ * Method: build
+ * -------------
+ * Builds the DAG of every shortest path from startingActor to targetActor, replacing
+ * whatever the DAG held before.  The forward search stops as soon as targetActor is
+ * discovered, since every actor that can precede it on a shortest path is labeled
+ * by then.
+ *
+ * @param maxSearchDepth the maximum number of films the paths may contain.
+ * @param stats updated with the number of actors and films expanded, backward pass included.
+ * @return true if and only if the two actors are connected by a path of at most
+ *         maxSearchDepth films.
+ */
+  bool build(int startingActor, int targetActor, size_t maxSearchDepth, searchStats& stats);
+
+/**
+ * Methods: getLength
+ *          countPaths
+ * -------------------
+ * Return the number of films on every shortest path, and the number of distinct
+ * shortest paths, which saturates at UINT64_MAX rather than overflowing.  Both
+ * are 0 if build failed.
+ */
+  size_t getLength() const { return length; }
+  uint64_t countPaths() const;
+
+/**
+ * Methods: enumerate
+ *          enumerateByYear
+ * ------------------------
+ * Generate up to limit of the shortest paths, one at a time, passing each one to
+ * visit as soon as it's generated.  If visit returns false, generation stops early.
+ * enumerate generates them depth-first, in the order the snapshot lists credits and
+ * casts, while enumerateByYear generates them in decreasing order of the total (and
+ * so the average) release year of their films, so the first few are the paths running
+ * through the most recent films.  Ties go to whichever path is found first.
+ *
+ * enumerate needs memory proportional to the length of a path; enumerateByYear needs
+ * memory proportional to limit times the length of a path times the number of parents
+ * an actor has.  Neither depends on the number of shortest paths.
+ *
+ * @return the number of paths generated.
+ */
+  size_t enumerate(size_t limit, const std::function<bool(const path&)>& visit) const;
+  size_t enumerateByYear(size_t limit, const std::function<bool(const path&)>& visit) const;
+
+ private:
+  struct parentEdge {
+    int parent;
+    uint32_t movie;
+  };
+
+  // Everything the DAG knows about one actor on a shortest path
+  struct node {
+    std::vector<parentEdge> parents;
+    uint64_t numPaths;  // shortest paths from the starting actor to this one
+    int bestYears;      // largest total of release years over those paths
+  };
+
+  const imdbGraph& graph;
+  int startingActor;
+  int targetActor;
+  size_t length;
+  std::unordered_map<int, node> nodes;
+
+  path makePath(const std::vector<int>& actors, const std::vector<uint32_t>& films) const;
+
+  shortestPathDAG(const shortestPathDAG& original) = delete;
+  shortestPathDAG& operator=(const shortestPathDAG& rhs) = delete;
+};
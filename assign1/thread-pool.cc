@@ -0,0 +1,54 @@
+/**
+ * File: thread-pool.cc
+ * --------------------
+ * Presents the implementation of the ThreadPool class.
+ */
+
+#include "thread-pool.h"
+using namespace std;
+
+ThreadPool::ThreadPool(size_t numThreads) : numOutstanding(0), done(false) {
+  for (size_t i = 0; i < numThreads; i++) {
+    workers.push_back(thread([this]() { worker(); }));
+  }
+}
+
+void ThreadPool::worker() {
+  while (true) {
+    function<void(void)> thunk;
+    {
+      unique_lock<mutex> ul(lock);
+      thunkAvailable.wait(ul, [this]() { return done || !thunks.empty(); });
+      if (thunks.empty()) return; // done, and nothing left to run
+      thunk = thunks.front();
+      thunks.pop();
+    }
+
+    thunk();
+
+    lock_guard<mutex> lg(lock);
+    if (--numOutstanding == 0) allFinished.notify_all();
+  }
+}
+
+void ThreadPool::schedule(const function<void(void)>& thunk) {
+  lock_guard<mutex> lg(lock);
+  thunks.push(thunk);
+  numOutstanding++;
+  thunkAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+  unique_lock<mutex> ul(lock);
+  allFinished.wait(ul, [this]() { return numOutstanding == 0; });
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    lock_guard<mutex> lg(lock);
+    done = true;
+  }
+  thunkAvailable.notify_all();
+  for (thread& t: workers) t.join();
+}
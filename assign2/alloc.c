@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "inode.h"
+#include "diskimg.h"
+
+static const int kMaxFree = 100; // Entries in s_free and s_inode
+static const int kINodeCountPerSector = 16;
+
+/**
+ * Returns whether the specified block lies in the data area of the disk, past the
+ * boot block, the superblock and the inodes.
+ */
+static int IsDataBlock(struct unixfilesystem *fs, int blockNum) {
+  return blockNum >= INODE_START_SECTOR + fs->superblock.s_isize && blockNum < fs->superblock.s_fsize;
+}
+
+int alloc_block(struct unixfilesystem *fs) {
+  struct filsys *sb = &fs->superblock;
+  if (sb->s_nfree == 0 || sb->s_nfree > kMaxFree) {
+    return -1;
+  }
+
+  int blockNum = sb->s_free[--sb->s_nfree];
+  if (blockNum == 0) {
+    // The end of the chain: the disk is full
+    sb->s_nfree++;
+    return -1;
+  }
+  if (!IsDataBlock(fs, blockNum)) {
+    fprintf(stderr, "Bad block %d on free list\n", blockNum);
+    return -1;
+  }
+
+  // The last block in s_free holds the next list of free blocks
+  if (sb->s_nfree == 0) {
+    uint16_t list[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
+    if (diskimg_readsector(fs->dfd, blockNum, list) != DISKIMG_SECTOR_SIZE || list[0] > kMaxFree) {
+      sb->s_free[sb->s_nfree++] = blockNum;
+      return -1;
+    }
+    sb->s_nfree = list[0];
+    memcpy(sb->s_free, &list[1], sizeof(sb->s_free));
+  }
+
+  sb->s_fmod = 1;
+  return blockNum;
+}
+
+int alloc_freeblock(struct unixfilesystem *fs, int blockNum) {
+  struct filsys *sb = &fs->superblock;
+  if (!IsDataBlock(fs, blockNum)) {
+    return -1;
+  }
+
+  if (sb->s_nfree == 0) {
+    // Start a new chain, ended by block 0
+    sb->s_nfree = 1;
+    sb->s_free[0] = 0;
+  }
+
+  // A full s_free moves into the block being freed, which then heads the chain
+  if (sb->s_nfree >= kMaxFree) {
+    uint16_t list[DISKIMG_SECTOR_SIZE / sizeof(uint16_t)];
+    memset(list, 0, sizeof(list));
+    list[0] = sb->s_nfree;
+    memcpy(&list[1], sb->s_free, sizeof(sb->s_free));
+    if (diskimg_writesector(fs->dfd, blockNum, list) != DISKIMG_SECTOR_SIZE) {
+      return -1;
+    }
+    sb->s_nfree = 0;
+  }
+
+  sb->s_free[sb->s_nfree++] = blockNum;
+  sb->s_fmod = 1;
+  return 0;
+}
+
+/**
+ * Refills s_inode with up to kMaxFree free inodes, found by scanning the inode area
+ * from the start.  Returns the number found.
+ */
+static int ScanFreeInodes(struct unixfilesystem *fs) {
+  struct filsys *sb = &fs->superblock;
+  int numInodes = sb->s_isize * kINodeCountPerSector;
+  for (int first = 1; first <= numInodes && sb->s_ninode < kMaxFree; first += kINodeCountPerSector) {
+    char buffer[DISKIMG_SECTOR_SIZE];
+    const struct inode *inodes = diskimg_getsector(fs->dfd, INODE_START_SECTOR + (first - 1) / kINodeCountPerSector,
+                                                   buffer);
+    if (inodes == NULL) break;
+    for (int i = 0; i < kINodeCountPerSector && sb->s_ninode < kMaxFree; i++) {
+      if (inodes[i].i_mode == 0) sb->s_inode[sb->s_ninode++] = first + i;
+    }
+  }
+  return sb->s_ninode;
+}
+
+int alloc_inode(struct unixfilesystem *fs) {
+  struct filsys *sb = &fs->superblock;
+  if (sb->s_ninode > kMaxFree) {
+    sb->s_ninode = 0;
+  }
+
+  while (sb->s_ninode > 0 || ScanFreeInodes(fs) > 0) {
+    int inumber = sb->s_inode[--sb->s_ninode];
+    sb->s_fmod = 1;
+
+    // The cached list may be out of date, so check the inode really is free
+    struct inode in;
+    if (inumber >= ROOT_INUMBER && inumber <= sb->s_isize * kINodeCountPerSector &&
+        inode_iget(fs, inumber, &in) == 0 && in.i_mode == 0) {
+      return inumber;
+    }
+  }
+
+  fprintf(stderr, "Out of inodes\n");
+  return -1;
+}
+
+void alloc_freeinode(struct unixfilesystem *fs, int inumber) {
+  struct filsys *sb = &fs->superblock;
+
+  // With s_inode full, the inode is found by the next scan instead
+  if (sb->s_ninode >= kMaxFree) {
+    return;
+  }
+  sb->s_inode[sb->s_ninode++] = inumber;
+  sb->s_fmod = 1;
+}
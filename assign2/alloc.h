@@ -0,0 +1,44 @@
+#ifndef _ALLOC_H_
+#define _ALLOC_H_
+
+#include "unixfilesystem.h"
+
+/**
+ * Allocation of disk blocks and inodes, the way alloc.c in Unix Version 6 did it.
+ *
+ * Free blocks are kept in the superblock's s_free array, s_nfree of them.  When it
+ * fills up, its contents (a count followed by 100 block numbers) are written into
+ * the next block freed, which becomes the head of a chain of such lists, ending in
+ * a block number of 0.  Free inodes are cached in s_inode, s_ninode of them, and
+ * the inode area is scanned for more whenever it runs out.
+ *
+ * These functions change the in-memory superblock, which unixfilesystem_sync
+ * writes back.  Like everything else that writes to a filesystem, they mustn't
+ * run at the same time as any other call on it.
+ */
+
+/**
+ * Takes a block off the free list and returns its number, or -1 if the disk is
+ * full or the free list is damaged.  The block's contents are whatever it last
+ * held, so the caller is expected to write all of it.
+ */
+int alloc_block(struct unixfilesystem *fs);
+
+/**
+ * Puts the specified block back on the free list.  Returns 0 on success, or -1 if
+ * it doesn't lie in the data area of the disk or the free list can't be written.
+ */
+int alloc_freeblock(struct unixfilesystem *fs, int blockNum);
+
+/**
+ * Finds an unallocated inode and returns its number, or -1 if there are none
+ * left.  The inode itself is untouched until the caller writes it with inode_iput.
+ */
+int alloc_inode(struct unixfilesystem *fs);
+
+/**
+ * Remembers the specified inode, which the caller has cleared, as free.
+ */
+void alloc_freeinode(struct unixfilesystem *fs, int inumber);
+
+#endif // _ALLOC_H_
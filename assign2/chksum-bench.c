@@ -0,0 +1,245 @@
+/**
+ * Measures how fast the largest file on each of the specified disk images can be
+ * checksummed, once block by block through file_getblock (the way chksumfile used
+ * to read files) and once through a file_open handle (the way it reads them now).
+ * Then measures how fast every file on the disk can be checksummed, once one file
+ * at a time and once with chksumfile_byinumbers, which hashes small files together.
+ *
+ * The output is meant for scripts: a header line, then one tab-separated line per
+ * disk image and method, with these columns:
+ *
+ *     disk      the disk image's path
+ *     inumber   the largest file's inumber, and its size in bytes (for the dump
+ *     size      methods, the number of files on the disk, and their total size)
+ *     method    getblock or read, or dump-single or dump-multi
+ *     rounds    number of times the file was checksummed
+ *     seconds   total wall time spent checksumming it
+ *     MBps      megabytes (2^20 bytes) checksummed per second
+ *     sectors   sectors read from the disk image per round (sector cache misses)
+ *     reads     system calls issued for those sectors per round
+ *     checksum  the file's checksum (for the dump methods, the SHA-1 of all the files'
+ *               checksums), which the methods in each pair must agree on
+ *
+ * Checksums are SHA-1s unless -a names another hash.
+ * Each method starts every round with an empty sector cache, so rounds are
+ * comparable.  Images opened with -m are served from memory, so they report no
+ * sectors or reads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "inode.h"
+#include "file.h"
+#include "chksumfile.h"
+#include "hash.h"
+
+static const int kDefaultNumRounds = 5;
+
+int numRounds = 0;
+int cacheSectors = DISKIMG_DEFAULT_CACHE_SECTORS;
+int mapFlag = 0;
+const struct hashalg *hashalg = &hash_sha1;
+
+static void PrintUsageAndExit(char *progname);
+
+/**
+ * Every allocated inode on the disk being measured, and the total size of their files.
+ */
+static int *allInumbers = NULL;
+static int numAllInumbers = 0;
+static int totalSize = 0;
+
+static void FindAllFiles(struct unixfilesystem *fs) {
+  free(allInumbers);
+  allInumbers = malloc(fs->superblock.s_isize*16 * sizeof(int));
+  numAllInumbers = 0;
+  totalSize = 0;
+  for (int inumber = 1; inumber < fs->superblock.s_isize*16 && allInumbers != NULL; inumber++) {
+    struct inode in;
+    if (inode_iget(fs, inumber, &in) < 0) break;
+    if (!(in.i_mode & IALLOC)) continue;
+    allInumbers[numAllInumbers++] = inumber;
+    totalSize += inode_getsize(&in);
+  }
+}
+
+/**
+ * Checksums every allocated inode one at a time, and combines the checksums into one.
+ */
+static int DumpSingle(struct unixfilesystem *fs, int inumber, void *chksum) {
+  struct hashctx ctx;
+  hash_init(&ctx, &hash_sha1);
+  for (int i = 0; i < numAllInumbers; i++) {
+    char fileChksum[CHKSUMFILE_SIZE];
+    int chksumSize = chksumfile_byinumber(fs, allInumbers[i], fileChksum);
+    if (chksumSize < 0 || hash_update(&ctx, fileChksum, chksumSize) < 0) return -1;
+  }
+  return hash_final(&ctx, chksum);
+}
+
+/**
+ * Checksums every allocated inode with one chksumfile_byinumbers call, and combines the
+ * checksums into one.
+ */
+static int DumpMulti(struct unixfilesystem *fs, int inumber, void *chksum) {
+  char (*fileChksums)[CHKSUMFILE_SIZE] = malloc(numAllInumbers * CHKSUMFILE_SIZE);
+  int *results = malloc(numAllInumbers * sizeof(int));
+  int err = fileChksums == NULL || results == NULL ? -1 : 0;
+  if (err == 0) chksumfile_byinumbers(fs, allInumbers, numAllInumbers, fileChksums, results);
+
+  struct hashctx ctx;
+  hash_init(&ctx, &hash_sha1);
+  for (int i = 0; i < numAllInumbers && err == 0; i++) {
+    if (results[i] < 0 || hash_update(&ctx, fileChksums[i], results[i]) < 0) err = -1;
+  }
+  free(fileChksums);
+  free(results);
+  if (err < 0) return -1;
+  return hash_final(&ctx, chksum);
+}
+
+/**
+ * Returns the inumber of the largest allocated plain file on the disk, or -1 if
+ * there are none.
+ */
+static int FindLargestFile(struct unixfilesystem *fs) {
+  int largest = -1;
+  int largestSize = -1;
+  for (int inumber = 1; inumber < fs->superblock.s_isize*16; inumber++) {
+    struct inode in;
+    if (inode_iget(fs, inumber, &in) < 0) break;
+    if (!(in.i_mode & IALLOC) || (in.i_mode & IFMT) != 0) continue;
+    if (inode_getsize(&in) > largestSize) {
+      largest = inumber;
+      largestSize = inode_getsize(&in);
+    }
+  }
+  return largest;
+}
+
+/**
+ * Checksums the specified file one file_getblock call at a time.
+ */
+static int ChecksumByBlock(struct unixfilesystem *fs, int inumber, void *chksum) {
+  struct hashctx ctx;
+  hash_init(&ctx, hashalg);
+
+  struct inode in;
+  if (inode_iget(fs, inumber, &in) < 0) return -1;
+  int size = inode_getsize(&in);
+  for (int offset = 0; offset < size; offset += DISKIMG_SECTOR_SIZE) {
+    char buf[DISKIMG_SECTOR_SIZE];
+    int bytesMoved = file_getblock(fs, inumber, offset/DISKIMG_SECTOR_SIZE, buf);
+    if (bytesMoved < 0 || hash_update(&ctx, buf, bytesMoved) < 0) return -1;
+  }
+  return hash_final(&ctx, chksum);
+}
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void RunMethod(struct unixfilesystem *fs, const char *diskpath, int inumber, int size, const char *method,
+                      int (*checksum)(struct unixfilesystem *, int, void *)) {
+  struct diskimg_cachestats before, after;
+  diskimg_getcachestats(&before);
+  char chksum[CHKSUMFILE_SIZE];
+  double seconds = 0;
+  for (int round = 0; round < numRounds; round++) {
+    diskimg_setcachesize(cacheSectors);
+    double start = Now();
+    if (checksum(fs, inumber, chksum) < 0) {
+      fprintf(stderr, "Can't checksum inode %d on %s\n", inumber, diskpath);
+      return;
+    }
+    seconds += Now() - start;
+  }
+  diskimg_getcachestats(&after);
+
+  char chksumstring[CHKSUMFILE_STRINGSIZE];
+  chksumfile_cvt2string(chksum, chksumstring);
+  printf("%s\t%d\t%d\t%s\t%d\t%.6f\t%.1f\t%llu\t%llu\t%s\n", diskpath, inumber, size, method, numRounds,
+         seconds, seconds > 0 ? (double) size * numRounds / (1 << 20) / seconds : 0.0,
+         (unsigned long long) (after.misses - before.misses) / numRounds,
+         (unsigned long long) (after.reads - before.reads) / numRounds, chksumstring);
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "a:c:mr:")) != -1) {
+    switch (opt) {
+    case 'a':
+      hashalg = hash_find(optarg);
+      if (hashalg == NULL || chksumfile_setalgorithm(optarg) < 0) {
+        fprintf(stderr, "Unknown hash %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'c':
+      cacheSectors = atoi(optarg);
+      break;
+    case 'm':
+      mapFlag = 1;
+      break;
+    case 'r':
+      numRounds = atoi(optarg);
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind == argc || cacheSectors < 0 || numRounds < 0) {
+    PrintUsageAndExit(argv[0]);
+  }
+  if (numRounds == 0) numRounds = kDefaultNumRounds;
+
+  printf("disk\tinumber\tsize\tmethod\trounds\tseconds\tMBps\tsectors\treads\tchecksum\n");
+  for (int i = optind; i < argc; i++) {
+    char *diskpath = argv[i];
+    int fd = mapFlag ? diskimg_openmapped(diskpath) : diskimg_open(diskpath, 1);
+    if (fd < 0) {
+      fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+      continue;
+    }
+    struct unixfilesystem *fs = unixfilesystem_init(fd);
+    if (fs == NULL) {
+      fprintf(stderr, "Failed to initialize unix filesystem on %s\n", diskpath);
+      (void) diskimg_close(fd);
+      continue;
+    }
+
+    int inumber = FindLargestFile(fs);
+    if (inumber < 0) {
+      fprintf(stderr, "No files on %s\n", diskpath);
+    } else {
+      struct inode in;
+      inode_iget(fs, inumber, &in);
+      RunMethod(fs, diskpath, inumber, inode_getsize(&in), "getblock", ChecksumByBlock);
+      RunMethod(fs, diskpath, inumber, inode_getsize(&in), "read", chksumfile_byinumber);
+    }
+    FindAllFiles(fs);
+    RunMethod(fs, diskpath, numAllInumbers, totalSize, "dump-single", DumpSingle);
+    RunMethod(fs, diskpath, numAllInumbers, totalSize, "dump-multi", DumpMulti);
+    (void) diskimg_close(fd);
+    unixfilesystem_free(fs);
+  }
+  return 0;
+}
+
+static void PrintUsageAndExit(char *progname) {
+  fprintf(stderr, "Usage: %s <options> diskimagePath...\n", progname);
+  fprintf(stderr, "where <options> can be:\n");
+  fprintf(stderr, "-a H   checksum with hash H: sha1 (the default) or crc32c\n");
+  fprintf(stderr, "-r N   checksum each file N times (default %d)\n", kDefaultNumRounds);
+  fprintf(stderr, "-c N   cache up to N recently read sectors (default %d, 0 disables)\n",
+          DISKIMG_DEFAULT_CACHE_SECTORS);
+  fprintf(stderr, "-m     map each disk image into memory instead of reading it sector by sector\n");
+  exit(EXIT_FAILURE);
+}
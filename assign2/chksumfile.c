@@ -11,43 +11,195 @@
 #include "directory.h"
 #include "pathname.h"
 #include "chksumfile.h"
-#include <openssl/sha.h>
+#include "hash.h"
+
+static const struct hashalg *algorithm = &hash_sha1;
+
+int chksumfile_setalgorithm(const char *name) {
+  const struct hashalg *alg = hash_find(name);
+  if (alg == NULL) return -1;
+  algorithm = alg;
+  return 0;
+}
 
 int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum) {
-  SHA_CTX shactx;
-  if (!SHA1_Init(&shactx)) {
-    // An error occurred initializing the SHA1 context.
+  struct hashctx ctx;
+  hash_init(&ctx, algorithm);
+
+  // Fails if the inode can't be read or isn't allocated, since we can't hash it then.
+  struct filehandle *file = file_open(fs, inumber);
+  if (file == NULL) {
     return -1;
   }
 
-  struct inode in;
-  int err = inode_iget(fs, inumber, &in);
-  if (err < 0) {
-    return err;
+  // Read in chunks of whole blocks, so each chunk is read straight into buf
+  char buf[FILE_READAHEAD_BLOCKS * DISKIMG_SECTOR_SIZE];
+  int bytesMoved;
+  while ((bytesMoved = file_read(file, buf, sizeof(buf))) > 0) {
+    if (hash_update(&ctx, buf, bytesMoved) < 0) {
+      file_close(file);
+      return -1;
+    }
   }
-
-  if (!(in.i_mode & IALLOC)) {
-    // The inode isn't allocated, so we can't hash it.
+  file_close(file);
+  if (bytesMoved < 0)
     return -1;
-  }
 
-  int size = inode_getsize(&in);
-  for (int offset = 0; offset < size; offset += DISKIMG_SECTOR_SIZE) {
-    char buf[DISKIMG_SECTOR_SIZE];
-    int bno = offset/DISKIMG_SECTOR_SIZE;
+  return hash_final(&ctx, chksum);
+}
 
-    int bytesMoved = file_getblock(fs, inumber, bno, buf);
-    if (bytesMoved < 0)
-      return -1;
+// Larger files are hashed on their own, so that none keeps its lane busy long after the rest are done
+static const int kMaxLaneFileSize = 256 * 1024;
 
-    if (!SHA1_Update(&shactx, buf, bytesMoved))
-      return -1;
+#define LANE_BUFFER_SIZE (FILE_READAHEAD_BLOCKS * DISKIMG_SECTOR_SIZE)
+
+/**
+ * One file being hashed in a lane of a struct hashlanes.
+ */
+struct lane {
+  int index;               // into the inumbers being hashed, or -1 if the lane is idle
+  struct filehandle *file;
+  uint64_t length;         // bytes read from the file so far
+  int start;               // the unhashed bytes of buf
+  int end;
+  int numPadBlocks;        // blocks in pad, or 0 until the file's been read
+  int padBlock;            // next block of pad to hash
+  unsigned char pad[128];
+  unsigned char buf[64 + LANE_BUFFER_SIZE]; // reads land after the first 64 bytes
+};
+
+/**
+ * Returns the next 64-byte block to hash in the specified lane, reading more of
+ * the file or moving on to its padding as needed, or NULL on error.
+ */
+static const unsigned char *NextBlock(struct lane *lane) {
+  if (lane->numPadBlocks > 0) return lane->pad + 64 * lane->padBlock;
+  if (lane->end - lane->start >= 64) return lane->buf + lane->start;
+
+  // Only the last read of a file leaves a partial block, and it's moved in front of
+  // where the next read lands, so every read is of whole file blocks
+  int tailLen = lane->end - lane->start;
+  memmove(lane->buf + 64 - tailLen, lane->buf + lane->start, tailLen);
+  lane->start = 64 - tailLen;
+  int bytesMoved = file_read(lane->file, lane->buf + 64, LANE_BUFFER_SIZE);
+  if (bytesMoved < 0) return NULL;
+  lane->end = 64 + bytesMoved;
+  lane->length += bytesMoved;
+  if (lane->end - lane->start >= 64) return lane->buf + lane->start;
+
+  lane->numPadBlocks = hash_lanes_pad(lane->buf + lane->start, lane->end - lane->start, lane->length, lane->pad);
+  lane->padBlock = 0;
+  return lane->pad;
+}
+
+static void StopLane(struct lane *lane) {
+  file_close(lane->file);
+  lane->file = NULL;
+  lane->index = -1;
+}
+
+struct pendingfile {
+  int index;
+  int size;
+};
+
+static int CompareSizesDescending(const void *lhs, const void *rhs) {
+  const struct pendingfile *a = lhs, *b = rhs;
+  return a->size != b->size ? (a->size < b->size ? 1 : -1) : a->index - b->index;
+}
+
+void chksumfile_byinumbers(struct unixfilesystem *fs, const int *inumbers, int count, void *chksums, int *results) {
+  unsigned char *out = chksums;
+  struct pendingfile *pending = malloc(count * sizeof(struct pendingfile));
+  int numPending = 0;
+  for (int i = 0; i < count; i++) {
+    struct inode in;
+    if (pending != NULL && algorithm->multiBuffer && inode_iget(fs, inumbers[i], &in) == 0 &&
+        (in.i_mode & IALLOC) && inode_getsize(&in) <= kMaxLaneFileSize) {
+      pending[numPending].index = i;
+      pending[numPending].size = inode_getsize(&in);
+      numPending++;
+    } else {
+      results[i] = chksumfile_byinumber(fs, inumbers[i], out + i * CHKSUMFILE_SIZE);
+    }
   }
 
-  if (!SHA1_Final(chksum, &shactx))
-    return -1;
+  // A lane on its own is far slower than hashing a file alone, so only files with enough
+  // companions to keep every lane busy go through the lanes.  Taking the files largest
+  // first, which also makes the lanes run dry at about the same time, each one needs
+  // HASH_LANES - 1 smaller files at least half its size.  Larger files without them, and
+  // any batch of fewer than HASH_LANES files, are hashed alone.
+  qsort(pending, numPending, sizeof(struct pendingfile), CompareSizesDescending);
+  int firstLaneFile = 0;
+  while (firstLaneFile < numPending &&
+         (firstLaneFile + HASH_LANES > numPending ||
+          pending[firstLaneFile + HASH_LANES - 1].size < pending[firstLaneFile].size / 2)) {
+    int index = pending[firstLaneFile++].index;
+    results[index] = chksumfile_byinumber(fs, inumbers[index], out + index * CHKSUMFILE_SIZE);
+  }
+  struct lane *lanes = firstLaneFile < numPending ? malloc(HASH_LANES * sizeof(struct lane)) : NULL;
+  if (lanes == NULL) {
+    for (int p = firstLaneFile; p < numPending; p++) {
+      int index = pending[p].index;
+      results[index] = chksumfile_byinumber(fs, inumbers[index], out + index * CHKSUMFILE_SIZE);
+    }
+    firstLaneFile = numPending;
+  }
 
-  return SHA_DIGEST_LENGTH;
+  struct hashlanes state;
+  for (int l = 0; l < HASH_LANES && lanes != NULL; l++) lanes[l].index = -1;
+  int nextPending = firstLaneFile;
+  while (1) {
+    for (int l = 0; l < HASH_LANES && nextPending < numPending; l++) {
+      struct lane *lane = &lanes[l];
+      while (lane->index == -1 && nextPending < numPending) {
+        int index = pending[nextPending++].index;
+        lane->file = file_open(fs, inumbers[index]);
+        if (lane->file == NULL) {
+          results[index] = -1;
+          continue;
+        }
+        lane->index = index;
+        lane->length = 0;
+        lane->start = lane->end = 64;
+        lane->numPadBlocks = 0;
+        hash_lanes_init(&state, l);
+      }
+    }
+
+    const unsigned char *blocks[HASH_LANES];
+    int numBusy = 0;
+    for (int l = 0; l < HASH_LANES; l++) {
+      blocks[l] = NULL;
+      if (lanes == NULL || lanes[l].index == -1) continue;
+      blocks[l] = NextBlock(&lanes[l]);
+      if (blocks[l] == NULL) {
+        results[lanes[l].index] = -1;
+        StopLane(&lanes[l]);
+      } else {
+        numBusy++;
+      }
+    }
+    if (numBusy == 0) {
+      if (nextPending == numPending) break;
+      continue;
+    }
+
+    hash_lanes_compress(&state, blocks);
+    for (int l = 0; l < HASH_LANES; l++) {
+      struct lane *lane = &lanes[l];
+      if (blocks[l] == NULL) continue;
+      if (lane->numPadBlocks == 0) {
+        lane->start += 64;
+      } else if (++lane->padBlock == lane->numPadBlocks) {
+        hash_lanes_digest(&state, l, out + lane->index * CHKSUMFILE_SIZE);
+        results[lane->index] = algorithm->digestSize;
+        StopLane(lane);
+      }
+    }
+  }
+  free(pending);
+  free(lanes);
 }
 
 int chksumfile_bypathname(struct unixfilesystem *fs, const char *pathname, void *chksum) {
@@ -62,7 +214,7 @@ int chksumfile_bypathname(struct unixfilesystem *fs, const char *pathname, void
 void chksumfile_cvt2string(void *chksum, char *outstring) {
   uint8_t *c = (uint8_t *) chksum;
 
-  for (int i = 0; i < SHA_DIGEST_LENGTH; i++) {
+  for (int i = 0; i < algorithm->digestSize; i++) {
     sprintf(outstring + 2 * i, "%02x", c[i]);
   }
 }
@@ -71,7 +223,7 @@ int chksumfile_compare(void *chksum1, void *chksum2) {
   uint8_t *c1 = (uint8_t *) chksum1;
   uint8_t *c2 = (uint8_t *) chksum2;
 
-  for (int i = 0; i < SHA_DIGEST_LENGTH; i++) {
+  for (int i = 0; i < algorithm->digestSize; i++) {
     if (c1[i] != c2[i]) return 0;
   }
   return 1;
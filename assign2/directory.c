@@ -3,15 +3,285 @@
 #include "diskimg.h"
 #include "file.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+static const int kMinIndexedEntries = 64; // Smaller directories (under four blocks) are just scanned
+
+/**
+ * Returns whether the specified entry is in use and named name.  Names fill all 14
+ * bytes of d_name when they're that long, so there may be no terminating null.
+ */
+static int NameMatches(const struct direntv6 *entry, const char *name) {
+  return entry->d_inumber != 0 && strncmp(entry->d_name, name, sizeof(entry->d_name)) == 0;
+}
+
+/**
+ * FNV-1a hash of the specified name, stopping at its null or its 14th byte.
+ */
+static unsigned int NameHash(const char *name) {
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < sizeof(((struct direntv6 *) 0)->d_name) && name[i] != '\0'; i++) {
+    hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static struct dentry *DentrySlot(struct unixfilesystem *fs, int dirinumber, const char *name) {
+  unsigned int hash = NameHash(name) ^ (unsigned int) dirinumber * 2654435761u;
+  return &fs->dentries[hash & (DENTRY_CACHE_SIZE - 1)];
+}
+
+/**
+ * Searches the specified directory a block at a time, returning 0 and filling in
+ * dirEnt if an entry named name turns up, and -1 otherwise.
+ */
+static int ScanDirectory(struct unixfilesystem *fs, struct inode *node, const char *name, struct direntv6 *dirEnt) {
+  int inodeSize = inode_getsize(node);
+  int currentBlock = 0;
+  int bytesRead = 0; // Keep track of bytes read in
+
+  uint16_t blockNumber = inode_indexlookup(fs, node, currentBlock); // Get first block
+  char buffer[DISKIMG_SECTOR_SIZE]; // only used when the disk image isn't mapped
+  const struct direntv6* tempDirEnt = diskimg_getsector(fs->dfd, blockNumber, buffer);
+  if (tempDirEnt == NULL) {
+    return -1;
+  }
+
+  while (bytesRead < inodeSize) {
+
+    // Need to advance to iNode's next block
+    if (bytesRead != 0 && bytesRead % 512 == 0) {
+      currentBlock++;
+      blockNumber = inode_indexlookup(fs, node, currentBlock);
+      tempDirEnt = diskimg_getsector(fs->dfd, blockNumber, buffer); // Point to first dirent in new block
+      if (tempDirEnt == NULL) {
+        return -1;
+      }
+    }
+
+    if (NameMatches(tempDirEnt, name)) {
+      *dirEnt = *tempDirEnt;
+      return 0;
+    }
+
+    tempDirEnt++; // move to next dirent in block
+    bytesRead += sizeof(struct direntv6);
+  }
+
+  return -1; // Exceeded iNode's block data
+}
+
+/**
+ * Returns the bucket of the specified index that holds the entry named name, or -1
+ * if there's no such entry.
+ */
+static int IndexFind(const struct dirindex *index, const char *name) {
+  int bucket = NameHash(name) & (index->numBuckets - 1);
+  for (; index->buckets[bucket] != -1; bucket = (bucket + 1) & (index->numBuckets - 1)) {
+    if (NameMatches(&index->entries[index->buckets[bucket]], name)) return bucket;
+  }
+  return -1;
+}
+
+/**
+ * Hashes entry i of the specified index by its name.  Where the name is already
+ * hashed, whichever entry comes first in the directory wins.
+ */
+static void IndexInsert(struct dirindex *index, int i) {
+  const char *name = index->entries[i].d_name;
+  int bucket = NameHash(name) & (index->numBuckets - 1);
+  while (index->buckets[bucket] != -1 &&
+         strncmp(index->entries[index->buckets[bucket]].d_name, name, sizeof(index->entries[i].d_name)) != 0) {
+    bucket = (bucket + 1) & (index->numBuckets - 1);
+  }
+  if (index->buckets[bucket] == -1) {
+    index->buckets[bucket] = i;
+  } else {
+    index->duplicates = 1;
+    if (i < index->buckets[bucket]) index->buckets[bucket] = i;
+  }
+}
+
+/**
+ * Empties the specified bucket, moving later entries of its run back into the gap
+ * so that every entry can still be reached from the bucket its name hashes to.
+ */
+static void IndexDelete(struct dirindex *index, int bucket) {
+  int mask = index->numBuckets - 1;
+  int hole = bucket;
+  for (int next = (hole + 1) & mask; index->buckets[next] != -1; next = (next + 1) & mask) {
+    int home = NameHash(index->entries[index->buckets[next]].d_name) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      index->buckets[hole] = index->buckets[next];
+      hole = next;
+    }
+  }
+  index->buckets[hole] = -1;
+}
+
+/**
+ * Rehashes every entry of the specified index into a fresh table of at least twice
+ * as many buckets as entries.  Returns 0 on success and -1 if there's no memory,
+ * leaving the index as it was.
+ */
+static int IndexRehash(struct dirindex *index) {
+  int numBuckets = 1;
+  while (numBuckets < 2 * index->numEntries) numBuckets *= 2;
+  int *buckets = malloc(numBuckets * sizeof(int));
+  if (buckets == NULL) return -1;
+  free(index->buckets);
+  index->buckets = buckets;
+  index->numBuckets = numBuckets;
+  index->duplicates = 0;
+  for (int i = 0; i < numBuckets; i++) buckets[i] = -1;
+  for (int i = 0; i < index->numEntries; i++) {
+    if (index->entries[i].d_inumber != 0) IndexInsert(index, i); // skipping free slots
+  }
+  return 0;
+}
+
+/**
+ * Reads every entry of the specified directory into index and hashes them by name.
+ * Where a name appears more than once, the first entry wins, just as it does for a
+ * scan.  Runs of physically consecutive blocks are read with a single call.  Returns
+ * 0 on success and -1 on error.
+ */
+static int BuildDirIndex(struct unixfilesystem *fs, int dirinumber, struct inode *node, struct dirindex *index) {
+  int numEntries = inode_getsize(node) / sizeof(struct direntv6);
+  int numBlocks = (inode_getsize(node) + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+  struct direntv6 *entries = malloc((size_t) numBlocks * DISKIMG_SECTOR_SIZE);
+  if (entries == NULL) {
+    return -1;
+  }
+
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  for (int bno = 0; bno < numBlocks; ) {
+    int first = inode_indexlookup(fs, node, bno);
+    int count = 1;
+    while (first >= 0 && bno + count < numBlocks && inode_indexlookup(fs, node, bno + count) == first + count) count++;
+    if (first < 0 || diskimg_readsectors(fs->dfd, first, count, entries + bno * kEntriesPerBlock) !=
+        count * DISKIMG_SECTOR_SIZE) {
+      free(entries);
+      return -1;
+    }
+    bno += count;
+  }
+
+  index->entries = entries;
+  index->numEntries = numEntries;
+  index->capacity = numBlocks * kEntriesPerBlock;
+  index->buckets = NULL;
+  if (IndexRehash(index) < 0) {
+    free(entries);
+    return -1;
+  }
+  index->freeHint = 0;
+  while (index->freeHint < numEntries && entries[index->freeHint].d_inumber != 0) index->freeHint++;
+
+  index->inumber = dirinumber;
+  index->i_mode = node->i_mode;
+  index->i_size0 = node->i_size0;
+  index->i_size1 = node->i_size1;
+  memcpy(index->i_addr, node->i_addr, sizeof(index->i_addr));
+  return 0;
+}
+
+/**
+ * Returns the slot holding the index of the specified directory, or NULL if it
+ * isn't cached.  Called with the filesystem's lock held.
+ */
+static struct dirindex *FindDirIndex(struct unixfilesystem *fs, int dirinumber, struct inode *node) {
+  for (int i = 0; i < DIRINDEX_CACHE_SLOTS; i++) {
+    struct dirindex *index = &fs->dirindexes[i];
+    if (index->entries != NULL && index->inumber == dirinumber && index->i_mode == node->i_mode &&
+        index->i_size0 == node->i_size0 && index->i_size1 == node->i_size1 &&
+        memcmp(index->i_addr, node->i_addr, sizeof(index->i_addr)) == 0) {
+      index->lastUse = ++fs->dirindexClock;
+      return index;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Caches the specified freshly built index in place of the least recently used one.
+ * Called with the filesystem's lock held.
+ */
+static struct dirindex *InstallDirIndex(struct unixfilesystem *fs, const struct dirindex *built) {
+  struct dirindex *victim = &fs->dirindexes[0];
+  for (int i = 1; i < DIRINDEX_CACHE_SLOTS && victim->entries != NULL; i++) {
+    struct dirindex *index = &fs->dirindexes[i];
+    if (index->entries == NULL || index->lastUse < victim->lastUse) victim = index;
+  }
+
+  free(victim->entries);
+  free(victim->buckets);
+  *victim = *built;
+  victim->lastUse = ++fs->dirindexClock;
+  return victim;
+}
+
+static int IndexLookup(const struct dirindex *index, const char *name, struct direntv6 *dirEnt) {
+  int bucket = IndexFind(index, name);
+  if (bucket < 0) return -1;
+  *dirEnt = index->entries[index->buckets[bucket]];
+  return 0;
+}
+
+/**
+ * Looks up name in the cached index of the specified directory, building the index
+ * (outside the filesystem's lock, so other threads aren't held up by the reads) if
+ * it isn't cached yet.  Returns 0 if the name is found, -1 if it isn't, and -2 if
+ * the index can't be built.
+ */
+static int IndexedFindName(struct unixfilesystem *fs, const char *name, int dirinumber, struct inode *node,
+                           struct direntv6 *dirEnt) {
+  pthread_mutex_lock(&fs->lock);
+  const struct dirindex *index = FindDirIndex(fs, dirinumber, node);
+  if (index == NULL) {
+    pthread_mutex_unlock(&fs->lock);
+    struct dirindex built;
+    if (BuildDirIndex(fs, dirinumber, node, &built) < 0) return -2;
+
+    // Another thread may have built the same index in the meantime
+    pthread_mutex_lock(&fs->lock);
+    index = FindDirIndex(fs, dirinumber, node);
+    if (index == NULL) {
+      index = InstallDirIndex(fs, &built);
+    } else {
+      free(built.entries);
+      free(built.buckets);
+    }
+  }
+
+  int err = IndexLookup(index, name, dirEnt);
+  pthread_mutex_unlock(&fs->lock);
+  return err;
+}
+
 int directory_findname(struct unixfilesystem *fs, const char *name, int dirinumber, struct direntv6 *dirEnt) {
   // Dir must exist
   if (dirinumber < ROOT_INUMBER) {
     return -1;
   }
 
+  // Names longer than an entry can hold never match
+  if (strlen(name) > sizeof(dirEnt->d_name)) {
+    return -1;
+  }
+
+  // Repeated lookups are answered without touching the disk
+  pthread_mutex_lock(&fs->lock);
+  const struct dentry *cached = DentrySlot(fs, dirinumber, name);
+  int hit = cached->parent == dirinumber && NameMatches(&cached->entry, name);
+  if (hit) *dirEnt = cached->entry;
+  pthread_mutex_unlock(&fs->lock);
+  if (hit) {
+    return 0;
+  }
+
   struct inode node;
   inode_iget(fs, dirinumber, &node);
 
@@ -21,34 +291,290 @@ int directory_findname(struct unixfilesystem *fs, const char *name, int dirinumb
     return -1;
   }
 
-  int inodeSize = inode_getsize(&node);
-  int currentBlock = 0;
-  int bytesRead = 0; // Keep track of bytes read in
+  // Large directories are hashed on first use, and everything else is scanned
+  int err = -2;
+  if (inode_getsize(&node) / (int) sizeof(struct direntv6) >= kMinIndexedEntries) {
+    err = IndexedFindName(fs, name, dirinumber, &node, dirEnt);
+  }
+  if (err == -2) {
+    err = ScanDirectory(fs, &node, name, dirEnt);
+  }
 
-  uint16_t blockNumber = inode_indexlookup(fs, &node, currentBlock); // Get first block
-  char buffer[DISKIMG_SECTOR_SIZE]; // change to 512 constant
-  diskimg_readsector(fs->dfd, blockNumber, buffer);
+  if (err == 0) {
+    pthread_mutex_lock(&fs->lock);
+    struct dentry *cached = DentrySlot(fs, dirinumber, name);
+    cached->parent = dirinumber;
+    cached->entry = *dirEnt;
+    pthread_mutex_unlock(&fs->lock);
+  }
+  return err;
+}
 
-  struct direntv6* tempDirEnt = (struct direntv6*)buffer;
+/**
+ * Empties the specified index's slot.  Called with the filesystem's lock held.
+ */
+static void DropDirIndex(struct dirindex *index) {
+  free(index->entries);
+  free(index->buckets);
+  index->entries = NULL;
+  index->buckets = NULL;
+}
 
-  while (bytesRead < inodeSize) {
+/**
+ * Forgets what's cached about the entry named name in the specified directory after
+ * the entry has been added or removed, along with the directory's index if dropIndex
+ * is set (because the index wasn't updated to match).
+ */
+static void ForgetEntry(struct unixfilesystem *fs, int dirinumber, const char *name, int dropIndex) {
+  pthread_mutex_lock(&fs->lock);
+  for (int i = 0; i < DIRINDEX_CACHE_SLOTS && dropIndex; i++) {
+    struct dirindex *index = &fs->dirindexes[i];
+    if (index->entries != NULL && index->inumber == dirinumber) DropDirIndex(index);
+  }
+  struct dentry *cached = DentrySlot(fs, dirinumber, name);
+  if (cached->parent == dirinumber) cached->parent = 0;
+  pthread_mutex_unlock(&fs->lock);
+}
 
-    // Need to advance to iNode's next block
-    if (bytesRead != 0 && bytesRead % 512 == 0) {
-      currentBlock++;
-      blockNumber = inode_indexlookup(fs, &node, currentBlock);
-      diskimg_readsector(fs->dfd, blockNumber, buffer);
-      tempDirEnt = (struct direntv6*)buffer; // Point to first dirent in new block
+/**
+ * Reads the directory's inode into node, returning 0 if it's an allocated directory
+ * and -1 otherwise.
+ */
+static int GetDirectory(struct unixfilesystem *fs, int dirinumber, struct inode *node) {
+  if (dirinumber < ROOT_INUMBER || inode_iget(fs, dirinumber, node) < 0) return -1;
+  return (node->i_mode & IALLOC) && (node->i_mode & IFMT) == IFDIR ? 0 : -1;
+}
+
+/**
+ * Writes the block of the directory holding entry i, as the index has it, back to
+ * the disk.  Returns 0 on success and -1 on error.
+ */
+static int WriteIndexedBlock(struct unixfilesystem *fs, struct inode *node, struct direntv6 *block, int i) {
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  int blockNumber = inode_indexlookup(fs, node, i / kEntriesPerBlock);
+  if (blockNumber < 0 || diskimg_writesector(fs->dfd, blockNumber, block) != DISKIMG_SECTOR_SIZE) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Adds entry to the specified directory through its cached index, filling the first
+ * free slot at or after the index's hint, or else appending to the directory, and
+ * updates the index to match.  Returns 0 on success, -1 on error, and -2 if the
+ * directory's index isn't cached.
+ */
+static int IndexedAddEntry(struct unixfilesystem *fs, int dirinumber, struct inode *node,
+                           const struct direntv6 *entry) {
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  pthread_mutex_lock(&fs->lock);
+  struct dirindex *index = FindDirIndex(fs, dirinumber, node);
+  if (index == NULL) {
+    pthread_mutex_unlock(&fs->lock);
+    return -2;
+  }
+  int slot = index->freeHint;
+  while (slot < index->numEntries && index->entries[slot].d_inumber != 0) slot++;
+  index->freeHint = slot;
+  if (slot < index->numEntries) {
+    index->entries[slot] = *entry;
+    index->freeHint = slot + 1;
+    IndexInsert(index, slot);
+    struct direntv6 block[kEntriesPerBlock];
+    memcpy(block, index->entries + slot / kEntriesPerBlock * kEntriesPerBlock, sizeof(block));
+    pthread_mutex_unlock(&fs->lock);
+    return WriteIndexedBlock(fs, node, block, slot);
+  }
+  pthread_mutex_unlock(&fs->lock);
+
+  struct inode grown;
+  if (file_append(fs, dirinumber, entry, sizeof(*entry)) != sizeof(*entry) || inode_iget(fs, dirinumber, &grown) < 0) {
+    return -1;
+  }
+
+  // The index still matches the inode as it was before the append.  Growing the index
+  // is done by doubling, so it costs a constant amount per entry; if there's no memory
+  // for it, the index is dropped, since the entry's been added all the same.
+  pthread_mutex_lock(&fs->lock);
+  index = FindDirIndex(fs, dirinumber, node);
+  if (index != NULL && index->numEntries == index->capacity) {
+    struct direntv6 *entries = realloc(index->entries, 2 * index->capacity * sizeof(struct direntv6));
+    if (entries == NULL) {
+      DropDirIndex(index);
+      index = NULL;
+    } else {
+      memset(entries + index->capacity, 0, index->capacity * sizeof(struct direntv6));
+      index->entries = entries;
+      index->capacity *= 2;
     }
+  }
+  if (index != NULL) {
+    index->entries[index->numEntries++] = *entry;
+    index->freeHint = index->numEntries;
+    if (index->numBuckets >= 2 * index->numEntries) {
+      IndexInsert(index, index->numEntries - 1);
+    } else if (IndexRehash(index) < 0) {
+      DropDirIndex(index);
+      index = NULL;
+    }
+  }
+  if (index != NULL) {
+    index->i_mode = grown.i_mode;
+    index->i_size0 = grown.i_size0;
+    index->i_size1 = grown.i_size1;
+    memcpy(index->i_addr, grown.i_addr, sizeof(index->i_addr));
+  }
+  pthread_mutex_unlock(&fs->lock);
+  return 0;
+}
 
-    if (strcmp(tempDirEnt->d_name, name) == 0) {
-      *dirEnt = *tempDirEnt;
-      return 0;
+/**
+ * Removes the entry named name from the specified directory through its cached
+ * index, leaving the slot free and the index's hint no later than it.  Returns the
+ * inumber the entry named, -1 if there's no such entry or on error, and -2 if the
+ * directory's index isn't cached, or can't be updated because some name in it
+ * appears more than once.
+ */
+static int IndexedRemoveEntry(struct unixfilesystem *fs, int dirinumber, struct inode *node, const char *name) {
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  pthread_mutex_lock(&fs->lock);
+  struct dirindex *index = FindDirIndex(fs, dirinumber, node);
+  if (index == NULL || index->duplicates) {
+    pthread_mutex_unlock(&fs->lock);
+    return -2;
+  }
+  int bucket = IndexFind(index, name);
+  if (bucket < 0) {
+    pthread_mutex_unlock(&fs->lock);
+    return -1;
+  }
+  int slot = index->buckets[bucket];
+  int inumber = index->entries[slot].d_inumber;
+  IndexDelete(index, bucket);
+  memset(&index->entries[slot], 0, sizeof(index->entries[slot]));
+  if (slot < index->freeHint) index->freeHint = slot;
+  struct direntv6 block[kEntriesPerBlock];
+  memcpy(block, index->entries + slot / kEntriesPerBlock * kEntriesPerBlock, sizeof(block));
+  pthread_mutex_unlock(&fs->lock);
+  return WriteIndexedBlock(fs, node, block, slot) < 0 ? -1 : inumber;
+}
+
+int directory_addentry(struct unixfilesystem *fs, int dirinumber, const char *name, int inumber) {
+  struct direntv6 entry;
+  if (strlen(name) == 0 || strlen(name) > sizeof(entry.d_name) || inumber < ROOT_INUMBER) {
+    return -1;
+  }
+  memset(&entry, 0, sizeof(entry));
+  entry.d_inumber = inumber;
+  strncpy(entry.d_name, name, sizeof(entry.d_name));
+
+  struct inode node;
+  if (GetDirectory(fs, dirinumber, &node) < 0) {
+    return -1;
+  }
+
+  // A directory whose index is cached is updated along with its index...
+  int err = IndexedAddEntry(fs, dirinumber, &node, &entry);
+  if (err != -2) {
+    ForgetEntry(fs, dirinumber, name, err < 0);
+    return err;
+  }
+
+  // ...and otherwise the first free slot is filled, if there is one...
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  int numEntries = inode_getsize(&node) / sizeof(struct direntv6);
+  for (int bno = 0; bno * kEntriesPerBlock < numEntries; bno++) {
+    struct direntv6 entries[kEntriesPerBlock];
+    int blockNumber = inode_indexlookup(fs, &node, bno);
+    if (blockNumber < 0 || diskimg_readsector(fs->dfd, blockNumber, entries) != DISKIMG_SECTOR_SIZE) {
+      return -1;
+    }
+    for (int i = 0; i < kEntriesPerBlock && bno * kEntriesPerBlock + i < numEntries; i++) {
+      if (entries[i].d_inumber != 0) continue;
+      entries[i] = entry;
+      err = diskimg_writesector(fs->dfd, blockNumber, entries) == DISKIMG_SECTOR_SIZE ? 0 : -1;
+      ForgetEntry(fs, dirinumber, name, 1);
+      return err;
     }
+  }
 
-    tempDirEnt++; // move to next dirent in block
-    bytesRead += sizeof(struct direntv6);
+  // ...or one is added to the end
+  err = file_append(fs, dirinumber, &entry, sizeof(entry)) == sizeof(entry) ? 0 : -1;
+  ForgetEntry(fs, dirinumber, name, 1);
+  return err;
+}
+
+int directory_removeentry(struct unixfilesystem *fs, int dirinumber, const char *name) {
+  struct inode node;
+  if (GetDirectory(fs, dirinumber, &node) < 0) {
+    return -1;
   }
 
-  return -1; // Exceeded iNode's block data
+  int inumber = IndexedRemoveEntry(fs, dirinumber, &node, name);
+  if (inumber != -2) {
+    ForgetEntry(fs, dirinumber, name, inumber < 0);
+    return inumber;
+  }
+
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  int numEntries = inode_getsize(&node) / sizeof(struct direntv6);
+  for (int bno = 0; bno * kEntriesPerBlock < numEntries; bno++) {
+    struct direntv6 entries[kEntriesPerBlock];
+    int blockNumber = inode_indexlookup(fs, &node, bno);
+    if (blockNumber < 0 || diskimg_readsector(fs->dfd, blockNumber, entries) != DISKIMG_SECTOR_SIZE) {
+      return -1;
+    }
+    for (int i = 0; i < kEntriesPerBlock && bno * kEntriesPerBlock + i < numEntries; i++) {
+      if (!NameMatches(&entries[i], name)) continue;
+      inumber = entries[i].d_inumber;
+      memset(&entries[i], 0, sizeof(entries[i]));
+      int err = diskimg_writesector(fs->dfd, blockNumber, entries) == DISKIMG_SECTOR_SIZE ? 0 : -1;
+      ForgetEntry(fs, dirinumber, name, 1);
+      return err < 0 ? -1 : inumber;
+    }
+  }
+  return -1;
+}
+
+int directory_iterinit(struct unixfilesystem *fs, int dirinumber, struct directory_iter *it) {
+  struct inode in;
+  if (inode_iget(fs, dirinumber, &in) < 0) {
+    return -1;
+  }
+  return directory_iterinode(fs, &in, it);
+}
+
+int directory_iterinode(struct unixfilesystem *fs, const struct inode *in, struct directory_iter *it) {
+  if (!(in->i_mode & IALLOC) || ((in->i_mode & IFMT) != IFDIR)) {
+    /* Not allocated or not a directory */
+    return -1;
+  }
+
+  it->fs = fs;
+  it->node = *in;
+  it->numEntries = inode_getsize(&it->node) / sizeof(struct direntv6);
+  it->next = 0;
+  it->block = NULL;
+  return 0;
+}
+
+int directory_iternext(struct directory_iter *it, const struct direntv6 **dirEnt) {
+  const int kEntriesPerBlock = DISKIMG_SECTOR_SIZE / sizeof(struct direntv6);
+  for (; it->next < it->numEntries; it->next++) {
+    if (it->next % kEntriesPerBlock == 0) {
+      int blockNumber = inode_indexlookup(it->fs, &it->node, it->next / kEntriesPerBlock);
+      it->block = blockNumber < 0 ? NULL : diskimg_getsector(it->fs->dfd, blockNumber, it->buffer);
+      if (it->block == NULL) {
+        return -1;
+      }
+    }
+
+    // Skip the free slots unlinks leave behind
+    *dirEnt = &it->block[it->next % kEntriesPerBlock];
+    if ((*dirEnt)->d_inumber != 0) {
+      it->next++;
+      return 1;
+    }
+  }
+  return 0;
 }
@@ -3,13 +3,71 @@
 
 #include "unixfilesystem.h"
 #include "direntv6.h"
+#include "diskimg.h"
 
 /**
  * Looks up the specified name (name) in the specified directory (dirinumber).  
  * If found, return the directory entry in space addressed by dirEnt.  Returns 0 
  * on success and something negative on failure. 
+ *
+ * Successful lookups are remembered per (directory, name), so resolving the same
+ * name again doesn't touch the disk, and directories of more than a few blocks
+ * are read once and hashed by name, so a lookup in one costs the same however
+ * large it is.
  */
 int directory_findname(struct unixfilesystem *fs, const char *name,
                        int dirinumber, struct direntv6 *dirEnt);
 
+/**
+ * Adds an entry naming the specified inode (inumber) to the specified directory
+ * (dirinumber), in the first free slot or else at the end.  The caller is expected
+ * to have checked that there's no entry by that name yet.  Returns 0 on success,
+ * -1 on failure.
+ */
+int directory_addentry(struct unixfilesystem *fs, int dirinumber, const char *name, int inumber);
+
+/**
+ * Removes the entry named name from the specified directory, leaving a free slot
+ * (an entry whose inumber is 0).  Returns the inumber the entry named, or -1 if
+ * there's no such entry or the directory can't be written.
+ */
+int directory_removeentry(struct unixfilesystem *fs, int dirinumber, const char *name);
+
+/**
+ * Walks the entries of a directory in order, one sector at a time.  The directory's
+ * inode is read once, when the iteration starts, and only one sector of entries is
+ * held at a time, so neither stack use nor the cost per entry depends on the size of
+ * the directory.  Treat the fields as private.
+ */
+struct directory_iter {
+  struct unixfilesystem *fs;
+  struct inode node;
+  int numEntries;
+  int next;                     // index of the next entry to yield
+  const struct direntv6 *block; // the current sector's entries
+  char buffer[DISKIMG_SECTOR_SIZE];
+};
+
+/**
+ * Starts an iteration over the entries of the specified directory (dirinumber).
+ * Returns 0 on success, and -1 if the inode can't be read or isn't an allocated
+ * directory.  An iteration needs no cleanup.
+ */
+int directory_iterinit(struct unixfilesystem *fs, int dirinumber, struct directory_iter *it);
+
+/**
+ * Starts an iteration over the entries of the directory whose inode the caller
+ * has already read (in), without reading it again.  Returns 0 on success, and -1
+ * if the inode isn't an allocated directory.
+ */
+int directory_iterinode(struct unixfilesystem *fs, const struct inode *in, struct directory_iter *it);
+
+/**
+ * Points *dirEnt at the next entry of the iteration and returns 1, or returns 0
+ * once every entry has been seen, or -1 if a block of the directory can't be read.
+ * Free slots are skipped.  The entry is read-only, and only valid until the next
+ * call.
+ */
+int directory_iternext(struct directory_iter *it, const struct direntv6 **dirEnt);
+
 #endif // _DIECTORY_H_
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <string.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include "diskimg.h"
 #include "unixfilesystem.h"
@@ -16,26 +17,60 @@
 int quietFlag = 0; 
 int idumpFlag = 0;
 int pdumpFlag = 0;
+int statsFlag = 0;
+int mapFlag = 0;
+int numJobs = 1;
+
+// Longest pathname the -p dump builds
+#define MAXPATH 1024
 
 static void PrintDirectory(struct unixfilesystem *fs,  char *pathname);
 static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f);
+static int DumpInodeRange(struct unixfilesystem *fs, int first, int last, FILE *f, FILE *errf);
 static void DumpPathnameChecksum(struct unixfilesystem *fs, FILE *f);
+static int DumpPath(struct unixfilesystem *fs, const char *pathname, int inumber, FILE *f, FILE *errf);
+static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname, int inumber, FILE *f, FILE *errf);
+static void ParallelDump(struct unixfilesystem *fs, int mode, FILE *f);
 static void PrintUsageAndExit(char *progname);
-static int GetDirEntries(struct unixfilesystem *fs, int inumber, struct direntv6 *entries, int maxNumEntries);
 
 int main(int argc, char *argv[]) {
   int opt;
-  while ((opt = getopt(argc, argv, "iqp")) != -1) {
+  while ((opt = getopt(argc, argv, "a:c:ij:mqps")) != -1) {
     switch (opt) {
+    case 'a':
+      if (chksumfile_setalgorithm(optarg) < 0) {
+        fprintf(stderr, "Unknown hash %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'c':
+      if (diskimg_setcachesize(atoi(optarg)) < 0) {
+        fprintf(stderr, "Can't set the sector cache to %s sectors\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
     case 'q':
       quietFlag = 1;
       break;
     case 'i':
       idumpFlag = 1;
       break;
+    case 'j':
+      numJobs = atoi(optarg);
+      if (numJobs < 1) {
+        fprintf(stderr, "Can't run %s jobs\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'm':
+      mapFlag = 1;
+      break;
     case 'p':
       pdumpFlag = 1;
       break;
+    case 's':
+      statsFlag = 1;
+      break;
     default: 
       PrintUsageAndExit(argv[0]);
     } 
@@ -46,7 +81,7 @@ int main(int argc, char *argv[]) {
   }
 
   char *diskpath = argv[optind];
-  int fd = diskimg_open(diskpath, 1);
+  int fd = mapFlag ? diskimg_openmapped(diskpath) : diskimg_open(diskpath, 1);
 
   if (fd < 0) {
     fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
@@ -66,7 +101,7 @@ int main(int argc, char *argv[]) {
       // Cast the result of diskimg_close to void so the compiler doesn't
       // complain that we're ignoring its return value.
       (void) diskimg_close(fd);
-      free(fs);
+      unixfilesystem_free(fs);
       exit(EXIT_FAILURE);
     }
     printf("Disk %s is %d bytes (%d KB)\n", argv[1],  disksize, disksize/1024);
@@ -76,12 +111,25 @@ int main(int argc, char *argv[]) {
     printf("Superblock s_ninode %d\n",(int)fs->superblock.s_ninode);
   }
 
-  if (idumpFlag) DumpInodeChecksum(fs, stdout);
-  if (pdumpFlag) DumpPathnameChecksum(fs, stdout);
+  if (numJobs > 1) {
+    if (idumpFlag) ParallelDump(fs, 'i', stdout);
+    if (pdumpFlag) ParallelDump(fs, 'p', stdout);
+  } else {
+    if (idumpFlag) DumpInodeChecksum(fs, stdout);
+    if (pdumpFlag) DumpPathnameChecksum(fs, stdout);
+  }
+
+  if (statsFlag) {
+    struct diskimg_cachestats stats;
+    diskimg_getcachestats(&stats);
+    fprintf(stderr, "Sector cache hits %llu misses %llu reads %llu evictions %llu\n",
+            (unsigned long long) stats.hits, (unsigned long long) stats.misses,
+            (unsigned long long) stats.reads, (unsigned long long) stats.evictions);
+  }
 
   int err = diskimg_close(fd);
   if (err < 0) fprintf(stderr, "Error closing %s\n", argv[1]);
-  free(fs);
+  unixfilesystem_free(fs);
   exit(EXIT_SUCCESS);
   return 0;
 }
@@ -93,61 +141,90 @@ int main(int argc, char *argv[]) {
  * format.
  */
 static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f) {
-  for (int inumber = 1; inumber < fs->superblock.s_isize*16; inumber++) {
-    struct inode in;
-    if (inode_iget(fs, inumber, &in) < 0) {
-      fprintf(stderr,"Can't read inode %d \n", inumber);
-      return;
-    }
-    if ((in.i_mode & IALLOC) == 0) {
-      // Skip this inode if it's not allocated.
-      continue;
-    }
+  DumpInodeRange(fs, 1, fs->superblock.s_isize*16, f, stderr);
+}
 
-    char chksum[CHKSUMFILE_SIZE];
-    if (chksumfile_byinumber(fs, inumber, chksum) < 0) {
-      fprintf(stderr, "Inode %d can't compute chksum\n", inumber);
-      continue;
+/**
+ * Output to the specified file the checksums of the allocated inodes numbered first
+ * through last - 1, and any errors to errf.  Returns -1 if an inode couldn't be
+ * read, which ends the dump, and 0 otherwise.
+ */
+static int DumpInodeRange(struct unixfilesystem *fs, int first, int last, FILE *f, FILE *errf) {
+  // Inodes are checksummed in batches, so that the files in a batch can be hashed together
+  const int kBatchSize = 256;
+  int inumber = first;
+  while (inumber < last) {
+    int inumbers[kBatchSize];
+    struct inode inodes[kBatchSize];
+    int count = 0;
+    int readError = 0;
+    for (; inumber < last && count < kBatchSize; inumber++) {
+      if (inode_iget(fs, inumber, &inodes[count]) < 0) {
+        readError = 1;
+        break;
+      }
+      if ((inodes[count].i_mode & IALLOC) == 0) {
+        // Skip this inode if it's not allocated.
+        continue;
+      }
+      inumbers[count++] = inumber;
     }
 
-    char chksumstring[CHKSUMFILE_STRINGSIZE];
-    chksumfile_cvt2string(chksum, chksumstring);
+    char chksums[kBatchSize][CHKSUMFILE_SIZE];
+    int results[kBatchSize];
+    chksumfile_byinumbers(fs, inumbers, count, chksums, results);
+    for (int i = 0; i < count; i++) {
+      if (results[i] < 0) {
+        fprintf(errf, "Inode %d can't compute chksum\n", inumbers[i]);
+        continue;
+      }
+
+      char chksumstring[CHKSUMFILE_STRINGSIZE];
+      chksumfile_cvt2string(chksums[i], chksumstring);
+
+      int size = inode_getsize(&inodes[i]);
+      fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n",inumbers[i],inodes[i].i_mode, size, chksumstring);
+    }
 
-    int size = inode_getsize(&in);
-    fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n",inumber,in.i_mode, size, chksumstring);
+    if (readError) {
+      fprintf(errf,"Can't read inode %d \n", inumber);
+      return -1;
+    }
   }
+  return 0;
 }
 
 /**
  * Output to the specified file the checksum of the specified pathname and
- * inode as well as all its children if it is a directory.
+ * inode, and any errors to errf.  Returns 1 if the inode is a directory whose
+ * children should be dumped next, and 0 otherwise.
  *
  * This is used by the grading script, so be careful not to change its output
  * format.
  */
-static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname, int inumber, FILE *f) {
+static int DumpPath(struct unixfilesystem *fs, const char *pathname, int inumber, FILE *f, FILE *errf) {
   struct inode in;
   if (inode_iget(fs, inumber, &in) < 0) {
-    fprintf(stderr,"Can't read inode %d \n", inumber);
-    return;
+    fprintf(errf,"Can't read inode %d \n", inumber);
+    return 0;
   }
   assert(in.i_mode & IALLOC);
 
   char chksum1[CHKSUMFILE_SIZE];
   if (chksumfile_byinumber(fs, inumber, chksum1) < 0) {
-    fprintf(stderr,"Can't checksum inode %d path %s\n", inumber, pathname);
-    return;
+    fprintf(errf,"Can't checksum inode %d path %s\n", inumber, pathname);
+    return 0;
   }
 
   char chksum2[CHKSUMFILE_SIZE];
   if (chksumfile_bypathname(fs, pathname, chksum2) < 0) {
-    fprintf(stderr,"Can't checksum inode %d path %s\n", inumber, pathname);
-    return;
+    fprintf(errf,"Can't checksum inode %d path %s\n", inumber, pathname);
+    return 0;
   }
 
   if (!chksumfile_compare(chksum1, chksum2)) {
-    fprintf(stderr,"Pathname checksum of %s differs from inode %d\n", pathname, inumber);
-    return;
+    fprintf(errf,"Pathname checksum of %s differs from inode %d\n", pathname, inumber);
+    return 0;
   }
 
   char chksumstring[CHKSUMFILE_STRINGSIZE];
@@ -155,32 +232,51 @@ static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname,
   int size = inode_getsize(&in);
   fprintf(f, "Path %s %d mode 0x%x size %d checksum %s\n",pathname,inumber,in.i_mode, size, chksumstring);
 
+  if ((in.i_mode & IFMT) != IFDIR) return 0;
+  if (strlen(pathname) > MAXPATH-16) {
+    fprintf(errf, "Too deep of directories %s\n", pathname);
+  }
+  return 1;
+}
+
+/**
+ * Returns 1 if the specified directory entry name is "." or "..", and 0 otherwise.
+ */
+static int IsDotOrDotDot(const char *n) {
+  return n[0] == '.' && ((n[1] == 0) || ((n[1] == '.') && (n[2] == 0)));
+}
+
+/**
+ * Output to the specified file the checksum of the specified pathname and
+ * inode as well as all its children if it is a directory.
+ *
+ * This is used by the grading script, so be careful not to change its output
+ * format.
+ */
+static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname, int inumber, FILE *f, FILE *errf) {
+  if (!DumpPath(fs, pathname, inumber, f, errf)) return;
+
   if (pathname[1] == 0) {
     /* pathame == "/" */
     pathname++; /* Delete extra / character */
   }
 
-  if ((in.i_mode & IFMT) == IFDIR) { 
-      const unsigned int MAXPATH = 1024;
-      if (strlen(pathname) > MAXPATH-16) {
-        fprintf(stderr, "Too deep of directories %s\n", pathname);
-      }
-
-      struct direntv6 direntries[10000];
-      int numentries = GetDirEntries(fs, inumber, direntries, 10000);
-      for (int i = 0; i < numentries; i++) {
-        char *n =  direntries[i].d_name;
-        if (n[0] == '.') {
-          if ((n[1] == 0) || ((n[1] == '.') && (n[2] == 0))) {
-            /* Skip over "." and ".." */
-            continue;
-          }
-        }
+  struct directory_iter it;
+  if (directory_iterinit(fs, inumber, &it) < 0) return;
+  const struct direntv6 *dirent;
+  int more;
+  while ((more = directory_iternext(&it, &dirent)) > 0) {
+    if (IsDotOrDotDot(dirent->d_name)) {
+      /* Skip over "." and ".." */
+      continue;
+    }
 
-        char nextpath[MAXPATH];
-        sprintf(nextpath, "%s/%s",pathname, direntries[i].d_name);
-        DumpPathAndChildren(fs, nextpath,  direntries[i].d_inumber, f);
-      }
+    char nextpath[MAXPATH];
+    sprintf(nextpath, "%s/%s",pathname, dirent->d_name);
+    DumpPathAndChildren(fs, nextpath,  dirent->d_inumber, f, errf);
+  }
+  if (more < 0) {
+    fprintf(errf, "Error reading directory\n");
   }
 }
 
@@ -190,71 +286,247 @@ static void DumpPathAndChildren(struct unixfilesystem *fs, const char *pathname,
  * Note this is used by the grading script so don't alter output format. 
  */
 static void DumpPathnameChecksum(struct unixfilesystem *fs, FILE *f) {
-  DumpPathAndChildren(fs, "/", ROOT_INUMBER, f);
+  DumpPathAndChildren(fs, "/", ROOT_INUMBER, f, stderr);
 }
 
 /**
- * Print all the entries in the specified directory. 
+ * A unit of work in a parallel dump.  For -i, a task checksums a range of
+ * kInodesPerTask inodes starting at inumber.  For -p, a task dumps pathname
+ * and, if descend is set, the whole subtree below it; a task without descend
+ * dumps just its own line, and its children are tasks of their own that only
+ * count if it succeeds.  Each task's output is captured in memory and printed
+ * in task order, so the result matches the serial dump byte for byte.
  */
-static void PrintDirectory(struct unixfilesystem *fs,  char *pathname) {
-  int inumber = pathname_lookup(fs, pathname);
-  if (inumber < 0) {
-    fprintf(stderr, "Can't find %s\n", pathname);
-    return;
+struct dumptask {
+  char *pathname;
+  int inumber;
+  int descend;
+  int parent;     // task this one depends on, or -1
+  int status;     // -i: DumpInodeRange's result; -p: 1 if the task's children count
+  int done;
+  char *out;
+  size_t outSize;
+  char *err;
+  size_t errSize;
+};
+
+struct dumpjob {
+  struct unixfilesystem *fs; // shared by every worker
+  int mode;                  // 'i' or 'p'
+  struct dumptask *tasks;
+  int numTasks;
+  int nextTask;              // next task to hand to a worker
+  int nextEmit;              // next task to print
+  int window;                // how far ahead of nextEmit workers may run
+  int stopped;               // set once an -i task hits an unreadable inode
+  pthread_mutex_t lock;
+  pthread_cond_t emitted;
+  FILE *f;
+};
+
+static const int kInodesPerTask = 32;
+static const int kTasksPerJob = 16;       // -p splits directories until there are this many tasks per thread
+static const int kMaxSplitDepth = 4;
+static const int kWindowPerJob = 8;
+
+static int AddTask(struct dumpjob *job, int *capacity, const char *pathname, int inumber, int descend, int parent) {
+  if (job->numTasks == *capacity) {
+    *capacity = *capacity == 0 ? 64 : 2 * *capacity;
+    job->tasks = realloc(job->tasks, *capacity * sizeof(struct dumptask));
+    if (job->tasks == NULL) {
+      fprintf(stderr, "Out of memory planning the dump\n");
+      exit(EXIT_FAILURE);
+    }
   }
+  struct dumptask *task = &job->tasks[job->numTasks];
+  memset(task, 0, sizeof(*task));
+  task->pathname = pathname == NULL ? NULL : strdup(pathname);
+  task->inumber = inumber;
+  task->descend = descend;
+  task->parent = parent;
+  return job->numTasks++;
+}
 
-  struct direntv6 direntries[10000];
-  int numentries = GetDirEntries(fs, inumber, direntries, 10000);
-  if (numentries < 0) {
-    fprintf(stderr, "Can't read entries from %s\n", pathname);
-    return;
+/**
+ * Splits the -p dump into tasks, one level of directories at a time, until there
+ * are enough of them to keep numJobs threads busy.  Directories that can't be
+ * listed are left whole, for the worker to report.
+ */
+static void PlanPathTasks(struct dumpjob *job) {
+  int capacity = 0;
+  AddTask(job, &capacity, "/", ROOT_INUMBER, 1, -1);
+  for (int depth = 0; depth < kMaxSplitDepth && job->numTasks < kTasksPerJob * numJobs; depth++) {
+    struct dumptask *previous = job->tasks;
+    int numPrevious = job->numTasks;
+    int *renumbered = malloc(numPrevious * sizeof(int));
+    job->tasks = NULL;
+    job->numTasks = 0;
+    capacity = 0;
+
+    for (int i = 0; i < numPrevious; i++) {
+      struct dumptask *task = &previous[i];
+      int parent = task->parent < 0 ? -1 : renumbered[task->parent];
+      struct directory_iter it;
+      if (!task->descend || directory_iterinit(job->fs, task->inumber, &it) < 0) {
+        renumbered[i] = AddTask(job, &capacity, task->pathname, task->inumber, task->descend, parent);
+        free(task->pathname);
+        continue;
+      }
+
+      renumbered[i] = AddTask(job, &capacity, task->pathname, task->inumber, 0, parent);
+      const char *prefix = task->pathname[1] == 0 ? "" : task->pathname;
+      const struct direntv6 *dirent;
+      while (directory_iternext(&it, &dirent) > 0) {
+        if (IsDotOrDotDot(dirent->d_name)) continue;
+        char nextpath[MAXPATH];
+        sprintf(nextpath, "%s/%s", prefix, dirent->d_name);
+        AddTask(job, &capacity, nextpath, dirent->d_inumber, 1, renumbered[i]);
+      }
+      free(task->pathname);
+    }
+    free(previous);
+    free(renumbered);
+  }
+}
+
+static void RunTask(struct dumpjob *job, struct unixfilesystem *fs, struct dumptask *task) {
+  FILE *out = open_memstream(&task->out, &task->outSize);
+  FILE *err = open_memstream(&task->err, &task->errSize);
+  if (out == NULL || err == NULL) {
+    fprintf(stderr, "Out of memory running the dump\n");
+    exit(EXIT_FAILURE);
   }
-  
-  for (int i = 0; i < numentries; i++) { 
-    printf("Direntry %s Name %s Inumber %d\n", pathname, direntries[i].d_name, direntries[i].d_inumber);
+
+  if (job->mode == 'i') {
+    int last = fs->superblock.s_isize*16;
+    if (last > task->inumber + kInodesPerTask) last = task->inumber + kInodesPerTask;
+    task->status = DumpInodeRange(fs, task->inumber, last, out, err);
+  } else if (task->descend) {
+    DumpPathAndChildren(fs, task->pathname, task->inumber, out, err);
+    task->status = 0;
+  } else {
+    task->status = DumpPath(fs, task->pathname, task->inumber, out, err);
   }
+  fclose(out);
+  fclose(err);
 }
 
 /**
- * Fetch as many entries from a directory that will fit in the specified array. Return the 
- * number of entries found. 
+ * Prints every finished task at the head of the reorder buffer.  A -p task whose
+ * parent didn't succeed is dropped, just as the serial dump would never have
+ * reached it, and an -i task that stopped at an unreadable inode drops every task
+ * after it.  Called with the job's lock held.
  */
-static int GetDirEntries(struct unixfilesystem *fs, int inumber, struct direntv6 *entries, int maxNumEntries) {
-  struct inode in;
-  int err = inode_iget(fs, inumber, &in);
-  if (err < 0) return err;
-  
-  if (!(in.i_mode & IALLOC) || ((in.i_mode & IFMT) != IFDIR)) {
-    /* Not allocated or not a directory */
-    return -1;
+static void EmitTasks(struct dumpjob *job) {
+  while (job->nextEmit < job->numTasks && job->tasks[job->nextEmit].done) {
+    struct dumptask *task = &job->tasks[job->nextEmit++];
+    if (task->parent >= 0 && job->tasks[task->parent].status <= 0) {
+      task->status = 0;
+    } else {
+      fwrite(task->out, 1, task->outSize, job->f);
+      fwrite(task->err, 1, task->errSize, stderr);
+    }
+    free(task->out);
+    free(task->err);
+    if (job->mode == 'i' && task->status < 0) {
+      job->stopped = 1;
+      job->nextEmit = job->numTasks;
+    }
   }
+  pthread_cond_broadcast(&job->emitted);
+}
 
-  if (maxNumEntries < 1) return -1;
-  int size = inode_getsize(&in);
+static void *DumpWorker(void *arg) {
+  struct dumpjob *job = arg;
+  pthread_mutex_lock(&job->lock);
+  while (!job->stopped && job->nextTask < job->numTasks) {
+    int index = job->nextTask++;
+    while (index >= job->nextEmit + job->window) pthread_cond_wait(&job->emitted, &job->lock);
+    if (job->stopped) break;
+    pthread_mutex_unlock(&job->lock);
+
+    struct dumptask *task = &job->tasks[index];
+    RunTask(job, job->fs, task);
+
+    pthread_mutex_lock(&job->lock);
+    if (job->stopped) {
+      free(task->out);
+      free(task->err);
+    } else {
+      task->done = 1;
+      EmitTasks(job);
+    }
+  }
+  pthread_mutex_unlock(&job->lock);
+  return NULL;
+}
 
-  assert((size % sizeof(struct direntv6)) == 0);
-
-  int count = 0;
-  int numBlocks  = (size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
-  char buf[DISKIMG_SECTOR_SIZE];
-  struct direntv6 *dir = (struct direntv6 *) buf;
-  for (int bno = 0; bno < numBlocks; bno++) {
-    int bytesLeft, numEntriesInBlock, i;
-    bytesLeft = file_getblock(fs, inumber,bno,dir);
-    if (bytesLeft < 0) {
-      fprintf(stderr, "Error reading directory\n");
-      return -1;
+/**
+ * Output the -i (mode 'i') or -p (mode 'p') dump to the specified file using numJobs
+ * threads, all sharing the specified filesystem and so its caches.
+ */
+static void ParallelDump(struct unixfilesystem *fs, int mode, FILE *f) {
+  struct dumpjob job;
+  memset(&job, 0, sizeof(job));
+  job.fs = fs;
+  job.mode = mode;
+  job.window = kWindowPerJob * numJobs;
+  job.f = f;
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_cond_init(&job.emitted, NULL);
+
+  if (mode == 'i') {
+    int capacity = 0;
+    for (int inumber = 1; inumber < fs->superblock.s_isize*16; inumber += kInodesPerTask) {
+      AddTask(&job, &capacity, NULL, inumber, 0, -1);
     }
-    numEntriesInBlock = bytesLeft/sizeof(struct direntv6); 
-    for (i = 0; i <  numEntriesInBlock ; i++) { 
-      entries[count] = dir[i];
-      count++;
-      if (count >= maxNumEntries) return count;
+  } else {
+    PlanPathTasks(&job);
+  }
+
+  fflush(f);
+  pthread_t workers[numJobs];
+  for (int i = 0; i < numJobs; i++) {
+    if (pthread_create(&workers[i], NULL, DumpWorker, &job) != 0) {
+      fprintf(stderr, "Can't start job %d\n", i);
+      exit(EXIT_FAILURE);
     }
   }
-  return count;
+  for (int i = 0; i < numJobs; i++) {
+    pthread_join(workers[i], NULL);
+  }
+
+  for (int i = 0; i < job.numTasks; i++) free(job.tasks[i].pathname);
+  free(job.tasks);
+  pthread_mutex_destroy(&job.lock);
+  pthread_cond_destroy(&job.emitted);
 }
 
+/**
+ * Print all the entries in the specified directory. 
+ */
+static void PrintDirectory(struct unixfilesystem *fs,  char *pathname) {
+  int inumber = pathname_lookup(fs, pathname);
+  if (inumber < 0) {
+    fprintf(stderr, "Can't find %s\n", pathname);
+    return;
+  }
+
+  struct directory_iter it;
+  if (directory_iterinit(fs, inumber, &it) < 0) {
+    fprintf(stderr, "Can't read entries from %s\n", pathname);
+    return;
+  }
+
+  const struct direntv6 *dirent;
+  int more;
+  while ((more = directory_iternext(&it, &dirent)) > 0) {
+    printf("Direntry %s Name %s Inumber %d\n", pathname, dirent->d_name, dirent->d_inumber);
+  }
+  if (more < 0) {
+    fprintf(stderr, "Error reading directory\n");
+  }
+}
 
 static void PrintUsageAndExit(char *progname) {
   fprintf(stderr, "Usage: %s <options> diskimagePath\n", progname);
@@ -262,5 +534,11 @@ static void PrintUsageAndExit(char *progname) {
   fprintf(stderr, "-q     don't print extra info\n"); 
   fprintf(stderr, "-i     print all inode checksums\n"); 
   fprintf(stderr, "-p     print all pathname checksums\n");  
+  fprintf(stderr, "-a H   checksum with hash H: sha1 (the default) or crc32c (faster, but not comparable with sha1 output)\n");
+  fprintf(stderr, "-j N   compute the -i and -p checksums with N threads (output is unchanged)\n");
+  fprintf(stderr, "-m     map the whole disk image into memory instead of reading it sector by sector\n");
+  fprintf(stderr, "-c N   cache up to N recently read sectors (default %d, 0 disables)\n",
+          DISKIMG_DEFAULT_CACHE_SECTORS);
+  fprintf(stderr, "-s     print sector cache statistics to stderr\n");
   exit(EXIT_FAILURE);
 }
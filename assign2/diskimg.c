@@ -1,31 +1,476 @@
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "diskimg.h"
 
+/**
+ * The sector cache.  Entries live in a fixed array of capacity slots, with each
+ * slot's sector stored at the same index in data.  Slots are threaded onto a
+ * doubly linked LRU list (most recently used at head) and onto a hash chain
+ * hanging off buckets.  Free slots are kept on a singly linked list through next.
+ * A dirty slot holds a write that hasn't reached the disk image yet.
+ */
+struct cacheentry {
+  int fd;
+  int sectorNum;
+  int prev;     // LRU neighbors, or -1
+  int next;
+  int chain;    // next slot in the same hash bucket, or -1
+  int dirty;
+};
+
+// Most sectors written back with a single system call
+#define MAX_WRITEBACK_SECTORS 64
+
+static struct {
+  int capacity;   // -1 until first use, when the default takes effect
+  struct cacheentry *entries;
+  char *data;
+  int *buckets;
+  int numBuckets; // a power of two
+  int head;
+  int tail;
+  int freeList;
+  int writeFailed; // a write-back failed since the last diskimg_sync
+  struct diskimg_cachestats stats;
+} cache = { .capacity = -1 };
+
+static int CacheFind(int fd, int sectorNum);
+static int CacheWriteBackAll(int fd);
+
+static int CacheResize(int numSectors) {
+  int err = cache.capacity > 0 ? CacheWriteBackAll(-1) : 0;
+  free(cache.entries);
+  free(cache.data);
+  free(cache.buckets);
+  cache.entries = NULL;
+  cache.data = NULL;
+  cache.buckets = NULL;
+  cache.capacity = 0;
+  cache.head = cache.tail = cache.freeList = -1;
+  if (numSectors == 0) return err;
+
+  int numBuckets = 1;
+  while (numBuckets < 2 * numSectors) numBuckets *= 2;
+  cache.entries = malloc(numSectors * sizeof(struct cacheentry));
+  cache.data = malloc((size_t) numSectors * DISKIMG_SECTOR_SIZE);
+  cache.buckets = malloc(numBuckets * sizeof(int));
+  if (cache.entries == NULL || cache.data == NULL || cache.buckets == NULL) {
+    CacheResize(0);
+    return -1;
+  }
+
+  cache.capacity = numSectors;
+  cache.numBuckets = numBuckets;
+  for (int i = 0; i < numBuckets; i++) cache.buckets[i] = -1;
+  for (int i = 0; i < numSectors; i++) cache.entries[i].next = i + 1 < numSectors ? i + 1 : -1;
+  cache.freeList = 0;
+  return err;
+}
+
+static int CacheBucket(int fd, int sectorNum) {
+  unsigned int hash = (unsigned int) sectorNum * 2654435761u ^ (unsigned int) fd;
+  return hash & (cache.numBuckets - 1);
+}
+
+static void CacheUnlink(int slot) {
+  struct cacheentry *e = &cache.entries[slot];
+  if (e->prev != -1) cache.entries[e->prev].next = e->next; else cache.head = e->next;
+  if (e->next != -1) cache.entries[e->next].prev = e->prev; else cache.tail = e->prev;
+}
+
+static void CachePushFront(int slot) {
+  struct cacheentry *e = &cache.entries[slot];
+  e->prev = -1;
+  e->next = cache.head;
+  if (cache.head != -1) cache.entries[cache.head].prev = slot; else cache.tail = slot;
+  cache.head = slot;
+}
+
+static void CacheUnchain(int slot) {
+  struct cacheentry *e = &cache.entries[slot];
+  int *link = &cache.buckets[CacheBucket(e->fd, e->sectorNum)];
+  while (*link != slot) link = &cache.entries[*link].chain;
+  *link = e->chain;
+}
+
+static void CacheRemove(int slot) {
+  CacheUnlink(slot);
+  CacheUnchain(slot);
+  cache.entries[slot].next = cache.freeList;
+  cache.freeList = slot;
+}
+
+/**
+ * Returns the slot holding the specified sector, or -1 if it isn't cached.
+ */
+static int CacheFind(int fd, int sectorNum) {
+  for (int slot = cache.buckets[CacheBucket(fd, sectorNum)]; slot != -1; slot = cache.entries[slot].chain) {
+    if (cache.entries[slot].fd == fd && cache.entries[slot].sectorNum == sectorNum) return slot;
+  }
+  return -1;
+}
+
+/**
+ * Returns the slot holding the specified sector if it's cached and dirty, and -1
+ * otherwise.
+ */
+static int CacheFindDirty(int fd, int sectorNum) {
+  int slot = sectorNum < 0 ? -1 : CacheFind(fd, sectorNum);
+  return slot != -1 && cache.entries[slot].dirty ? slot : -1;
+}
+
+/**
+ * Writes the dirty sector in the specified slot to the disk image, along with the
+ * dirty sectors on either side of it, so a file written a block at a time goes out
+ * in runs of up to MAX_WRITEBACK_SECTORS sectors, one system call per run.  The
+ * sectors stay cached, and are clean afterwards.  Returns 0 on success and -1 if
+ * the write fails, in which case the sectors are left dirty.  Called with the lock
+ * held, so other threads wait for the write.
+ */
+static int CacheWriteBack(int slot) {
+  int fd = cache.entries[slot].fd;
+  int first = cache.entries[slot].sectorNum;
+  int count = 1;
+  while (count < MAX_WRITEBACK_SECTORS && CacheFindDirty(fd, first - 1) != -1) {
+    first--;
+    count++;
+  }
+  while (count < MAX_WRITEBACK_SECTORS && CacheFindDirty(fd, first + count) != -1) count++;
+
+  char run[MAX_WRITEBACK_SECTORS * DISKIMG_SECTOR_SIZE];
+  int slots[MAX_WRITEBACK_SECTORS];
+  for (int i = 0; i < count; i++) {
+    slots[i] = CacheFind(fd, first + i);
+    memcpy(run + (size_t) i * DISKIMG_SECTOR_SIZE, cache.data + (size_t) slots[i] * DISKIMG_SECTOR_SIZE,
+           DISKIMG_SECTOR_SIZE);
+  }
+
+  cache.stats.writes++;
+  ssize_t bytesWritten = pwrite(fd, run, (size_t) count * DISKIMG_SECTOR_SIZE, (off_t) first * DISKIMG_SECTOR_SIZE);
+  if (bytesWritten != count * DISKIMG_SECTOR_SIZE) return -1;
+  cache.stats.writebacks += count;
+  for (int i = 0; i < count; i++) cache.entries[slots[i]].dirty = 0;
+  return 0;
+}
+
+/**
+ * Writes back every dirty sector of the image open on the specified descriptor, or of
+ * every image if fd is -1.  Returns 0 on success, or -1 if any write fails.
+ */
+static int CacheWriteBackAll(int fd) {
+  int err = 0;
+  for (int slot = cache.head; slot != -1; slot = cache.entries[slot].next) {
+    struct cacheentry *e = &cache.entries[slot];
+    if (e->dirty && (fd == -1 || e->fd == fd) && CacheWriteBack(slot) < 0) err = -1;
+  }
+  return err;
+}
+
+/**
+ * Caches a copy of the specified sector, evicting the least recently used one if
+ * the cache is full.  The sector mustn't already be cached.  A dirty sector is
+ * written back before it's evicted; if that fails, the write is lost, and the next
+ * diskimg_sync reports it.
+ */
+static void CacheInsert(int fd, int sectorNum, const void *buf, int dirty) {
+  int slot = cache.freeList;
+  if (slot != -1) {
+    cache.freeList = cache.entries[slot].next;
+  } else {
+    slot = cache.tail;
+    if (cache.entries[slot].dirty && CacheWriteBack(slot) < 0) cache.writeFailed = 1;
+    CacheUnlink(slot);
+    CacheUnchain(slot);
+    cache.stats.evictions++;
+  }
+
+  struct cacheentry *e = &cache.entries[slot];
+  e->fd = fd;
+  e->sectorNum = sectorNum;
+  e->dirty = dirty;
+  int bucket = CacheBucket(fd, sectorNum);
+  e->chain = cache.buckets[bucket];
+  cache.buckets[bucket] = slot;
+  CachePushFront(slot);
+  memcpy(cache.data + (size_t) slot * DISKIMG_SECTOR_SIZE, buf, DISKIMG_SECTOR_SIZE);
+}
+
+/**
+ * Drops every cached sector read or written through the specified descriptor.
+ * Dirty sectors must have been written back first.
+ */
+static void CacheForget(int fd) {
+  for (int slot = cache.head; slot != -1; ) {
+    int next = cache.entries[slot].next;
+    if (cache.entries[slot].fd == fd) CacheRemove(slot);
+    slot = next;
+  }
+}
+
+/**
+ * The images opened with diskimg_openmapped, each one mapped in its entirety.
+ */
+struct imagemap {
+  int fd;
+  char *base;
+  size_t size;
+};
+
+static struct imagemap *maps = NULL;
+static int numMaps = 0;
+
+/**
+ * Guards the sector cache and the table of mappings, so images can be read from
+ * several threads at once.  Disk I/O itself happens outside the lock, and uses
+ * pread and pwrite, so threads can share a descriptor.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Copies the mapping of the image open on the specified descriptor into map and
+ * returns 1, or returns 0 if the image wasn't opened with diskimg_openmapped.
+ */
+static int FindMap(int fd, struct imagemap *map) {
+  int found = 0;
+  pthread_mutex_lock(&lock);
+  for (int i = 0; i < numMaps; i++) {
+    if (maps[i].fd == fd) {
+      *map = maps[i];
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return found;
+}
+
+/**
+ * Returns the number of bytes of the specified sector the mapping holds (the last
+ * sector of an image may be short), 0 if the sector lies past the end of the image,
+ * or -1 if the sector number is negative.
+ */
+static int MappedBytes(const struct imagemap *map, int sectorNum) {
+  if (sectorNum < 0) return -1;
+  size_t offset = (size_t) sectorNum * DISKIMG_SECTOR_SIZE;
+  if (offset >= map->size) return 0;
+  return map->size - offset < DISKIMG_SECTOR_SIZE ? (int) (map->size - offset) : DISKIMG_SECTOR_SIZE;
+}
+
 int diskimg_open(char *pathname, int readOnly) {
   return open(pathname, readOnly ? O_RDONLY : O_RDWR);
 }
 
+int diskimg_create(char *pathname, int numSectors) {
+  if (numSectors < 0) return -1;
+  int fd = open(pathname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return -1;
+  if (ftruncate(fd, (off_t) numSectors * DISKIMG_SECTOR_SIZE) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int diskimg_openmapped(char *pathname) {
+  int fd = open(pathname, O_RDONLY);
+  if (fd < 0) return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  void *base = NULL;
+  if (st.st_size > 0) {
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+  }
+
+  pthread_mutex_lock(&lock);
+  struct imagemap *grown = realloc(maps, (numMaps + 1) * sizeof(struct imagemap));
+  if (grown == NULL) {
+    pthread_mutex_unlock(&lock);
+    if (base != NULL) munmap(base, st.st_size);
+    close(fd);
+    return -1;
+  }
+  maps = grown;
+  maps[numMaps].fd = fd;
+  maps[numMaps].base = base;
+  maps[numMaps].size = st.st_size;
+  numMaps++;
+  pthread_mutex_unlock(&lock);
+  return fd;
+}
+
 int diskimg_getsize(int fd) {
-  return lseek(fd, 0, SEEK_END);
+  struct stat st;
+  if (fstat(fd, &st) < 0) return -1;
+  return st.st_size;
 }
 
 int diskimg_readsector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) return -1;  
-  return read(fd, buf, DISKIMG_SECTOR_SIZE);
+  return diskimg_readsectors(fd, sectorNum, 1, buf);
+}
+
+int diskimg_readsectors(int fd, int firstSector, int count, void *buf) {
+  if (firstSector < 0 || count < 0) return -1;
+  char *out = buf;
+
+  struct imagemap map;
+  if (FindMap(fd, &map)) {
+    size_t offset = (size_t) firstSector * DISKIMG_SECTOR_SIZE;
+    if (offset >= map.size) return 0;
+    size_t bytesMapped = (size_t) count * DISKIMG_SECTOR_SIZE;
+    if (bytesMapped > map.size - offset) bytesMapped = map.size - offset;
+    memcpy(out, map.base + offset, bytesMapped);
+    return bytesMapped;
+  }
+
+  pthread_mutex_lock(&lock);
+  if (cache.capacity == -1 && CacheResize(DISKIMG_DEFAULT_CACHE_SECTORS) < 0) {
+    pthread_mutex_unlock(&lock);
+    return -1;
+  }
+
+  int done = 0; // sectors copied into buf so far
+  while (done < count) {
+    // Copy out the run of cached sectors at the front...
+    for (int slot; done < count && cache.capacity > 0 && (slot = CacheFind(fd, firstSector + done)) != -1; done++) {
+      cache.stats.hits++;
+      CacheUnlink(slot);
+      CachePushFront(slot);
+      memcpy(out + (size_t) done * DISKIMG_SECTOR_SIZE, cache.data + (size_t) slot * DISKIMG_SECTOR_SIZE,
+             DISKIMG_SECTOR_SIZE);
+    }
+    if (done == count) break;
+
+    // ...and then read the run of uncached sectors after it with a single system call
+    int run = 1;
+    while (done + run < count && (cache.capacity == 0 || CacheFind(fd, firstSector + done + run) == -1)) run++;
+    cache.stats.misses += run;
+    cache.stats.reads++;
+    pthread_mutex_unlock(&lock);
+
+    char *runStart = out + (size_t) done * DISKIMG_SECTOR_SIZE;
+    ssize_t bytesRead = pread(fd, runStart, (size_t) run * DISKIMG_SECTOR_SIZE,
+                              (off_t) (firstSector + done) * DISKIMG_SECTOR_SIZE);
+    if (bytesRead < 0) return -1;
+
+    // Another thread may have cached some of the sectors while this one was reading them
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < bytesRead / DISKIMG_SECTOR_SIZE && cache.capacity > 0; i++) {
+      if (CacheFind(fd, firstSector + done + i) == -1) {
+        CacheInsert(fd, firstSector + done + i, runStart + (size_t) i * DISKIMG_SECTOR_SIZE, 0);
+      }
+    }
+    if (bytesRead < run * DISKIMG_SECTOR_SIZE) {
+      pthread_mutex_unlock(&lock);
+      return done * DISKIMG_SECTOR_SIZE + bytesRead;
+    }
+    done += run;
+  }
+  pthread_mutex_unlock(&lock);
+  return count * DISKIMG_SECTOR_SIZE;
+}
+
+const void *diskimg_getsector(int fd, int sectorNum, void *buf) {
+  struct imagemap map;
+  if (FindMap(fd, &map)) {
+    if (MappedBytes(&map, sectorNum) != DISKIMG_SECTOR_SIZE) return NULL;
+    return map.base + (size_t) sectorNum * DISKIMG_SECTOR_SIZE;
+  }
+  return diskimg_readsector(fd, sectorNum, buf) == DISKIMG_SECTOR_SIZE ? buf : NULL;
 }
 
 int diskimg_writesector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) {
+  if (sectorNum < 0) return -1;
+
+  // Mapped images are read-only
+  struct imagemap map;
+  if (FindMap(fd, &map)) return -1;
+
+  pthread_mutex_lock(&lock);
+  if (cache.capacity == -1 && CacheResize(DISKIMG_DEFAULT_CACHE_SECTORS) < 0) {
+    pthread_mutex_unlock(&lock);
     return -1;
   }
 
-  return write(fd, buf, DISKIMG_SECTOR_SIZE);
+  // Write back: the sector reaches the disk when it's evicted or synced
+  if (cache.capacity > 0) {
+    int slot = CacheFind(fd, sectorNum);
+    if (slot == -1) {
+      CacheInsert(fd, sectorNum, buf, 1);
+    } else {
+      cache.entries[slot].dirty = 1;
+      CacheUnlink(slot);
+      CachePushFront(slot);
+      memcpy(cache.data + (size_t) slot * DISKIMG_SECTOR_SIZE, buf, DISKIMG_SECTOR_SIZE);
+    }
+    pthread_mutex_unlock(&lock);
+    return DISKIMG_SECTOR_SIZE;
+  }
+  cache.stats.writes++;
+  pthread_mutex_unlock(&lock);
+
+  int bytesWritten = pwrite(fd, buf, DISKIMG_SECTOR_SIZE, (off_t) sectorNum * DISKIMG_SECTOR_SIZE);
+  if (bytesWritten == DISKIMG_SECTOR_SIZE) {
+    pthread_mutex_lock(&lock);
+    cache.stats.writebacks++;
+    pthread_mutex_unlock(&lock);
+  }
+  return bytesWritten;
+}
+
+int diskimg_sync(int fd) {
+  pthread_mutex_lock(&lock);
+  int err = cache.capacity > 0 ? CacheWriteBackAll(fd) : 0;
+  if (cache.writeFailed) {
+    cache.writeFailed = 0;
+    err = -1;
+  }
+  pthread_mutex_unlock(&lock);
+  return err;
 }
 
 int diskimg_close(int fd) {
-  return close(fd);
+  pthread_mutex_lock(&lock);
+  for (int i = 0; i < numMaps; i++) {
+    if (maps[i].fd != fd) continue;
+    if (maps[i].base != NULL) munmap(maps[i].base, maps[i].size);
+    maps[i] = maps[--numMaps];
+    break;
+  }
+  int err = 0;
+  if (cache.capacity > 0) {
+    err = CacheWriteBackAll(fd);
+    CacheForget(fd);
+  }
+  pthread_mutex_unlock(&lock);
+  return close(fd) < 0 ? -1 : err;
+}
+
+int diskimg_setcachesize(int numSectors) {
+  if (numSectors < 0) return -1;
+  pthread_mutex_lock(&lock);
+  int err = CacheResize(numSectors);
+  pthread_mutex_unlock(&lock);
+  return err;
+}
+
+void diskimg_getcachestats(struct diskimg_cachestats *stats) {
+  pthread_mutex_lock(&lock);
+  *stats = cache.stats;
+  pthread_mutex_unlock(&lock);
 }
@@ -6,12 +6,50 @@
 // Size of a disk sector (e.g. block) in bytes.
 #define DISKIMG_SECTOR_SIZE 512
 
+// Number of sectors the sector cache holds unless diskimg_setcachesize says otherwise.
+#define DISKIMG_DEFAULT_CACHE_SECTORS 1024
+
+/**
+ * Counters kept by the sector cache.  A miss is a sector read that had to go to
+ * the disk image, a read is a system call issued for one or more such sectors, and
+ * an eviction is a cached sector dropped to make room for a newer one.  Likewise, a
+ * writeback is a sector written to the disk image, and a write is a system call
+ * issued for one or more of them.
+ */
+struct diskimg_cachestats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t reads;
+  uint64_t evictions;
+  uint64_t writebacks;
+  uint64_t writes;
+};
+
 /**
  * Opens a disk image for I/O. Returns an open file descriptor, or -1 if
- * unsuccessful.  
+ * unsuccessful.  The diskimg functions may be called from several threads at
+ * once, and threads may share a descriptor, since no function depends on its
+ * file offset.
  */
 int diskimg_open(char *pathname, int readOnly);
 
+/**
+ * Creates a disk image of numSectors zeroed sectors, replacing any file already at
+ * pathname, and opens it for reading and writing.  Returns an open file descriptor,
+ * or -1 if unsuccessful.
+ */
+int diskimg_create(char *pathname, int numSectors);
+
+/**
+ * Opens a disk image read-only and maps the whole of it into memory.  Returns an
+ * open file descriptor that works with every other diskimg function, or -1 if
+ * unsuccessful.  Sector reads from a mapped image are bounds-checked memcpys
+ * rather than system calls (and bypass the sector cache, which would only add a
+ * second copy), and diskimg_getsector hands out pointers straight into the
+ * mapping.  The mapping is released by diskimg_close.
+ */
+int diskimg_openmapped(char *pathname);
+
 /**
  * Returns the size of the disk imgage in bytes, or -1 if unsuccessful.
  */
@@ -19,20 +57,63 @@ int diskimg_getsize(int fd);
 
 /**
  * Reads the specified sector (e.g. block) from the disk.  Returns the number of bytes read,
- * or -1 on error.
+ * or -1 on error.  Sectors are served from an LRU cache of recently read sectors
+ * whenever possible, so reading the same sector repeatedly costs one system call.
  */
 int diskimg_readsector(int fd, int sectorNum, void *buf); 
 
+/**
+ * Reads count consecutive sectors, starting at firstSector, into buf, which must
+ * hold count * DISKIMG_SECTOR_SIZE bytes.  Returns the number of bytes read, which
+ * falls short only at the end of the disk image, or -1 on error.  Cached sectors
+ * are copied from the cache, and each run of uncached ones is read with a single
+ * system call.
+ */
+int diskimg_readsectors(int fd, int firstSector, int count, void *buf);
+
+/**
+ * Zero-copy form of diskimg_readsector, for callers that only need to look at a
+ * sector.  If the image was opened with diskimg_openmapped, returns a pointer to the
+ * sector inside the mapping, and buf is untouched.  Otherwise the sector is read into
+ * buf (which must hold DISKIMG_SECTOR_SIZE bytes) and buf is returned.  Returns NULL
+ * if a full sector can't be read.  Either way, the pointer is read-only, and is valid
+ * until buf is reused or the image is closed.
+ */
+const void *diskimg_getsector(int fd, int sectorNum, void *buf);
+
 /**
  * Writes the specified sector from the disk.  Returns the number of bytes
- * written, or -1 on error.
+ * written, or -1 on error.  Writes are write-back: the sector is only stored in
+ * the cache, and marked dirty, and reaches the disk image when it's evicted or when
+ * diskimg_sync or diskimg_close is called, together with any dirty sectors next to
+ * it.  With the cache turned off, the write goes straight to the disk.  Images
+ * opened with diskimg_openmapped can't be written.
  */
 int diskimg_writesector(int fd, int sectorNum, void *buf); 
 
 /**
- * Clean up from a previous diskimg_open() call.  Returns 0 on success, or -1 on
- * error.
+ * Writes every dirty sector of the specified image to the disk image, in runs of
+ * consecutive sectors.  Returns 0 on success, or -1 if any write failed, here or
+ * while a dirty sector was being evicted since the last diskimg_sync.
+ */
+int diskimg_sync(int fd);
+
+/**
+ * Clean up from a previous diskimg_open() call, writing back and then dropping any
+ * sectors cached from it.  Returns 0 on success, or -1 on error.
  */
 int diskimg_close(int fd);
 
+/**
+ * Sets the number of sectors the cache holds, emptying it in the process (dirty
+ * sectors are written back first).  A size of 0 turns the cache off.  Returns 0
+ * on success, or -1 on error.
+ */
+int diskimg_setcachesize(int numSectors);
+
+/**
+ * Copies the cache's counters, accumulated since the program started, into stats.
+ */
+void diskimg_getcachestats(struct diskimg_cachestats *stats);
+
 #endif // _DISKIMG_H_
@@ -1,11 +1,30 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "file.h"
 #include "inode.h"
 #include "diskimg.h"
+#include "directory.h"
+#include "alloc.h"
+
+static const int kUInt16CountPerSector = 256; // Count of uint16_t values per Sector
+static const int kMaxBlocksBeforeDoublyIndirectBlock = 1792; // Blocks reached through i_addr[0..6]
+static const int kMaxFileSize = (1 << 24) - 1; // The size field is three bytes
+static const int kMaxLinks = 255; // i_nlink is a single byte
 
 int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *buf) {
+  const void *data;
+  int bytesValid = file_getblockptr(fs, inumber, blockNum, buf, &data);
+  if (bytesValid >= 0 && data != buf) {
+    memcpy(buf, data, DISKIMG_SECTOR_SIZE);
+  }
+  return bytesValid;
+}
+
+int file_getblockptr(struct unixfilesystem *fs, int inumber, int blockNum, void *buf, const void **data) {
   struct inode node;
   inode_iget(fs, inumber, &node);
 
@@ -15,7 +34,10 @@ int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *bu
     return -1;
   }
 
-  diskimg_readsector(fs->dfd, blockIndex, buf);
+  *data = diskimg_getsector(fs->dfd, blockIndex, buf);
+  if (*data == NULL) {
+    return -1;
+  }
 
   // If reading last block of iNode, not neccessarily 512 bytes
   if ((blockNum + ROOT_INUMBER) * DISKIMG_SECTOR_SIZE > inode_getsize(&node)) {
@@ -24,3 +46,401 @@ int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *bu
 
   return DISKIMG_SECTOR_SIZE;
 }
+
+struct filehandle {
+  struct unixfilesystem *fs;
+  struct inode node;
+  int size;
+  int offset;       // next byte file_read returns
+  int nextBlock;    // the block a sequential reader asks for next
+  int readahead;    // blocks the next window fill reads
+  int windowFirst;  // file block held at the start of window
+  int windowBlocks; // blocks held in window
+  char window[FILE_READAHEAD_BLOCKS * DISKIMG_SECTOR_SIZE];
+};
+
+static const int kInitialReadahead = 4;
+
+/**
+ * Reads count blocks of the specified file, starting at firstBlock, into dest, with
+ * one diskimg_readsectors call per run of physically contiguous blocks.  Returns 0
+ * on success, -1 on error.
+ */
+static int ReadBlocks(struct filehandle *f, int firstBlock, int count, char *dest) {
+  int endBlock = firstBlock + count;
+  int physical = inode_indexlookup(f->fs, &f->node, firstBlock);
+  for (int bno = firstBlock; bno < endBlock; ) {
+    if (physical < 0) return -1;
+    int run = 1;
+    int nextPhysical = -1;
+    while (bno + run < endBlock && (nextPhysical = inode_indexlookup(f->fs, &f->node, bno + run)) == physical + run) {
+      run++;
+    }
+
+    char *runStart = dest + (size_t) (bno - firstBlock) * DISKIMG_SECTOR_SIZE;
+    if (diskimg_readsectors(f->fs->dfd, physical, run, runStart) != run * DISKIMG_SECTOR_SIZE) return -1;
+    bno += run;
+    physical = nextPhysical;
+  }
+  return 0;
+}
+
+struct filehandle *file_open(struct unixfilesystem *fs, int inumber) {
+  struct filehandle *f = malloc(sizeof(struct filehandle));
+  if (f == NULL) {
+    return NULL;
+  }
+
+  if (inode_iget(fs, inumber, &f->node) < 0 || !(f->node.i_mode & IALLOC)) {
+    free(f);
+    return NULL;
+  }
+
+  f->fs = fs;
+  f->size = inode_getsize(&f->node);
+  f->offset = 0;
+  f->nextBlock = 0;
+  f->readahead = kInitialReadahead;
+  f->windowFirst = 0;
+  f->windowBlocks = 0;
+  return f;
+}
+
+int file_read(struct filehandle *f, void *buf, int len) {
+  if (len < 0) return -1;
+  if (len > f->size - f->offset) len = f->size - f->offset;
+
+  char *out = buf;
+  int total = 0;
+  while (total < len) {
+    int block = f->offset / DISKIMG_SECTOR_SIZE;
+
+    // Serve whatever the window already holds
+    if (block >= f->windowFirst && block < f->windowFirst + f->windowBlocks) {
+      int windowOffset = f->offset - f->windowFirst * DISKIMG_SECTOR_SIZE;
+      int count = f->windowBlocks * DISKIMG_SECTOR_SIZE - windowOffset;
+      if (count > len - total) count = len - total;
+      memcpy(out + total, f->window + windowOffset, count);
+      total += count;
+      f->offset += count;
+      continue;
+    }
+
+    // Whole blocks go straight into the caller's buffer
+    int wholeBlocks = f->offset % DISKIMG_SECTOR_SIZE == 0 ? (len - total) / DISKIMG_SECTOR_SIZE : 0;
+    if (wholeBlocks > 0) {
+      if (ReadBlocks(f, block, wholeBlocks, out + total) < 0) return -1;
+      total += wholeBlocks * DISKIMG_SECTOR_SIZE;
+      f->offset += wholeBlocks * DISKIMG_SECTOR_SIZE;
+      f->nextBlock = block + wholeBlocks;
+      continue;
+    }
+
+    // Refill the window, reading further ahead the longer the reads stay sequential
+    if (block != f->nextBlock) f->readahead = 1;
+    int numBlocks = (f->size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+    int count = f->readahead < numBlocks - block ? f->readahead : numBlocks - block;
+    f->windowBlocks = 0;
+    if (ReadBlocks(f, block, count, f->window) < 0) return -1;
+    f->windowFirst = block;
+    f->windowBlocks = count;
+    f->nextBlock = block + count;
+    if (f->readahead < FILE_READAHEAD_BLOCKS) f->readahead *= 2;
+  }
+  return total;
+}
+
+int file_seek(struct filehandle *f, int offset) {
+  if (offset < 0 || offset > f->size) return -1;
+  f->offset = offset;
+  return 0;
+}
+
+void file_close(struct filehandle *f) {
+  free(f);
+}
+
+/**
+ * Sets the file's access and modification times to now.  Like any V6 time, each is
+ * a 32-bit count of seconds stored as two 16-bit words, the high one first.
+ */
+static void Touch(struct inode *node) {
+  uint32_t now = time(NULL);
+  node->i_atime[0] = node->i_mtime[0] = now >> 16;
+  node->i_atime[1] = node->i_mtime[1] = now & 0xffff;
+}
+
+/**
+ * Allocates a block for use as an indirect block, and clears it.  Returns its
+ * number, or -1 on error.
+ */
+static int NewIndirectBlock(struct unixfilesystem *fs) {
+  int blockNum = alloc_block(fs);
+  if (blockNum < 0) return -1;
+  uint16_t zeros[kUInt16CountPerSector];
+  memset(zeros, 0, sizeof(zeros));
+  if (diskimg_writesector(fs->dfd, blockNum, zeros) != DISKIMG_SECTOR_SIZE) {
+    alloc_freeblock(fs, blockNum);
+    return -1;
+  }
+  return blockNum;
+}
+
+/**
+ * Stores value in entry index of the specified indirect block.  Returns 0 on
+ * success, -1 on error.
+ */
+static int SetIndirectEntry(struct unixfilesystem *fs, int indirectBlock, int index, int value) {
+  uint16_t entries[kUInt16CountPerSector];
+  if (diskimg_readsector(fs->dfd, indirectBlock, entries) != DISKIMG_SECTOR_SIZE) return -1;
+  entries[index] = value;
+  return diskimg_writesector(fs->dfd, indirectBlock, entries) == DISKIMG_SECTOR_SIZE ? 0 : -1;
+}
+
+/**
+ * Maps the specified file block, the first one past the end of the file, to
+ * blockNum, allocating indirect blocks as they're needed.  A small file that grows
+ * past 8 blocks becomes a large one: its block numbers move into its first
+ * indirect block.  Changes only the in-memory copy of the inode, which the caller
+ * writes back.  Returns 0 on success, -1 on error.
+ */
+static int MapNewBlock(struct unixfilesystem *fs, struct inode *node, int fileBlock, int blockNum) {
+  if ((node->i_mode & ILARG) == 0) {
+    if (fileBlock < 8) {
+      node->i_addr[fileBlock] = blockNum;
+      return 0;
+    }
+
+    int indirect = NewIndirectBlock(fs);
+    if (indirect < 0) return -1;
+    uint16_t entries[kUInt16CountPerSector];
+    memset(entries, 0, sizeof(entries));
+    memcpy(entries, node->i_addr, sizeof(node->i_addr));
+    if (diskimg_writesector(fs->dfd, indirect, entries) != DISKIMG_SECTOR_SIZE) {
+      alloc_freeblock(fs, indirect);
+      return -1;
+    }
+    memset(node->i_addr, 0, sizeof(node->i_addr));
+    node->i_addr[0] = indirect;
+    node->i_mode |= ILARG;
+  }
+
+  // Singly indirect blocks hang off i_addr[0..6]...
+  if (fileBlock < kMaxBlocksBeforeDoublyIndirectBlock) {
+    int slot = fileBlock / kUInt16CountPerSector;
+    if (node->i_addr[slot] == 0) {
+      int indirect = NewIndirectBlock(fs);
+      if (indirect < 0) return -1;
+      node->i_addr[slot] = indirect;
+    }
+    return SetIndirectEntry(fs, node->i_addr[slot], fileBlock % kUInt16CountPerSector, blockNum);
+  }
+
+  // ...and the rest off the doubly indirect block in i_addr[7]
+  if (node->i_addr[7] == 0) {
+    int doubly = NewIndirectBlock(fs);
+    if (doubly < 0) return -1;
+    node->i_addr[7] = doubly;
+  }
+  uint16_t singles[kUInt16CountPerSector];
+  if (diskimg_readsector(fs->dfd, node->i_addr[7], singles) != DISKIMG_SECTOR_SIZE) return -1;
+  int slot = (fileBlock - kMaxBlocksBeforeDoublyIndirectBlock) / kUInt16CountPerSector;
+  if (singles[slot] == 0) {
+    int indirect = NewIndirectBlock(fs);
+    if (indirect < 0) return -1;
+    if (SetIndirectEntry(fs, node->i_addr[7], slot, indirect) < 0) {
+      alloc_freeblock(fs, indirect);
+      return -1;
+    }
+    singles[slot] = indirect;
+  }
+  return SetIndirectEntry(fs, singles[slot], fileBlock % kUInt16CountPerSector, blockNum);
+}
+
+int file_append(struct unixfilesystem *fs, int inumber, const void *buf, int len) {
+  struct inode node;
+  if (len < 0 || inode_iget(fs, inumber, &node) < 0 || !(node.i_mode & IALLOC)) {
+    return -1;
+  }
+
+  const char *in = buf;
+  int size = inode_getsize(&node);
+  if (len > kMaxFileSize - size) len = kMaxFileSize - size;
+  int total = 0;
+
+  // Top up a partly filled last block...
+  int tailOffset = size % DISKIMG_SECTOR_SIZE;
+  if (tailOffset != 0 && len > 0) {
+    char sector[DISKIMG_SECTOR_SIZE];
+    int blockNum = inode_indexlookup(fs, &node, size / DISKIMG_SECTOR_SIZE);
+    if (blockNum < 0 || diskimg_readsector(fs->dfd, blockNum, sector) != DISKIMG_SECTOR_SIZE) {
+      return -1;
+    }
+    total = DISKIMG_SECTOR_SIZE - tailOffset < len ? DISKIMG_SECTOR_SIZE - tailOffset : len;
+    memcpy(sector + tailOffset, in, total);
+    if (diskimg_writesector(fs->dfd, blockNum, sector) != DISKIMG_SECTOR_SIZE) {
+      return -1;
+    }
+  }
+
+  // ...and put the rest in new blocks, stopping short if the disk fills up
+  while (total < len) {
+    int blockNum = alloc_block(fs);
+    if (blockNum < 0) break;
+    if (MapNewBlock(fs, &node, (size + total) / DISKIMG_SECTOR_SIZE, blockNum) < 0) {
+      alloc_freeblock(fs, blockNum);
+      break;
+    }
+
+    char sector[DISKIMG_SECTOR_SIZE];
+    int count = DISKIMG_SECTOR_SIZE < len - total ? DISKIMG_SECTOR_SIZE : len - total;
+    memcpy(sector, in + total, count);
+    memset(sector + count, 0, DISKIMG_SECTOR_SIZE - count);
+    if (diskimg_writesector(fs->dfd, blockNum, sector) != DISKIMG_SECTOR_SIZE) break;
+    total += count;
+  }
+
+  inode_setsize(&node, size + total);
+  Touch(&node);
+  if (inode_iput(fs, inumber, &node) < 0) {
+    return -1;
+  }
+  return total > 0 || len == 0 ? total : -1;
+}
+
+/**
+ * Frees the specified indirect block and every block it lists.
+ */
+static void FreeIndirectBlock(struct unixfilesystem *fs, int indirectBlock) {
+  uint16_t entries[kUInt16CountPerSector];
+  if (diskimg_readsector(fs->dfd, indirectBlock, entries) == DISKIMG_SECTOR_SIZE) {
+    for (int i = kUInt16CountPerSector - 1; i >= 0; i--) {
+      if (entries[i] != 0) alloc_freeblock(fs, entries[i]);
+    }
+  }
+  alloc_freeblock(fs, indirectBlock);
+}
+
+/**
+ * Frees every block of the specified file, last block first (as V6's itrunc did,
+ * so that they're handed out again in ascending order), then clears the inode,
+ * writes it back and frees it.  Returns 0 on success, -1 on error.
+ */
+static int FreeFile(struct unixfilesystem *fs, int inumber, struct inode *node) {
+  if ((node->i_mode & ILARG) == 0) {
+    int numBlocks = (inode_getsize(node) + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+    for (int i = (numBlocks < 8 ? numBlocks : 8) - 1; i >= 0; i--) {
+      if (node->i_addr[i] != 0) alloc_freeblock(fs, node->i_addr[i]);
+    }
+  } else {
+    if (node->i_addr[7] != 0) {
+      uint16_t singles[kUInt16CountPerSector];
+      if (diskimg_readsector(fs->dfd, node->i_addr[7], singles) == DISKIMG_SECTOR_SIZE) {
+        for (int i = kUInt16CountPerSector - 1; i >= 0; i--) {
+          if (singles[i] != 0) FreeIndirectBlock(fs, singles[i]);
+        }
+      }
+      alloc_freeblock(fs, node->i_addr[7]);
+    }
+    for (int i = 6; i >= 0; i--) {
+      if (node->i_addr[i] != 0) FreeIndirectBlock(fs, node->i_addr[i]);
+    }
+  }
+
+  memset(node, 0, sizeof(*node));
+  if (inode_iput(fs, inumber, node) < 0) {
+    return -1;
+  }
+  alloc_freeinode(fs, inumber);
+  return 0;
+}
+
+int file_create(struct unixfilesystem *fs, int dirinumber, const char *name, int mode) {
+  struct direntv6 existing;
+  if (strlen(name) == 0 || strlen(name) > sizeof(existing.d_name) || strchr(name, '/') != NULL ||
+      directory_findname(fs, name, dirinumber, &existing) == 0) {
+    return -1;
+  }
+
+  // A new directory's ".." links to its parent, which can't take more links than i_nlink holds
+  int isDirectory = (mode & IFMT) == IFDIR;
+  struct inode parent;
+  if (isDirectory && (inode_iget(fs, dirinumber, &parent) < 0 || parent.i_nlink >= kMaxLinks)) {
+    return -1;
+  }
+
+  int inumber = alloc_inode(fs);
+  if (inumber < 0) {
+    return -1;
+  }
+
+  struct inode node;
+  memset(&node, 0, sizeof(node));
+  node.i_mode = IALLOC | (mode & ~(IALLOC | ILARG));
+  node.i_nlink = 1;
+  Touch(&node);
+  if (isDirectory) {
+    node.i_nlink = 2; // its entry in the parent, and its own "."
+  }
+  if (inode_iput(fs, inumber, &node) < 0) {
+    return -1;
+  }
+
+  if (isDirectory) {
+    struct direntv6 dots[2];
+    memset(dots, 0, sizeof(dots));
+    dots[0].d_inumber = inumber;
+    strcpy(dots[0].d_name, ".");
+    dots[1].d_inumber = dirinumber;
+    strcpy(dots[1].d_name, "..");
+    if (file_append(fs, inumber, dots, sizeof(dots)) != sizeof(dots)) {
+      inode_iget(fs, inumber, &node);
+      FreeFile(fs, inumber, &node);
+      return -1;
+    }
+  }
+
+  if (directory_addentry(fs, dirinumber, name, inumber) < 0) {
+    inode_iget(fs, inumber, &node);
+    FreeFile(fs, inumber, &node);
+    return -1;
+  }
+
+  // The new directory's ".." is another link to its parent.  Adding the entry changed
+  // the parent's size, so it's read again, and if it can't be written the create is undone.
+  if (isDirectory) {
+    int err = inode_iget(fs, dirinumber, &parent) < 0 || parent.i_nlink >= kMaxLinks ? -1 : 0;
+    if (err == 0) {
+      parent.i_nlink++;
+      err = inode_iput(fs, dirinumber, &parent);
+    }
+    if (err < 0) {
+      directory_removeentry(fs, dirinumber, name);
+      inode_iget(fs, inumber, &node);
+      FreeFile(fs, inumber, &node);
+      return -1;
+    }
+  }
+  return inumber;
+}
+
+int file_unlink(struct unixfilesystem *fs, int dirinumber, const char *name) {
+  struct direntv6 entry;
+  if (directory_findname(fs, name, dirinumber, &entry) < 0) {
+    return -1;
+  }
+
+  struct inode node;
+  if (inode_iget(fs, entry.d_inumber, &node) < 0 || (node.i_mode & IFMT) == IFDIR) {
+    return -1;
+  }
+  if (directory_removeentry(fs, dirinumber, name) < 0) {
+    return -1;
+  }
+
+  if (node.i_nlink > 0) node.i_nlink--;
+  if (node.i_nlink > 0) {
+    return inode_iput(fs, entry.d_inumber, &node);
+  }
+  return FreeFile(fs, entry.d_inumber, &node);
+}
@@ -3,10 +3,90 @@
 
 #include "unixfilesystem.h"
 
+// Most blocks a file handle reads ahead of a sequential reader.
+#define FILE_READAHEAD_BLOCKS 32
+
+/**
+ * An open file, as returned by file_open.  Its fields are private to file.c.
+ */
+struct filehandle;
+
 /**
  * Fetches the specified file block from the specified inode.
  * Returns the number of valid bytes in the block, -1 on error.
  */
 int file_getblock(struct unixfilesystem *fs, int inumber, int blockNo, void *buf); 
 
+/**
+ * Zero-copy form of file_getblock.  Points *data at the block's contents, which
+ * live inside the disk image's mapping if it was opened with diskimg_openmapped,
+ * and in buf (DISKIMG_SECTOR_SIZE bytes) otherwise.  The contents are read-only.
+ * Returns the number of valid bytes in the block, -1 on error.
+ */
+int file_getblockptr(struct unixfilesystem *fs, int inumber, int blockNo, void *buf, const void **data);
+
+/**
+ * Opens the specified inode for reading, with the offset at the start of the file.
+ * The inode is read once, here, rather than once per block.  Returns a handle that
+ * must be passed to file_close, or NULL if the inode can't be read or isn't allocated.
+ */
+struct filehandle *file_open(struct unixfilesystem *fs, int inumber);
+
+/**
+ * Reads up to len bytes from the handle's offset into buf, and advances the offset
+ * past them.  Returns the number of bytes read, which is 0 at the end of the file,
+ * or -1 on error.
+ *
+ * Whole blocks the caller asks for are read straight into buf.  Anything else comes
+ * through a read-ahead window, which grows (up to FILE_READAHEAD_BLOCKS blocks) for
+ * as long as each read picks up where the last one left off, and shrinks back to a
+ * single block when one doesn't.  Either way, runs of physically contiguous blocks
+ * are read with one diskimg_readsectors call.
+ */
+int file_read(struct filehandle *f, void *buf, int len);
+
+/**
+ * Moves the handle's offset to the specified byte of the file.  Returns 0 on
+ * success, or -1 if the offset lies outside the file.
+ */
+int file_seek(struct filehandle *f, int offset);
+
+/**
+ * Releases a handle returned by file_open.
+ */
+void file_close(struct filehandle *f);
+
+/**
+ * The functions below change the filesystem.  Blocks and inodes come from the free
+ * lists (see alloc.h), and every sector goes through the sector cache, which holds
+ * on to it until it's evicted or synced, so call unixfilesystem_sync when done.
+ * None of them may run at the same time as any other call on the filesystem, and a
+ * handle opened before a file changes goes on seeing the file as it was.
+ */
+
+/**
+ * Creates an empty file named name in the specified directory (dirinumber), with
+ * the specified mode: permission bits, plus IFDIR for a directory, which gets its
+ * "." and ".." entries.  Returns the new file's inumber, or -1 if there's already
+ * an entry by that name, the name is too long, the disk is out of inodes or
+ * blocks, or (for a directory) the parent already has the 255 links its one-byte
+ * link count can record.
+ */
+int file_create(struct unixfilesystem *fs, int dirinumber, const char *name, int mode);
+
+/**
+ * Appends len bytes from buf to the end of the specified file, allocating blocks
+ * (and indirect blocks) as needed.  Returns the number of bytes appended, which
+ * falls short if the disk fills up or the file reaches its largest possible size
+ * (just under 16MB), or -1 if nothing could be appended.
+ */
+int file_append(struct unixfilesystem *fs, int inumber, const void *buf, int len);
+
+/**
+ * Removes the entry named name from the specified directory.  Once no entries name
+ * the file any more, its blocks and its inode are freed.  Directories can't be
+ * unlinked.  Returns 0 on success, or -1 on error.
+ */
+int file_unlink(struct unixfilesystem *fs, int dirinumber, const char *name);
+
 #endif // _FILE_H_
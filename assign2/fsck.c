@@ -0,0 +1,473 @@
+/**
+ * Checks the consistency of each of the specified disk images, without changing
+ * them, in three passes:
+ *
+ * 1. A sequential pass over the inodes, marking every block an allocated file uses
+ *    (its data blocks and its indirect blocks) in a bitmap.  A block marked twice
+ *    belongs to two files, or appears twice in one.
+ * 2. A pass over the directory tree from the root, counting the entries that name
+ *    each inode, and checking "." and "..".  Link counts that don't match the count,
+ *    and allocated inodes no directory names, are reported.
+ * 3. A walk of the free block list.  Blocks both in use and free, free twice, or
+ *    neither in use nor free (orphaned) are reported.
+ *
+ * The inodes are read in large runs, and pass 1 keeps a copy of every directory's
+ * inode, so pass 2 walks the tree without going back to the inode area.  Every other
+ * sector is read when it's first needed, so the only sectors read twice are the
+ * indirect blocks of large directories, when the cache has let them go between
+ * passes 1 and 2 (-s shows the counts).  Problems are printed one per line, prefixed with the image's path,
+ * followed by a summary line per image.  The exit status is 0 if every image is
+ * consistent, 1 if any has problems, and 2 if any couldn't be read at all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "inode.h"
+#include "directory.h"
+
+// Longest pathname reported
+#define MAXPATH 1024
+
+static const int kINodeCountPerSector = 16;
+static const int kUInt16CountPerSector = 256;
+static const int kMaxBlocksBeforeDoublyIndirectBlock = 1792;
+static const int kPrefetchSectors = 32; // Inode sectors read with one call
+
+int quietFlag = 0;
+int statsFlag = 0;
+int mapFlag = 0;
+
+/**
+ * What's known about one disk image as it's checked.
+ */
+struct scan {
+  struct unixfilesystem *fs;
+  const char *diskpath;
+  int numInodes;
+  int firstDataBlock;
+  int numBlocks;
+  uint16_t *modes;      // of each inode, indexed by inumber, 0 if unallocated
+  uint8_t *nlinks;      // link count each inode claims
+  int *dirSlots;        // 1 + index into dirs of each directory inode, 0 if not a directory
+  struct inode *dirs;   // copies of the directory inodes, as pass 1 read them
+  int numDirs;
+  int *refs;            // directory entries found naming each inode
+  uint8_t *visited;     // bitmap of the directories the tree pass has entered
+  uint8_t *inUse;       // bitmap of the blocks files use
+  uint8_t *free;        // bitmap of the blocks on the free list
+  int numFiles;
+  int numInUse;
+  int numFree;
+  int numProblems;
+};
+
+static void PrintUsageAndExit(char *progname);
+
+static void Problem(struct scan *s, const char *format, ...) {
+  s->numProblems++;
+  if (quietFlag) return;
+  va_list args;
+  va_start(args, format);
+  printf("%s: ", s->diskpath);
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+}
+
+/**
+ * Sets bit n of the specified bitmap, returning whether it was already set.
+ */
+static int TestAndSet(uint8_t *bits, int n) {
+  int wasSet = (bits[n / 8] >> (n % 8)) & 1;
+  bits[n / 8] |= 1 << (n % 8);
+  return wasSet;
+}
+
+static int IsSet(const uint8_t *bits, int n) {
+  return (bits[n / 8] >> (n % 8)) & 1;
+}
+
+/**
+ * Marks the specified block as used by the specified inode.  Returns 0 if it's a
+ * block of the data area, whether or not another file already uses it, and -1 if
+ * it isn't, in which case nothing should be read from it.
+ */
+static int ClaimBlock(struct scan *s, int inumber, int blockNum) {
+  if (blockNum < s->firstDataBlock || blockNum >= s->numBlocks) {
+    Problem(s, "inode %d uses block %d, which is outside the data area", inumber, blockNum);
+    return -1;
+  }
+  if (TestAndSet(s->inUse, blockNum)) {
+    Problem(s, "inode %d uses block %d, which is already in use", inumber, blockNum);
+  } else {
+    s->numInUse++;
+  }
+  return 0;
+}
+
+/**
+ * Marks every block of the specified file as in use: its indirect blocks first, so a
+ * damaged one isn't followed, then its data blocks, as inode_indexlookup finds them.
+ */
+static void ClaimFileBlocks(struct scan *s, int inumber, struct inode *in) {
+  int numBlocks = (inode_getsize(in) + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+  if ((in->i_mode & ILARG) == 0) {
+    if (numBlocks > 8) {
+      Problem(s, "inode %d is a small file of %d bytes, more than its 8 blocks hold", inumber, inode_getsize(in));
+      numBlocks = 8;
+    }
+    for (int bno = 0; bno < numBlocks; bno++) ClaimBlock(s, inumber, in->i_addr[bno]);
+    return;
+  }
+
+  int followable = 1;
+  int singlyBlocks = numBlocks < kMaxBlocksBeforeDoublyIndirectBlock ? numBlocks : kMaxBlocksBeforeDoublyIndirectBlock;
+  for (int i = 0; i * kUInt16CountPerSector < singlyBlocks; i++) {
+    if (ClaimBlock(s, inumber, in->i_addr[i]) < 0) followable = 0;
+  }
+  if (numBlocks > kMaxBlocksBeforeDoublyIndirectBlock) {
+    char buffer[DISKIMG_SECTOR_SIZE];
+    const uint16_t *singles = NULL;
+    if (ClaimBlock(s, inumber, in->i_addr[7]) == 0) {
+      singles = diskimg_getsector(s->fs->dfd, in->i_addr[7], buffer);
+    }
+    for (int i = 0; singles != NULL && i * kUInt16CountPerSector < numBlocks - kMaxBlocksBeforeDoublyIndirectBlock; i++) {
+      if (ClaimBlock(s, inumber, singles[i]) < 0) followable = 0;
+    }
+    if (singles == NULL) followable = 0;
+  }
+  if (!followable) {
+    return;
+  }
+
+  for (int bno = 0; bno < numBlocks; bno++) {
+    int blockNum = inode_indexlookup(s->fs, in, bno);
+    if (blockNum < 0) {
+      Problem(s, "can't find block %d of inode %d", bno, inumber);
+      return;
+    }
+    ClaimBlock(s, inumber, blockNum);
+  }
+}
+
+/**
+ * Pass 1: reads every inode, in order, noting what it says about itself and
+ * claiming its blocks.  The inode sectors are read kPrefetchSectors at a time, which
+ * leaves them in the sector cache for inode_iget, and directory inodes are kept for
+ * pass 2, by which time the cache may have let their sectors go.  Returns 0, or -1 if
+ * there's no memory to keep a directory inode in.
+ */
+static int ScanInodes(struct scan *s) {
+  int isize = s->fs->superblock.s_isize;
+  for (int inumber = 1; inumber <= s->numInodes; inumber++) {
+    int sector = (inumber - 1) / kINodeCountPerSector;
+    if ((inumber - 1) % kINodeCountPerSector == 0 && sector % kPrefetchSectors == 0) {
+      char buffer[kPrefetchSectors * DISKIMG_SECTOR_SIZE];
+      int count = isize - sector < kPrefetchSectors ? isize - sector : kPrefetchSectors;
+      diskimg_readsectors(s->fs->dfd, INODE_START_SECTOR + sector, count, buffer);
+    }
+
+    struct inode in;
+    if (inode_iget(s->fs, inumber, &in) < 0) {
+      Problem(s, "can't read inode %d", inumber);
+      continue;
+    }
+    if ((in.i_mode & IALLOC) == 0) {
+      continue;
+    }
+    s->modes[inumber] = in.i_mode;
+    s->nlinks[inumber] = in.i_nlink;
+    s->numFiles++;
+    if ((in.i_mode & IFMT) == IFDIR) {
+      if ((s->numDirs & (s->numDirs - 1)) == 0) {
+        struct inode *dirs = realloc(s->dirs, (s->numDirs == 0 ? 1 : 2 * s->numDirs) * sizeof(struct inode));
+        if (dirs == NULL) return -1;
+        s->dirs = dirs;
+      }
+      s->dirs[s->numDirs++] = in;
+      s->dirSlots[inumber] = s->numDirs;
+    }
+    if ((in.i_mode & IFMT) != IFCHR && (in.i_mode & IFMT) != IFBLK) {
+      ClaimFileBlocks(s, inumber, &in);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Pass 2: counts the entries naming each inode in the specified directory and,
+ * recursively, the directories below it, checking that "." names the directory
+ * itself and ".." its parent.
+ */
+static void ScanDirectory(struct scan *s, int dirinumber, int parent, const char *path) {
+  struct directory_iter it;
+  if (directory_iterinode(s->fs, &s->dirs[s->dirSlots[dirinumber] - 1], &it) < 0) {
+    Problem(s, "can't read directory %s (inode %d)", path, dirinumber);
+    return;
+  }
+
+  int sawDot = 0;
+  int sawDotDot = 0;
+  const struct direntv6 *dirEnt;
+  int more;
+  while ((more = directory_iternext(&it, &dirEnt)) > 0) {
+    char name[sizeof(dirEnt->d_name) + 1];
+    memcpy(name, dirEnt->d_name, sizeof(dirEnt->d_name));
+    name[sizeof(dirEnt->d_name)] = '\0';
+    int inumber = dirEnt->d_inumber;
+    const char *sep = path[1] == '\0' ? "" : "/";
+    if (inumber > s->numInodes || s->modes[inumber] == 0) {
+      Problem(s, "%s%s%s names inode %d, which isn't allocated", path, sep, name, inumber);
+      continue;
+    }
+    s->refs[inumber]++;
+
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      int expected = name[1] == '\0' ? dirinumber : parent;
+      if (inumber != expected) {
+        Problem(s, "%s%s%s names inode %d rather than %d", path, sep, name, inumber, expected);
+      }
+      if (name[1] == '\0') sawDot = 1; else sawDotDot = 1;
+      continue;
+    }
+    if ((s->modes[inumber] & IFMT) != IFDIR) {
+      continue;
+    }
+
+    char childpath[MAXPATH];
+    snprintf(childpath, sizeof(childpath), "%s%s%s", path, sep, name);
+    if (TestAndSet(s->visited, inumber)) {
+      Problem(s, "%s is another name for directory inode %d", childpath, inumber);
+      continue;
+    }
+    ScanDirectory(s, inumber, dirinumber, childpath);
+  }
+
+  if (more < 0) {
+    Problem(s, "error reading directory %s", path);
+  }
+  if (!sawDot || !sawDotDot) {
+    Problem(s, "directory %s has no %s entry", path, sawDot ? "\"..\"" : "\".\"");
+  }
+}
+
+/**
+ * Compares the link count of every allocated inode with the entries naming it.
+ */
+static void CheckLinks(struct scan *s) {
+  for (int inumber = 1; inumber <= s->numInodes; inumber++) {
+    if (s->modes[inumber] == 0) continue;
+    if (s->refs[inumber] == 0) {
+      Problem(s, "inode %d is allocated, but no directory names it", inumber);
+    } else if (s->refs[inumber] != s->nlinks[inumber]) {
+      Problem(s, "inode %d has %d links, but %d directory entries name it", inumber, s->nlinks[inumber],
+              s->refs[inumber]);
+    }
+  }
+
+  const struct filsys *sb = &s->fs->superblock;
+  for (int i = 0; i < sb->s_ninode && i < 100; i++) {
+    int inumber = sb->s_inode[i];
+    if (inumber >= 1 && inumber <= s->numInodes && s->modes[inumber] != 0) {
+      Problem(s, "inode %d is on the free inode list, but allocated", inumber);
+    }
+  }
+}
+
+/**
+ * Marks the specified block as free.  Returns 0 on success, and -1 if the block is
+ * outside the data area or already on the free list, either of which means the
+ * list can't be followed any further.
+ */
+static int MarkFree(struct scan *s, int blockNum) {
+  if (blockNum < s->firstDataBlock || blockNum >= s->numBlocks) {
+    Problem(s, "block %d on the free list is outside the data area", blockNum);
+    return -1;
+  }
+  if (TestAndSet(s->free, blockNum)) {
+    Problem(s, "block %d is on the free list twice", blockNum);
+    return -1;
+  }
+  if (IsSet(s->inUse, blockNum)) {
+    Problem(s, "block %d is in use, but also on the free list", blockNum);
+  }
+  s->numFree++;
+  return 0;
+}
+
+/**
+ * Pass 3: walks the chain of free block lists that starts in the superblock.  The
+ * first block in each list is the one holding the next list, and a 0 there ends
+ * the chain.
+ */
+static void ScanFreeList(struct scan *s) {
+  const struct filsys *sb = &s->fs->superblock;
+  uint16_t list[kUInt16CountPerSector];
+  list[0] = sb->s_nfree;
+  memcpy(&list[1], sb->s_free, sizeof(sb->s_free));
+  while (list[0] > 0) {
+    if (list[0] > 100) {
+      Problem(s, "a free list holds %d blocks, more than 100", list[0]);
+      return;
+    }
+    for (int i = list[0]; i > 1; i--) {
+      if (MarkFree(s, list[i]) < 0) return;
+    }
+    int next = list[1];
+    if (next == 0) {
+      return;
+    }
+    if (MarkFree(s, next) < 0 || diskimg_readsector(s->fs->dfd, next, list) != DISKIMG_SECTOR_SIZE) {
+      return;
+    }
+  }
+}
+
+/**
+ * Reports the blocks that are neither in use nor free, a run at a time.
+ */
+static void CheckOrphans(struct scan *s) {
+  for (int blockNum = s->firstDataBlock; blockNum < s->numBlocks; blockNum++) {
+    if (IsSet(s->inUse, blockNum) || IsSet(s->free, blockNum)) continue;
+    int last = blockNum;
+    while (last + 1 < s->numBlocks && !IsSet(s->inUse, last + 1) && !IsSet(s->free, last + 1)) last++;
+    if (last == blockNum) {
+      Problem(s, "block %d is neither in use nor free", blockNum);
+    } else {
+      Problem(s, "blocks %d-%d are neither in use nor free", blockNum, last);
+    }
+    blockNum = last;
+  }
+}
+
+/**
+ * Checks the filesystem on the specified open image, returning the number of
+ * problems found, or -1 if it couldn't be checked at all.
+ */
+static int CheckFilesystem(struct unixfilesystem *fs, const char *diskpath) {
+  struct scan s;
+  memset(&s, 0, sizeof(s));
+  s.fs = fs;
+  s.diskpath = diskpath;
+  s.numInodes = fs->superblock.s_isize * kINodeCountPerSector;
+  s.firstDataBlock = INODE_START_SECTOR + fs->superblock.s_isize;
+  s.numBlocks = fs->superblock.s_fsize;
+
+  int diskBlocks = diskimg_getsize(fs->dfd) / DISKIMG_SECTOR_SIZE;
+  if (s.numBlocks > diskBlocks || s.firstDataBlock > s.numBlocks) {
+    printf("%s: superblock describes %d blocks with %d inode blocks, but the image holds %d blocks\n", diskpath,
+           s.numBlocks, fs->superblock.s_isize, diskBlocks);
+    return -1;
+  }
+
+  s.modes = calloc(s.numInodes + 1, sizeof(uint16_t));
+  s.nlinks = calloc(s.numInodes + 1, sizeof(uint8_t));
+  s.dirSlots = calloc(s.numInodes + 1, sizeof(int));
+  s.refs = calloc(s.numInodes + 1, sizeof(int));
+  s.visited = calloc(s.numInodes / 8 + 1, 1);
+  s.inUse = calloc(s.numBlocks / 8 + 1, 1);
+  s.free = calloc(s.numBlocks / 8 + 1, 1);
+  int err = 0;
+  if (s.modes == NULL || s.nlinks == NULL || s.dirSlots == NULL || s.refs == NULL || s.visited == NULL ||
+      s.inUse == NULL || s.free == NULL || ScanInodes(&s) < 0) {
+    fprintf(stderr, "Out of memory\n");
+    err = -1;
+  } else {
+    if ((s.modes[ROOT_INUMBER] & IFMT) != IFDIR) {
+      Problem(&s, "the root inode isn't a directory");
+    } else {
+      TestAndSet(s.visited, ROOT_INUMBER);
+      ScanDirectory(&s, ROOT_INUMBER, ROOT_INUMBER, "/");
+    }
+    CheckLinks(&s);
+    ScanFreeList(&s);
+    CheckOrphans(&s);
+    printf("%s: %s, %d files, %d blocks in use, %d free, %d problems\n", diskpath,
+           s.numProblems == 0 ? "clean" : "INCONSISTENT", s.numFiles, s.numInUse, s.numFree, s.numProblems);
+    err = s.numProblems;
+  }
+
+  free(s.modes);
+  free(s.nlinks);
+  free(s.dirSlots);
+  free(s.dirs);
+  free(s.refs);
+  free(s.visited);
+  free(s.inUse);
+  free(s.free);
+  return err;
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "mqs")) != -1) {
+    switch (opt) {
+    case 'm':
+      mapFlag = 1;
+      break;
+    case 'q':
+      quietFlag = 1;
+      break;
+    case 's':
+      statsFlag = 1;
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind == argc) {
+    PrintUsageAndExit(argv[0]);
+  }
+
+  int status = 0;
+  for (int i = optind; i < argc; i++) {
+    char *diskpath = argv[i];
+    int fd = mapFlag ? diskimg_openmapped(diskpath) : diskimg_open(diskpath, 1);
+    if (fd < 0) {
+      fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+      status = 2;
+      continue;
+    }
+    struct unixfilesystem *fs = unixfilesystem_init(fd);
+    if (fs == NULL) {
+      fprintf(stderr, "Failed to initialize unix filesystem on %s\n", diskpath);
+      (void) diskimg_close(fd);
+      status = 2;
+      continue;
+    }
+
+    struct diskimg_cachestats before, after;
+    diskimg_getcachestats(&before);
+    int numProblems = CheckFilesystem(fs, diskpath);
+    diskimg_getcachestats(&after);
+    if (numProblems < 0) {
+      status = 2;
+    } else if (numProblems > 0 && status == 0) {
+      status = 1;
+    }
+    if (statsFlag) {
+      fprintf(stderr, "%s: read %llu sectors of %d in %llu reads\n", diskpath,
+              (unsigned long long) (after.misses - before.misses), diskimg_getsize(fd) / DISKIMG_SECTOR_SIZE,
+              (unsigned long long) (after.reads - before.reads));
+    }
+
+    (void) diskimg_close(fd);
+    unixfilesystem_free(fs);
+  }
+  return status;
+}
+
+static void PrintUsageAndExit(char *progname) {
+  fprintf(stderr, "Usage: %s <options> diskimagePath...\n", progname);
+  fprintf(stderr, "where <options> can be:\n");
+  fprintf(stderr, "-q     print only the summary line of each disk image\n");
+  fprintf(stderr, "-s     print how many sectors were read, and in how many reads\n");
+  fprintf(stderr, "-m     map each disk image into memory instead of reading it sector by sector\n");
+  exit(EXIT_FAILURE);
+}
@@ -0,0 +1,190 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "hash.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// Compile a version of the function for each vector width, picking one at load time
+#define MULTIVERSIONED __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define MULTIVERSIONED
+#endif
+
+static void Sha1Init(struct hashctx *ctx) {
+  SHA1_Init(&ctx->u.sha1);
+}
+
+static int Sha1Update(struct hashctx *ctx, const void *data, size_t len) {
+  return SHA1_Update(&ctx->u.sha1, data, len) ? 0 : -1;
+}
+
+static int Sha1Final(struct hashctx *ctx, void *digest) {
+  return SHA1_Final(digest, &ctx->u.sha1) ? SHA_DIGEST_LENGTH : -1;
+}
+
+/**
+ * CRC32C (the Castagnoli polynomial, reflected), using the SSE4.2 crc32 instruction
+ * where there is one and a table otherwise.
+ */
+static uint32_t crc32cTable[256];
+static pthread_once_t crc32cTableOnce = PTHREAD_ONCE_INIT;
+
+static void BuildCrc32cTable(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78u : 0);
+    crc32cTable[i] = crc;
+  }
+}
+
+static uint32_t Crc32cTable(uint32_t crc, const unsigned char *p, size_t len) {
+  pthread_once(&crc32cTableOnce, BuildCrc32cTable);
+  while (len-- > 0) crc = (crc >> 8) ^ crc32cTable[(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t Crc32cHardware(uint32_t crc, const unsigned char *p, size_t len) {
+  uint64_t crc64 = crc;
+  for (; len >= 8; p += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc64 = __builtin_ia32_crc32di(crc64, word);
+  }
+  crc = crc64;
+  for (; len > 0; p++, len--) crc = __builtin_ia32_crc32qi(crc, *p);
+  return crc;
+}
+#endif
+
+static void Crc32cInit(struct hashctx *ctx) {
+  ctx->u.crc32c = 0xFFFFFFFFu;
+}
+
+static int Crc32cUpdate(struct hashctx *ctx, const void *data, size_t len) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    ctx->u.crc32c = Crc32cHardware(ctx->u.crc32c, data, len);
+    return 0;
+  }
+#endif
+  ctx->u.crc32c = Crc32cTable(ctx->u.crc32c, data, len);
+  return 0;
+}
+
+static int Crc32cFinal(struct hashctx *ctx, void *digest) {
+  uint32_t crc = ctx->u.crc32c ^ 0xFFFFFFFFu;
+  unsigned char *out = digest;
+  for (int i = 0; i < 4; i++) out[i] = crc >> (24 - 8 * i);
+  return 4;
+}
+
+const struct hashalg hash_sha1 = { "sha1", SHA_DIGEST_LENGTH, 1, Sha1Init, Sha1Update, Sha1Final };
+const struct hashalg hash_crc32c = { "crc32c", 4, 0, Crc32cInit, Crc32cUpdate, Crc32cFinal };
+
+static const struct hashalg *const kHashes[] = { &hash_sha1, &hash_crc32c };
+
+const struct hashalg *hash_find(const char *name) {
+  for (size_t i = 0; i < sizeof(kHashes) / sizeof(kHashes[0]); i++) {
+    if (strcmp(kHashes[i]->name, name) == 0) return kHashes[i];
+  }
+  return NULL;
+}
+
+void hash_init(struct hashctx *ctx, const struct hashalg *alg) {
+  ctx->alg = alg;
+  alg->init(ctx);
+}
+
+int hash_update(struct hashctx *ctx, const void *data, size_t len) {
+  return ctx->alg->update(ctx, data, len);
+}
+
+int hash_final(struct hashctx *ctx, void *digest) {
+  return ctx->alg->final(ctx, digest);
+}
+
+static const uint32_t kSha1Init[5] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+
+void hash_lanes_init(struct hashlanes *lanes, int lane) {
+  for (int i = 0; i < 5; i++) lanes->h[i][lane] = kSha1Init[i];
+}
+
+/**
+ * One lane's worth of 32-bit words per vector, so each operation below advances
+ * every lane at once.
+ */
+typedef uint32_t lanevec __attribute__((vector_size(4 * HASH_LANES)));
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SCHEDULE(t) ((t) < 16 ? w[t] : \
+  (w[(t) & 15] = ROL(w[((t) - 3) & 15] ^ w[((t) - 8) & 15] ^ w[((t) - 14) & 15] ^ w[(t) & 15], 1)))
+#define ROUND(t, f, k) do {                                             \
+    lanevec temp = ROL(a, 5) + (f) + e + (uint32_t) (k) + SCHEDULE(t);  \
+    e = d; d = c; c = ROL(b, 30); b = a; a = temp;                      \
+  } while (0)
+
+MULTIVERSIONED
+static void CompressLanes(uint32_t h[5][HASH_LANES], const unsigned char *const blocks[HASH_LANES]) {
+  lanevec w[16];
+  for (int t = 0; t < 16; t++) {
+    for (int lane = 0; lane < HASH_LANES; lane++) {
+      const unsigned char *p = blocks[lane] + 4 * t;
+      w[t][lane] = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+    }
+  }
+
+  lanevec a, b, c, d, e;
+  memcpy(&a, h[0], sizeof(a));
+  memcpy(&b, h[1], sizeof(b));
+  memcpy(&c, h[2], sizeof(c));
+  memcpy(&d, h[3], sizeof(d));
+  memcpy(&e, h[4], sizeof(e));
+  lanevec a0 = a, b0 = b, c0 = c, d0 = d, e0 = e;
+
+  for (int t = 0; t < 20; t++) ROUND(t, d ^ (b & (c ^ d)), 0x5A827999);
+  for (int t = 20; t < 40; t++) ROUND(t, b ^ c ^ d, 0x6ED9EBA1);
+  for (int t = 40; t < 60; t++) ROUND(t, (b & c) | (d & (b | c)), 0x8F1BBCDC);
+  for (int t = 60; t < 80; t++) ROUND(t, b ^ c ^ d, 0xCA62C1D6);
+
+  a += a0; b += b0; c += c0; d += d0; e += e0;
+  memcpy(h[0], &a, sizeof(a));
+  memcpy(h[1], &b, sizeof(b));
+  memcpy(h[2], &c, sizeof(c));
+  memcpy(h[3], &d, sizeof(d));
+  memcpy(h[4], &e, sizeof(e));
+}
+
+void hash_lanes_compress(struct hashlanes *lanes, const unsigned char *const blocks[HASH_LANES]) {
+  // Idle lanes compress a block of zeros, and then get their state back
+  static const unsigned char kIdleBlock[64];
+  const unsigned char *input[HASH_LANES];
+  struct hashlanes saved = *lanes;
+  for (int lane = 0; lane < HASH_LANES; lane++) input[lane] = blocks[lane] != NULL ? blocks[lane] : kIdleBlock;
+
+  CompressLanes(lanes->h, input);
+
+  for (int lane = 0; lane < HASH_LANES; lane++) {
+    if (blocks[lane] != NULL) continue;
+    for (int i = 0; i < 5; i++) lanes->h[i][lane] = saved.h[i][lane];
+  }
+}
+
+int hash_lanes_pad(const void *tail, int tailLen, uint64_t totalLen, unsigned char pad[128]) {
+  int numBlocks = tailLen < 56 ? 1 : 2;
+  memcpy(pad, tail, tailLen);
+  memset(pad + tailLen, 0, numBlocks * 64 - tailLen);
+  pad[tailLen] = 0x80;
+  uint64_t bits = totalLen * 8;
+  for (int i = 0; i < 8; i++) pad[numBlocks * 64 - 1 - i] = bits >> (8 * i);
+  return numBlocks;
+}
+
+void hash_lanes_digest(const struct hashlanes *lanes, int lane, void *digest) {
+  unsigned char *out = digest;
+  for (int i = 0; i < 5; i++) {
+    uint32_t word = lanes->h[i][lane];
+    for (int j = 0; j < 4; j++) out[4 * i + j] = word >> (24 - 8 * j);
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <openssl/sha.h>
+
+// Size in bytes of the largest digest any hash produces.
+#define HASH_MAX_DIGEST_SIZE 20
+
+// Number of messages the multi-buffer SHA-1 hashes side by side.
+#define HASH_LANES 16
+
+struct hashctx;
+
+/**
+ * A hash function files can be checksummed with.  sha1 is the one the grading
+ * output is defined in terms of; crc32c is far cheaper, and good for catching
+ * accidental differences, but its checksums are only 4 bytes and of no use against
+ * deliberate ones.
+ */
+struct hashalg {
+  const char *name;
+  int digestSize;
+  int multiBuffer;  // whether struct hashlanes computes this hash
+  void (*init)(struct hashctx *ctx);
+  int (*update)(struct hashctx *ctx, const void *data, size_t len);
+  int (*final)(struct hashctx *ctx, void *digest);
+};
+
+/**
+ * The state of one message being hashed.
+ */
+struct hashctx {
+  const struct hashalg *alg;
+  union {
+    SHA_CTX sha1;
+    uint32_t crc32c;
+  } u;
+};
+
+extern const struct hashalg hash_sha1;
+extern const struct hashalg hash_crc32c;
+
+/**
+ * Returns the hash with the specified name, or NULL if there's no such hash.
+ */
+const struct hashalg *hash_find(const char *name);
+
+/**
+ * Start, extend and finish the hashing of a message.  hash_update returns 0 on
+ * success, and hash_final returns the size of the digest it stores, or -1 on error.
+ */
+void hash_init(struct hashctx *ctx, const struct hashalg *alg);
+int hash_update(struct hashctx *ctx, const void *data, size_t len);
+int hash_final(struct hashctx *ctx, void *digest);
+
+/**
+ * HASH_LANES SHA-1 computations advanced in lockstep, one 64-byte block per lane
+ * per call to hash_lanes_compress, using as wide a vector unit as the processor
+ * has.  Feeding the lanes, and padding the end of each message (hash_lanes_pad
+ * builds the padding), is up to the caller.
+ */
+struct hashlanes {
+  uint32_t h[5][HASH_LANES];
+};
+
+/**
+ * Starts a new message in the specified lane.
+ */
+void hash_lanes_init(struct hashlanes *lanes, int lane);
+
+/**
+ * Compresses blocks[lane] into each lane whose entry isn't NULL.  Lanes with a
+ * NULL entry are left as they were.
+ */
+void hash_lanes_compress(struct hashlanes *lanes, const unsigned char *const blocks[HASH_LANES]);
+
+/**
+ * Writes the final block or two of a message into pad: the tail of the message
+ * (tailLen bytes, fewer than 64), followed by SHA-1's padding for a message of
+ * totalLen bytes.  Returns the number of 64-byte blocks written.
+ */
+int hash_lanes_pad(const void *tail, int tailLen, uint64_t totalLen, unsigned char pad[128]);
+
+/**
+ * Stores the digest of the message just finished in the specified lane.
+ */
+void hash_lanes_digest(const struct hashlanes *lanes, int lane, void *digest);
+
+#endif // _HASH_H_
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "inode.h"
@@ -22,26 +24,23 @@ int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp) {
   }
 
   char buffer[DISKIMG_SECTOR_SIZE];
-  // If successful, function returns positive integer
-  if (diskimg_readsector(fs->dfd, sectorAddress, buffer) == -1) {
+  // Points into the disk image's mapping when there is one, and at buffer otherwise
+  const struct inode *node = diskimg_getsector(fs->dfd, sectorAddress, buffer);
+  if (node == NULL) {
     return -1;
   }
 
-  struct inode *node = (struct inode*)buffer;
-  node = (struct inode*)(node + (inodeOffset-1));
+  node = node + (inodeOffset-1);
   *inp = *node;
 
   return 0;
 }
 
-int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum) {
-
-  // Small Mapping (all direct blocks)
-  if ((inp->i_mode & ILARG) == 0) {
-    return (blockNum < 8) ? inp->i_addr[blockNum] : -1;
-  }
-
-  // Large Mapping
+/**
+ * Looks up a block of a large file by walking its indirect blocks, reading one
+ * sector for a block in the first 1792 and two for any block past that.
+ */
+static int IndirectLookup(struct unixfilesystem *fs, struct inode *inp, int blockNum) {
   char buffer[DISKIMG_SECTOR_SIZE];
 
   // iNode resides in Singly-Indirect Block
@@ -51,8 +50,10 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
     uint16_t inodeOffset = blockNum % kUInt16CountPerSector;
 
     // Find index of iNode inside Singly-Indirect Block
-    diskimg_readsector(fs->dfd, inp->i_addr[indirectBlockAddress], buffer);
-    uint16_t* inodeIndex = (uint16_t*)buffer;
+    const uint16_t* inodeIndex = diskimg_getsector(fs->dfd, inp->i_addr[indirectBlockAddress], buffer);
+    if (inodeIndex == NULL) {
+      return -1;
+    }
     inodeIndex += inodeOffset;
 
     return *inodeIndex;
@@ -64,18 +65,181 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
   uint16_t inodeOffset = blocksRemaining % kUInt16CountPerSector;
 
   // Find index of Singly-Indirect Block inside Double-Indirect Block
-  diskimg_readsector(fs->dfd, inp->i_addr[7], buffer);
-  uint16_t* indirectBlockNumber = (uint16_t*)buffer;
+  const uint16_t* indirectBlockNumber = diskimg_getsector(fs->dfd, inp->i_addr[7], buffer);
+  if (indirectBlockNumber == NULL) {
+    return -1;
+  }
   indirectBlockNumber += indirectBlockAddress;
 
   // Find index of iNode inside Singly-Indirect Block
-  diskimg_readsector(fs->dfd, *indirectBlockNumber, buffer);
-  uint16_t* inodeIndex = (uint16_t*)buffer;
+  const uint16_t* inodeIndex = diskimg_getsector(fs->dfd, *indirectBlockNumber, buffer);
+  if (inodeIndex == NULL) {
+    return -1;
+  }
   inodeIndex += inodeOffset;
 
   return *inodeIndex;
 }
 
+/**
+ * Resolves every block of the specified large file into the specified array, reading
+ * each of its indirect blocks exactly once.  Returns 0 on success, -1 on error.
+ */
+static int ResolveBlockMap(struct unixfilesystem *fs, struct inode *inp, uint16_t *blocks, int numBlocks) {
+  char singleBuffer[DISKIMG_SECTOR_SIZE];
+  char doubleBuffer[DISKIMG_SECTOR_SIZE];
+  const uint16_t *doublyIndirect = NULL;
+
+  for (int first = 0; first < numBlocks; first += kUInt16CountPerSector) {
+    int sectorAddress;
+    if (first < kMaxINodesBeforeDoublyIndirectBlock) {
+      sectorAddress = inp->i_addr[first / kUInt16CountPerSector];
+    } else {
+      if (doublyIndirect == NULL) {
+        doublyIndirect = diskimg_getsector(fs->dfd, inp->i_addr[7], doubleBuffer);
+        if (doublyIndirect == NULL) return -1;
+      }
+      sectorAddress = doublyIndirect[(first - kMaxINodesBeforeDoublyIndirectBlock) / kUInt16CountPerSector];
+    }
+
+    const uint16_t *singlyIndirect = diskimg_getsector(fs->dfd, sectorAddress, singleBuffer);
+    if (singlyIndirect == NULL) return -1;
+    int count = numBlocks - first < kUInt16CountPerSector ? numBlocks - first : kUInt16CountPerSector;
+    memcpy(blocks + first, singlyIndirect, count * sizeof(uint16_t));
+  }
+  return 0;
+}
+
+/**
+ * Returns the slot holding the block map of the specified large file, or NULL if
+ * it isn't cached.  Called with the filesystem's lock held.
+ */
+static struct blockmap *FindBlockMap(struct unixfilesystem *fs, struct inode *inp) {
+  for (int i = 0; i < BLOCKMAP_CACHE_SLOTS; i++) {
+    struct blockmap *map = &fs->blockmaps[i];
+    if (map->blocks != NULL && map->i_mode == inp->i_mode && map->i_size0 == inp->i_size0 &&
+        map->i_size1 == inp->i_size1 && memcmp(map->i_addr, inp->i_addr, sizeof(map->i_addr)) == 0) {
+      map->lastUse = ++fs->blockmapClock;
+      return map;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Caches the specified block map of the specified large file in place of the least
+ * recently used one, taking ownership of blocks.  Called with the filesystem's lock held.
+ */
+static struct blockmap *InstallBlockMap(struct unixfilesystem *fs, struct inode *inp, uint16_t *blocks, int numBlocks) {
+  struct blockmap *victim = &fs->blockmaps[0];
+  for (int i = 1; i < BLOCKMAP_CACHE_SLOTS && victim->blocks != NULL; i++) {
+    struct blockmap *map = &fs->blockmaps[i];
+    if (map->blocks == NULL || map->lastUse < victim->lastUse) victim = map;
+  }
+
+  free(victim->blocks);
+  victim->i_mode = inp->i_mode;
+  victim->i_size0 = inp->i_size0;
+  victim->i_size1 = inp->i_size1;
+  memcpy(victim->i_addr, inp->i_addr, sizeof(victim->i_addr));
+  victim->blocks = blocks;
+  victim->numBlocks = numBlocks;
+  victim->lastUse = ++fs->blockmapClock;
+  return victim;
+}
+
+/**
+ * Looks up a block of a large file in its cached block map, resolving the map (outside
+ * the filesystem's lock, so other threads aren't held up by the reads) if it isn't
+ * cached yet.  Returns -1 if the block lies past the end of the file or the map
+ * can't be resolved.
+ */
+static int MappedLookup(struct unixfilesystem *fs, struct inode *inp, int blockNum) {
+  pthread_mutex_lock(&fs->lock);
+  struct blockmap *map = FindBlockMap(fs, inp);
+  if (map == NULL) {
+    pthread_mutex_unlock(&fs->lock);
+    int numBlocks = (inode_getsize(inp) + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+    if (numBlocks == 0) return -1;
+    uint16_t *blocks = malloc(numBlocks * sizeof(uint16_t));
+    if (blocks == NULL) return -1;
+    if (ResolveBlockMap(fs, inp, blocks, numBlocks) < 0) {
+      free(blocks);
+      return -1;
+    }
+
+    // Another thread may have resolved the same map in the meantime
+    pthread_mutex_lock(&fs->lock);
+    map = FindBlockMap(fs, inp);
+    if (map == NULL) {
+      map = InstallBlockMap(fs, inp, blocks, numBlocks);
+    } else {
+      free(blocks);
+    }
+  }
+
+  int blockIndex = (blockNum >= 0 && blockNum < map->numBlocks) ? map->blocks[blockNum] : -1;
+  pthread_mutex_unlock(&fs->lock);
+  return blockIndex;
+}
+
+int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum) {
+
+  // Small Mapping (all direct blocks)
+  if ((inp->i_mode & ILARG) == 0) {
+    return (blockNum < 8) ? inp->i_addr[blockNum] : -1;
+  }
+
+  // Large Mapping, served from the file's cached block map whenever the block lies within the file
+  int blockIndex = MappedLookup(fs, inp, blockNum);
+  if (blockIndex >= 0) {
+    return blockIndex;
+  }
+  return IndirectLookup(fs, inp, blockNum);
+}
+
+/**
+ * Drops every cached block map of the large file whose first indirect block is
+ * the specified one.  Different versions of a file (before and after an append,
+ * say) share that block, and no two live files do, so this forgets the file's
+ * maps before its blocks can be freed and reused by another file.
+ */
+static void ForgetBlockMaps(struct unixfilesystem *fs, int firstIndirect) {
+  pthread_mutex_lock(&fs->lock);
+  for (int i = 0; i < BLOCKMAP_CACHE_SLOTS; i++) {
+    struct blockmap *map = &fs->blockmaps[i];
+    if (map->blocks != NULL && (map->i_mode & ILARG) && map->i_addr[0] == firstIndirect) {
+      free(map->blocks);
+      map->blocks = NULL;
+    }
+  }
+  pthread_mutex_unlock(&fs->lock);
+}
+
+int inode_iput(struct unixfilesystem *fs, int inumber, struct inode *inp) {
+  if (inumber < ROOT_INUMBER || inumber > fs->superblock.s_isize * kINodeCountPerSector) {
+    return -1;
+  }
+
+  int sectorAddress = (inumber - 1) / kINodeCountPerSector + INODE_START_SECTOR;
+  struct inode inodes[kINodeCountPerSector];
+  if (diskimg_readsector(fs->dfd, sectorAddress, inodes) != DISKIMG_SECTOR_SIZE) {
+    return -1;
+  }
+
+  struct inode *node = &inodes[(inumber - 1) % kINodeCountPerSector];
+  if (node->i_mode & ILARG) {
+    ForgetBlockMaps(fs, node->i_addr[0]);
+  }
+  *node = *inp;
+  return diskimg_writesector(fs->dfd, sectorAddress, inodes) == DISKIMG_SECTOR_SIZE ? 0 : -1;
+}
+
 int inode_getsize(struct inode *inp) {
   return ((inp->i_size0 << 16) | inp->i_size1); 
 }
+
+void inode_setsize(struct inode *inp, int size) {
+  inp->i_size0 = size >> 16;
+  inp->i_size1 = size & 0xffff;
+}
@@ -9,6 +9,12 @@
  */
 int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp); 
 
+/**
+ * Writes the specified inode back to the filesystem, dropping anything cached
+ * about the file it replaces.  Returns 0 on success, -1 on error.
+ */
+int inode_iput(struct unixfilesystem *fs, int inumber, struct inode *inp);
+
 /**
  * Given an index of a file block, retrieves the file's actual block number
  * of from the given inode.
@@ -22,4 +28,9 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
  */
 int inode_getsize(struct inode *inp);
 
+/**
+ * Stores the specified size (less than 2^24 bytes) in the given inode.
+ */
+void inode_setsize(struct inode *inp, int size);
+
 #endif // _INODE_
@@ -14,8 +14,9 @@ int pathname_lookup(struct unixfilesystem *fs, const char *pathname) {
   strcpy(mutablePathname, pathname);
   char delimiter[2] = "/"; // Slash used for delimeter in UNIX pathnames
   char* token;
+  char* savePtr; // strtok_r rather than strtok, so lookups can run on several threads
 
-  token = strtok(mutablePathname, delimiter);
+  token = strtok_r(mutablePathname, delimiter, &savePtr);
 
   // If no strings result, assume ROOT
   if (token == NULL) {
@@ -32,7 +33,7 @@ int pathname_lookup(struct unixfilesystem *fs, const char *pathname) {
       break;
     }
 
-    token = strtok(NULL, delimiter);
+    token = strtok_r(NULL, delimiter, &savePtr);
 
     // If NULL, iNumber found
     if (token == NULL) {
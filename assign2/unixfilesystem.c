@@ -1,7 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "unixfilesystem.h"
 #include "diskimg.h" 
+#include "inode.h"
+#include "file.h"
+#include "alloc.h"
 
 /**
  * Allocates and initializes a struct unixfilesystem given a filedescriptor to 
@@ -35,11 +40,98 @@ struct unixfilesystem *unixfilesystem_init(int dfd) {
   }
 
   fs->dfd = dfd;  
+  pthread_mutex_init(&fs->lock, NULL);
+  memset(fs->blockmaps, 0, sizeof(fs->blockmaps));
+  fs->blockmapClock = 0;
+  memset(fs->dirindexes, 0, sizeof(fs->dirindexes));
+  fs->dirindexClock = 0;
+  memset(fs->dentries, 0, sizeof(fs->dentries));
   if (diskimg_readsector(dfd, SUPERBLOCK_SECTOR, &fs->superblock) != DISKIMG_SECTOR_SIZE) {
     fprintf(stderr, "Error reading superblock\n");
+    pthread_mutex_destroy(&fs->lock);
     free(fs);
     return NULL;
   }
 
   return fs;
 }
+
+void unixfilesystem_free(struct unixfilesystem *fs) {
+  for (int i = 0; i < BLOCKMAP_CACHE_SLOTS; i++) {
+    free(fs->blockmaps[i].blocks);
+  }
+  for (int i = 0; i < DIRINDEX_CACHE_SLOTS; i++) {
+    free(fs->dirindexes[i].entries);
+    free(fs->dirindexes[i].buckets);
+  }
+  pthread_mutex_destroy(&fs->lock);
+  free(fs);
+}
+
+int unixfilesystem_sync(struct unixfilesystem *fs) {
+  struct filsys *sb = &fs->superblock;
+  if (sb->s_fmod) {
+    uint32_t now = time(NULL);
+    sb->s_fmod = 0;
+    sb->s_time[0] = now >> 16;
+    sb->s_time[1] = now & 0xffff;
+    if (diskimg_writesector(fs->dfd, SUPERBLOCK_SECTOR, sb) != DISKIMG_SECTOR_SIZE) {
+      return -1;
+    }
+  }
+  return diskimg_sync(fs->dfd);
+}
+
+int unixfilesystem_format(int dfd, int fsize, int isize) {
+  // Block numbers and inumbers are 16 bits wide
+  int firstDataBlock = INODE_START_SECTOR + isize;
+  if (fsize > 0xffff || isize < 1 || isize * 16 > 0xffff || firstDataBlock >= fsize) {
+    return -1;
+  }
+
+  char sector[DISKIMG_SECTOR_SIZE];
+  memset(sector, 0, sizeof(sector));
+  for (int i = INODE_START_SECTOR; i < firstDataBlock; i++) {
+    if (diskimg_writesector(dfd, i, sector) != DISKIMG_SECTOR_SIZE) return -1;
+  }
+
+  struct filsys sb;
+  memset(&sb, 0, sizeof(sb));
+  sb.s_isize = isize;
+  sb.s_fsize = fsize;
+  uint16_t *bootblock = (uint16_t *) sector;
+  bootblock[0] = BOOTBLOCK_MAGIC_NUM;
+  if (diskimg_writesector(dfd, BOOTBLOCK_SECTOR, sector) != DISKIMG_SECTOR_SIZE ||
+      diskimg_writesector(dfd, SUPERBLOCK_SECTOR, &sb) != DISKIMG_SECTOR_SIZE) {
+    return -1;
+  }
+
+  struct unixfilesystem *fs = unixfilesystem_init(dfd);
+  if (fs == NULL) {
+    return -1;
+  }
+
+  // Freed from the top down, so blocks are handed out from the bottom up
+  int err = 0;
+  for (int blockNum = fsize - 1; blockNum >= firstDataBlock && err == 0; blockNum--) {
+    err = alloc_freeblock(fs, blockNum);
+  }
+
+  // The root directory, which is its own parent
+  struct inode root;
+  memset(&root, 0, sizeof(root));
+  root.i_mode = IALLOC | IFDIR | 0777;
+  root.i_nlink = 2;
+  struct direntv6 dots[2];
+  memset(dots, 0, sizeof(dots));
+  dots[0].d_inumber = dots[1].d_inumber = ROOT_INUMBER;
+  strcpy(dots[0].d_name, ".");
+  strcpy(dots[1].d_name, "..");
+  if (err < 0 || inode_iput(fs, ROOT_INUMBER, &root) < 0 ||
+      file_append(fs, ROOT_INUMBER, dots, sizeof(dots)) != sizeof(dots) || unixfilesystem_sync(fs) < 0) {
+    err = -1;
+  }
+
+  unixfilesystem_free(fs);
+  return err;
+}
@@ -9,6 +9,8 @@
 #include "ino.h"        // Inode definition
 #include "direntv6.h"   // Directory entry
 
+#include <pthread.h>
+
 /**
  * The layout of the Unix disk looked as follows:
  * ----------------------------------------------
@@ -25,11 +27,96 @@
 #define ROOT_INUMBER        1
 #define BOOTBLOCK_MAGIC_NUM 0407
 
+#define BLOCKMAP_CACHE_SLOTS 8
+#define DIRINDEX_CACHE_SLOTS 8
+#define DENTRY_CACHE_SIZE    1024 // a power of two
+
+/**
+ * The fully resolved block list of one large file, as cached by inode_indexlookup.
+ * The copy of the inode's address, mode and size fields identifies the file the
+ * list belongs to, so a slot goes stale the moment any of them changes.
+ */
+struct blockmap {
+  uint16_t i_mode;
+  uint8_t  i_size0;
+  uint16_t i_size1;
+  uint16_t i_addr[8];
+  uint16_t *blocks;   // numBlocks physical block numbers, or NULL if the slot is empty
+  int numBlocks;
+  unsigned int lastUse;
+};
+
+/**
+ * An in-memory copy of one large directory, hashed by name, as built by
+ * directory_findname.  Like a blockmap, it keeps a copy of the directory inode's
+ * address, mode and size fields, and goes stale the moment any of them changes.
+ * directory_addentry and directory_removeentry apply their changes to the index,
+ * copied fields and all, so only other changes to the directory make it stale.
+ */
+struct dirindex {
+  int inumber;
+  uint16_t i_mode;
+  uint8_t  i_size0;
+  uint16_t i_size1;
+  uint16_t i_addr[8];
+  struct direntv6 *entries; // numEntries entries in directory order, or NULL if the slot is empty
+  int numEntries;
+  int capacity;             // entries allocated, a whole number of blocks' worth
+  int freeHint;             // no entry before this one is a free slot
+  int duplicates;           // whether some name appears more than once
+  int *buckets;             // numBuckets indices into entries (a power of two), -1 if unused
+  int numBuckets;
+  unsigned int lastUse;
+};
+
+/**
+ * One remembered result of directory_findname: the entry found under its name in
+ * the directory parent.  Anything that changes a directory must clear these.
+ */
+struct dentry {
+  uint16_t parent;          // 0 if the slot is empty
+  struct direntv6 entry;
+};
+
+/**
+ * A struct unixfilesystem may be shared between threads, as long as nothing is
+ * writing to it (see file_create and the functions after it), and lock guards the
+ * caches below the superblock.  Writes change the superblock in memory, and
+ * unixfilesystem_sync writes it back.
+ */
 struct unixfilesystem {
   int dfd; // Handle from the diskimg module to read the diskimg.
   struct filsys superblock;  // The superblock read from the diskimage.
+  pthread_mutex_t lock;
+  struct blockmap blockmaps[BLOCKMAP_CACHE_SLOTS]; // Least recently used slot is evicted first.
+  unsigned int blockmapClock;
+  struct dirindex dirindexes[DIRINDEX_CACHE_SLOTS]; // Least recently used slot is evicted first.
+  unsigned int dirindexClock;
+  struct dentry dentries[DENTRY_CACHE_SIZE]; // Direct mapped by parent and name.
 };
 
 struct unixfilesystem *unixfilesystem_init(int fd);
 
+/**
+ * Releases a struct unixfilesystem returned by unixfilesystem_init, along with
+ * everything cached on its behalf.  The disk image itself is left open.
+ */
+void unixfilesystem_free(struct unixfilesystem *fs);
+
+/**
+ * Writes the superblock back if it has changed (s_fmod is set), then writes every
+ * sector still waiting in the sector cache to the disk image.  Returns 0 on success,
+ * or -1 on error.
+ */
+int unixfilesystem_sync(struct unixfilesystem *fs);
+
+/**
+ * Makes an empty filesystem, holding just the root directory, on the disk image
+ * open on dfd (see diskimg_create).  The disk is fsize blocks long, isize of which
+ * hold inodes, 16 to a block.  Every block after the inodes goes on the free list.
+ * Returns 0 on success, or -1 if the sizes don't fit V6's 16-bit block numbers and
+ * inumbers, or the disk can't be written.
+ */
+int unixfilesystem_format(int dfd, int fsize, int isize);
+
 #endif // _UNIXFILESYSTEM_H_
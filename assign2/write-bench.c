@@ -0,0 +1,295 @@
+/**
+ * Measures how fast a disk image can be built: formats a new image at the specified
+ * path, creates files in it (spread over directories under the root), syncs it,
+ * reads every file back from a freshly opened copy of the image to check its
+ * contents, and finally unlinks every file again.
+ *
+ * The output is meant for scripts: a header line, then one tab-separated line per
+ * phase, with these columns:
+ *
+ *     disk      the disk image's path
+ *     phase     format, create, sync, verify, unlink, then sync again
+ *     files     number of files the phase handled
+ *     seconds   wall time the phase took
+ *     filesps   files handled per second
+ *     sectors   sectors written to the disk image during the phase
+ *     writes    system calls issued for those sectors
+ *
+ * Sectors written by create and unlink are the ones the sector cache had to evict;
+ * the rest go out in the sync after them.  The image is left behind, holding the
+ * empty directories.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "diskimg.h"
+#include "unixfilesystem.h"
+#include "file.h"
+#include "pathname.h"
+
+static const int kDefaultNumFiles = 10000;
+static const int kDefaultFileSize = 2048;
+static const int kDefaultFilesPerDir = 100;
+static const int kDiskBlocks = 0xffff; // the largest disk V6 can address
+
+int numFiles = 0;
+int fileSize = -1;
+int filesPerDir = 0;
+int cacheSectors = DISKIMG_DEFAULT_CACHE_SECTORS;
+
+static void PrintUsageAndExit(char *progname);
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Fills buf with the contents of file number i, which differ from file to file.
+ */
+static void FileContents(int i, unsigned char *buf) {
+  for (int j = 0; j < fileSize; j++) buf[j] = (i * 131 + j * 7 + j / 256) & 0xff;
+}
+
+static void DirName(int dir, char *name) {
+  sprintf(name, "d%05d", dir);
+}
+
+static void FileName(int i, char *name) {
+  sprintf(name, "f%05d", i);
+}
+
+/**
+ * Times a phase, and prints its line once it's over.
+ */
+struct phase {
+  const char *diskpath;
+  const char *name;
+  double start;
+  struct diskimg_cachestats before;
+};
+
+static void StartPhase(struct phase *p, const char *diskpath, const char *name) {
+  p->diskpath = diskpath;
+  p->name = name;
+  diskimg_getcachestats(&p->before);
+  p->start = Now();
+}
+
+static void EndPhase(struct phase *p, int files) {
+  double seconds = Now() - p->start;
+  struct diskimg_cachestats after;
+  diskimg_getcachestats(&after);
+  printf("%s\t%s\t%d\t%.6f\t%.0f\t%llu\t%llu\n", p->diskpath, p->name, files, seconds,
+         seconds > 0 ? files / seconds : 0.0, (unsigned long long) (after.writebacks - p->before.writebacks),
+         (unsigned long long) (after.writes - p->before.writes));
+}
+
+/**
+ * Opens the filesystem on the specified image, with an empty sector cache.
+ * Returns NULL on error.
+ */
+static struct unixfilesystem *OpenImage(char *diskpath, int readOnly) {
+  diskimg_setcachesize(cacheSectors);
+  int fd = diskimg_open(diskpath, readOnly);
+  if (fd < 0) {
+    fprintf(stderr, "Can't open diskimagePath %s\n", diskpath);
+    return NULL;
+  }
+  struct unixfilesystem *fs = unixfilesystem_init(fd);
+  if (fs == NULL) {
+    fprintf(stderr, "Failed to initialize unix filesystem on %s\n", diskpath);
+    (void) diskimg_close(fd);
+  }
+  return fs;
+}
+
+/**
+ * Closes a filesystem opened with OpenImage, returning -1 if anything still cached
+ * couldn't be written.
+ */
+static int CloseImage(struct unixfilesystem *fs) {
+  int fd = fs->dfd;
+  unixfilesystem_free(fs);
+  return diskimg_close(fd);
+}
+
+/**
+ * Creates the directories and files, returning the inumbers of the directories in
+ * dirs, or -1 on error.
+ */
+static int CreateFiles(struct unixfilesystem *fs, int *dirs) {
+  unsigned char *contents = malloc(fileSize > 0 ? fileSize : 1);
+  if (contents == NULL) return -1;
+  for (int i = 0; i < numFiles; i++) {
+    char name[16];
+    if (i % filesPerDir == 0) {
+      DirName(i / filesPerDir, name);
+      dirs[i / filesPerDir] = file_create(fs, ROOT_INUMBER, name, IFDIR | 0755);
+      if (dirs[i / filesPerDir] < 0) {
+        fprintf(stderr, "Can't create directory %s\n", name);
+        free(contents);
+        return -1;
+      }
+    }
+
+    FileName(i, name);
+    int inumber = file_create(fs, dirs[i / filesPerDir], name, 0644);
+    FileContents(i, contents);
+    if (inumber < 0 || (fileSize > 0 && file_append(fs, inumber, contents, fileSize) != fileSize)) {
+      fprintf(stderr, "Can't create file %d of %d (is the disk full?)\n", i, numFiles);
+      free(contents);
+      return -1;
+    }
+  }
+  free(contents);
+  return 0;
+}
+
+/**
+ * Looks every file up by its pathname and checks its size and contents.  Returns
+ * the number of files that check out.
+ */
+static int VerifyFiles(struct unixfilesystem *fs) {
+  unsigned char *expected = malloc(fileSize + 1);
+  unsigned char *actual = malloc(fileSize + 1);
+  int numGood = 0;
+  for (int i = 0; i < numFiles && expected != NULL && actual != NULL; i++) {
+    char dirname[16], filename[16], path[40];
+    DirName(i / filesPerDir, dirname);
+    FileName(i, filename);
+    sprintf(path, "/%s/%s", dirname, filename);
+    int inumber = pathname_lookup(fs, path);
+    struct filehandle *file = inumber < 0 ? NULL : file_open(fs, inumber);
+    if (file == NULL) {
+      fprintf(stderr, "Can't open %s\n", path);
+      continue;
+    }
+
+    FileContents(i, expected);
+    int bytesMoved = file_read(file, actual, fileSize + 1);
+    file_close(file);
+    if (bytesMoved != fileSize || memcmp(expected, actual, fileSize) != 0) {
+      fprintf(stderr, "Contents of %s are wrong\n", path);
+      continue;
+    }
+    numGood++;
+  }
+  free(expected);
+  free(actual);
+  return numGood;
+}
+
+static int UnlinkFiles(struct unixfilesystem *fs, const int *dirs) {
+  for (int i = 0; i < numFiles; i++) {
+    char name[16];
+    FileName(i, name);
+    if (file_unlink(fs, dirs[i / filesPerDir], name) < 0) {
+      fprintf(stderr, "Can't unlink file %d\n", i);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "c:d:n:s:")) != -1) {
+    switch (opt) {
+    case 'c':
+      cacheSectors = atoi(optarg);
+      break;
+    case 'd':
+      filesPerDir = atoi(optarg);
+      break;
+    case 'n':
+      numFiles = atoi(optarg);
+      break;
+    case 's':
+      fileSize = atoi(optarg);
+      break;
+    default:
+      PrintUsageAndExit(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || cacheSectors < 0 || numFiles < 0 || filesPerDir < 0) {
+    PrintUsageAndExit(argv[0]);
+  }
+  if (numFiles == 0) numFiles = kDefaultNumFiles;
+  if (fileSize < 0) fileSize = kDefaultFileSize;
+  if (filesPerDir == 0) filesPerDir = kDefaultFilesPerDir;
+  char *diskpath = argv[optind];
+
+  // Room for every file and directory, and the root, at 16 inodes per block
+  int numDirs = (numFiles + filesPerDir - 1) / filesPerDir;
+  int isize = (numFiles + numDirs + 1 + 15) / 16;
+  int *dirs = malloc(numDirs * sizeof(int));
+  if (dirs == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  printf("disk\tphase\tfiles\tseconds\tfilesps\tsectors\twrites\n");
+  struct phase p;
+  diskimg_setcachesize(cacheSectors);
+  StartPhase(&p, diskpath, "format");
+  int fd = diskimg_create(diskpath, kDiskBlocks);
+  if (fd < 0 || unixfilesystem_format(fd, kDiskBlocks, isize) < 0 || diskimg_close(fd) < 0) {
+    fprintf(stderr, "Can't make a %d-block filesystem with %d inode blocks on %s\n", kDiskBlocks, isize, diskpath);
+    return 1;
+  }
+  EndPhase(&p, 0);
+
+  struct unixfilesystem *fs = OpenImage(diskpath, 0);
+  if (fs == NULL) return 1;
+  StartPhase(&p, diskpath, "create");
+  if (CreateFiles(fs, dirs) < 0) return 1;
+  EndPhase(&p, numFiles);
+  StartPhase(&p, diskpath, "sync");
+  if (unixfilesystem_sync(fs) < 0 || CloseImage(fs) < 0) {
+    fprintf(stderr, "Can't write %s\n", diskpath);
+    return 1;
+  }
+  EndPhase(&p, numFiles);
+
+  fs = OpenImage(diskpath, 1);
+  if (fs == NULL) return 1;
+  StartPhase(&p, diskpath, "verify");
+  int numGood = VerifyFiles(fs);
+  EndPhase(&p, numFiles);
+  CloseImage(fs);
+  if (numGood != numFiles) {
+    fprintf(stderr, "%d of %d files are missing or wrong\n", numFiles - numGood, numFiles);
+    return 1;
+  }
+
+  fs = OpenImage(diskpath, 0);
+  if (fs == NULL) return 1;
+  StartPhase(&p, diskpath, "unlink");
+  if (UnlinkFiles(fs, dirs) < 0) return 1;
+  EndPhase(&p, numFiles);
+  StartPhase(&p, diskpath, "sync");
+  if (unixfilesystem_sync(fs) < 0 || CloseImage(fs) < 0) {
+    fprintf(stderr, "Can't write %s\n", diskpath);
+    return 1;
+  }
+  EndPhase(&p, numFiles);
+  free(dirs);
+  return 0;
+}
+
+static void PrintUsageAndExit(char *progname) {
+  fprintf(stderr, "Usage: %s <options> diskimagePath\n", progname);
+  fprintf(stderr, "where <options> can be:\n");
+  fprintf(stderr, "-n N   create N files (default %d)\n", kDefaultNumFiles);
+  fprintf(stderr, "-s N   of N bytes each (default %d)\n", kDefaultFileSize);
+  fprintf(stderr, "-d N   N to a directory (default %d)\n", kDefaultFilesPerDir);
+  fprintf(stderr, "-c N   cache up to N recently used sectors (default %d, 0 disables)\n",
+          DISKIMG_DEFAULT_CACHE_SECTORS);
+  exit(EXIT_FAILURE);
+}